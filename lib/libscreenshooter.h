@@ -25,5 +25,16 @@
 #include "screenshooter-actions.h"
 #include "screenshooter-capture.h"
 #include "screenshooter-global.h"
+#include "screenshooter-upload.h"
+#include "screenshooter-spool.h"
+#include "screenshooter-batch.h"
+#include "screenshooter-encode.h"
+#include "screenshooter-s3.h"
+#include "screenshooter-pipeline.h"
+#include "screenshooter-service.h"
+#include "screenshooter-hotkeys.h"
+#include "screenshooter-interval.h"
+#include "screenshooter-burst.h"
+#include "screenshooter-watch.h"
 
 #endif
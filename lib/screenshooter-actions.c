@@ -19,6 +19,59 @@
 
 #include "screenshooter-actions.h"
 
+/* Number of services a screenshot can be uploaded to at once */
+#define MAX_UPLOAD_TARGETS 3
+
+
+
+typedef struct _UploadBatch UploadBatch;
+
+/* One of the concurrent uploads of a batch */
+typedef struct
+{
+  UploadBatch      *batch;
+  ScreenshooterJob *job;
+  UploadResult     *result;
+  gchar          *(*get_image_url) (const gchar *upload_name);
+  gint              action;
+  gdouble           percent;
+} UploadTarget;
+
+/* Uploads of the same screenshot to several services, sharing one
+ * progress dialog. It frees itself once the slowest upload is done. */
+struct _UploadBatch
+{
+  GtkWidget    *dialog;
+  UploadTarget  targets[MAX_UPLOAD_TARGETS];
+  UploadResult  results[MAX_UPLOAD_TARGETS];
+  guint         n_targets;
+  guint         n_running;
+  gboolean      cancelled;
+};
+
+/* Copy of a screenshot encoded for the uploads, deleted once the last job
+ * uploading it is gone */
+typedef struct
+{
+  gint   ref_count;
+  gchar *path;
+} UploadArtifact;
+
+/* A screenshot going through the actions. Several of them can be on their
+ * way at once in the panel plugin, each keeps the actions chosen for it. */
+typedef struct
+{
+  ScreenshotData *sd;
+  GdkPixbuf      *screenshot;
+  gint            action;
+  gchar          *app;
+  GAppInfo       *app_info;
+} ActionRun;
+
+
+
+/* Internals */
+
 
 
 static void
@@ -33,64 +86,401 @@ cb_help_response (GtkWidget *dialog, gint response, gpointer unused)
 
 
 
-/* Public */
+static void
+cb_target_uploaded (ScreenshooterJob *job, gchar *upload_name, UploadTarget *target)
+{
+  g_return_if_fail (upload_name != NULL);
+
+  target->result->url = target->get_image_url (upload_name);
+}
 
 
 
-gboolean screenshooter_take_screenshot_idle (ScreenshotData *sd)
+static void
+cb_target_error (ExoJob *job, GError *error, UploadTarget *target)
 {
-  sd->screenshot = screenshooter_take_screenshot (sd->region,
-                                                  sd->delay,
-                                                  sd->show_mouse,
-                                                  sd->plugin);
+  g_return_if_fail (error != NULL);
 
-  if (sd->screenshot != NULL)
-    g_idle_add ((GSourceFunc) screenshooter_action_idle, sd);
-  else if (!sd->plugin)
-    gtk_main_quit ();
+  /* Still failing after the retries, try again once the service is back */
+  if (spool_failed_upload (job, error, target->action))
+    target->result->error =
+      g_strdup (_("The upload failed, it will be made again in the background."));
+  else
+    target->result->error = g_strdup (error->message);
+}
 
-  return FALSE;
+
+
+/* The progress bar shows the mean progress of the uploads */
+static void
+cb_target_percent (ExoJob *job, gdouble percent, UploadTarget *target)
+{
+  UploadBatch *batch = target->batch;
+  gdouble total = 0;
+  guint i;
+
+  target->percent = percent;
+
+  for (i = 0; i < batch->n_targets; i++)
+    total += batch->targets[i].percent;
+
+  cb_update_percent (job, total / batch->n_targets, batch->dialog);
 }
 
-gboolean screenshooter_action_idle (ScreenshotData *sd)
+
+
+static void
+upload_batch_done (UploadBatch *batch)
 {
-  if (!sd->action_specified)
+  guint i;
+
+  gtk_widget_destroy (batch->dialog);
+
+  if (!batch->cancelled)
+    show_upload_results_dialog (batch->results, batch->n_targets);
+
+  for (i = 0; i < batch->n_targets; i++)
     {
-      GtkWidget *dialog = screenshooter_actions_dialog_new (sd);
-      gint response;
+      g_free (batch->results[i].url);
+      g_free (batch->results[i].error);
+    }
 
-      g_signal_connect (dialog, "response",
-                        G_CALLBACK (cb_help_response), NULL);
-      g_signal_connect (dialog, "key-press-event",
-                        G_CALLBACK (screenshooter_f1_key), NULL);
+  g_free (batch);
 
-      response = gtk_dialog_run (GTK_DIALOG (dialog));
+  screenshooter_release ();
+}
 
-      gtk_widget_destroy (dialog);
 
-      if (response == GTK_RESPONSE_CANCEL ||
-          response == GTK_RESPONSE_DELETE_EVENT ||
-          response == GTK_RESPONSE_CLOSE)
-        {
-          if (!sd->plugin)
-            gtk_main_quit ();
 
-          g_object_unref (sd->screenshot);
-          return FALSE;
+static void
+cb_target_finished (ExoJob *job, UploadTarget *target)
+{
+  UploadBatch *batch = target->batch;
+
+  g_signal_handlers_disconnect_matched (job, G_SIGNAL_MATCH_DATA,
+                                        0, 0, NULL, NULL, target);
+  g_signal_handlers_disconnect_matched (job, G_SIGNAL_MATCH_FUNC,
+                                        0, 0, NULL, cb_update_info, NULL);
+
+  g_object_unref (job);
+  target->job = NULL;
+  target->percent = 100;
+
+  /* Dismiss the progress dialog once the slowest upload is done, after a
+   * cancellation too since the jobs reference the batch */
+  if (--batch->n_running == 0)
+    upload_batch_done (batch);
+}
+
+
+
+static void
+cb_batch_response (GtkWidget *dialog, gint response, UploadBatch *batch)
+{
+  guint i;
+
+  batch->cancelled = TRUE;
+
+  for (i = 0; i < batch->n_targets; i++)
+    if (batch->targets[i].job != NULL)
+      exo_job_cancel (EXO_JOB (batch->targets[i].job));
+}
+
+
+
+static void
+add_upload_target (UploadBatch      *batch,
+                   const gchar      *service,
+                   gint              action,
+                   gchar          *(*get_image_url) (const gchar *upload_name),
+                   ScreenshooterJob *job,
+                   GtkWidget        *label)
+{
+  UploadTarget *target;
+
+  g_return_if_fail (batch->n_targets < MAX_UPLOAD_TARGETS);
+
+  target = &batch->targets[batch->n_targets];
+  target->batch = batch;
+  target->job = job;
+  target->result = &batch->results[batch->n_targets];
+  target->result->service = service;
+  target->get_image_url = get_image_url;
+  target->action = action;
+
+  batch->n_targets++;
+  batch->n_running++;
+
+  g_signal_connect (job, "image-uploaded", G_CALLBACK (cb_target_uploaded), target);
+  g_signal_connect (job, "error", G_CALLBACK (cb_target_error), target);
+  g_signal_connect (job, "percent", G_CALLBACK (cb_target_percent), target);
+  g_signal_connect (job, "finished", G_CALLBACK (cb_target_finished), target);
+  g_signal_connect (job, "info-message", G_CALLBACK (cb_update_info), label);
+}
+
+
+
+/* Returns the services of @action whose hosts cannot be reached */
+static gint
+get_unreachable_targets (gint action, const gchar *ipfs_add_url)
+{
+  gint unreachable = 0;
+
+  if ((action & UPLOAD_IMGUR) &&
+      !screenshooter_spool_is_online (screenshooter_imgur_get_upload_url ()))
+    unreachable |= UPLOAD_IMGUR;
+
+  if ((action & UPLOAD_IPFS) &&
+      !screenshooter_spool_is_online (screenshooter_ipfs_get_upload_url (ipfs_add_url)))
+    unreachable |= UPLOAD_IPFS;
+
+  if (action & UPLOAD_S3)
+    {
+      gchar *s3_url = screenshooter_s3_get_upload_url ();
+
+      if (!screenshooter_spool_is_online (s3_url))
+        unreachable |= UPLOAD_S3;
+
+      g_free (s3_url);
+    }
+
+  return unreachable;
+}
+
+
+
+static void
+upload_artifact_unref (UploadArtifact *artifact)
+{
+  if (!g_atomic_int_dec_and_test (&artifact->ref_count))
+    return;
+
+  TRACE ("Delete %s", artifact->path);
+
+  g_unlink (artifact->path);
+  g_free (artifact->path);
+  g_free (artifact);
+}
+
+
+
+/* Keeps @artifact until @job is finalized */
+static void
+upload_artifact_add_job (UploadArtifact *artifact, ScreenshooterJob *job)
+{
+  if (artifact == NULL || job == NULL)
+    return;
+
+  g_atomic_int_inc (&artifact->ref_count);
+  g_object_set_data_full (G_OBJECT (job), "upload-artifact", artifact,
+                          (GDestroyNotify) upload_artifact_unref);
+}
+
+
+
+/* Uploads @image_path to all the services selected in @action at the
+ * same time. They all read the same encoded file, and one dialog shows
+ * their combined progress and then all the links, so the user waits for
+ * the slowest upload instead of the sum of them. This returns right away,
+ * the uploads run in the background. If @temporary, @image_path is a copy
+ * encoded for the uploads, deleted once they are done or queued. */
+static void
+upload_to_targets (const gchar    *image_path,
+                   gboolean        temporary,
+                   ScreenshotData *sd,
+                   gint            action)
+{
+  UploadBatch *batch;
+  UploadArtifact *artifact = NULL;
+  GtkWidget *label;
+  const gchar *title = sd->title;
+  gchar *ipfs_add_url = screenshooter_ipfs_get_add_url (sd);
+  GError *error = NULL;
+  gint unreachable;
+  guint i;
+
+  /* Held by the jobs uploading it, the queue makes its own copy */
+  if (temporary)
+    {
+      artifact = g_new0 (UploadArtifact, 1);
+      artifact->ref_count = 1;
+      artifact->path = g_strdup (image_path);
+    }
+
+  /* Do not make the user wait for the network, queue the uploads to the
+   * hosts which cannot be reached */
+  unreachable = get_unreachable_targets (action, ipfs_add_url);
+
+  if (unreachable != 0)
+    {
+      if (screenshooter_spool_add (image_path, title, unreachable, ipfs_add_url, &error))
+        xfce_dialog_show_info (NULL,
+                               _("The links will be added to the uploaded-links"
+                                 " file in the data directory."),
+                               _("The network is unavailable, the screenshot will"
+                                 " be uploaded in the background when it is back."));
+      else
+        {
+          screenshooter_error ("%s", error->message);
+          g_error_free (error);
         }
+
+      action &= ~unreachable;
     }
 
-  if (sd->action & CLIPBOARD)
-    screenshooter_copy_to_clipboard (sd->screenshot);
+  if ((action & UPLOAD_ACTIONS) == 0)
+    goto out;
 
-  if (sd->action & SAVE)
+  /* A single service keeps its own detailed result dialog */
+  if ((action & UPLOAD_ACTIONS) == UPLOAD_IMGUR)
+    {
+      upload_artifact_add_job (artifact, screenshooter_upload_to_imgur (image_path, title));
+      goto out;
+    }
+  else if ((action & UPLOAD_ACTIONS) == UPLOAD_IPFS)
+    {
+      /* The link is not copied over the screenshot of the clipboard action */
+      upload_artifact_add_job (artifact,
+                               screenshooter_upload_to_ipfs (image_path, title, ipfs_add_url,
+                                                             !(action & CLIPBOARD)));
+      goto out;
+    }
+
+  /* Released by upload_batch_done */
+  screenshooter_hold ();
+
+  batch = g_new0 (UploadBatch, 1);
+  batch->dialog = create_spinner_dialog (_("Upload"), &label);
+
+  if (action & UPLOAD_IMGUR)
+    add_upload_target (batch, _("Imgur"), UPLOAD_IMGUR, screenshooter_imgur_get_image_url,
+                       screenshooter_imgur_upload_launch (image_path, title),
+                       label);
+  if (action & UPLOAD_IPFS)
+    add_upload_target (batch, _("IPFS"), UPLOAD_IPFS, screenshooter_ipfs_get_image_url,
+                       screenshooter_ipfs_upload_launch (image_path, title, ipfs_add_url),
+                       label);
+  if (action & UPLOAD_S3)
+    add_upload_target (batch, _("S3"), UPLOAD_S3, screenshooter_s3_get_image_url,
+                       screenshooter_s3_upload_launch (image_path, title),
+                       label);
+
+  for (i = 0; i < batch->n_targets; i++)
+    upload_artifact_add_job (artifact, batch->targets[i].job);
+
+  g_signal_connect (batch->dialog, "response", G_CALLBACK (cb_batch_response), batch);
+
+  gtk_widget_show (batch->dialog);
+
+out:
+  if (artifact != NULL)
+    upload_artifact_unref (artifact);
+
+  g_free (ipfs_add_url);
+}
+
+
+
+/* Starts the connections to the hosts the screenshot will be uploaded to */
+static void
+prewarm_upload_targets (ScreenshotData *sd)
+{
+  if (sd->action & UPLOAD_IMGUR)
+    screenshooter_upload_prewarm (screenshooter_imgur_get_upload_url ());
+
+  if (sd->action & UPLOAD_IPFS)
+    {
+      gchar *ipfs_add_url = screenshooter_ipfs_get_add_url (sd);
+
+      screenshooter_upload_prewarm (screenshooter_ipfs_get_upload_url (ipfs_add_url));
+      g_free (ipfs_add_url);
+    }
+
+  if (sd->action & UPLOAD_S3)
+    {
+      gchar *s3_url = screenshooter_s3_get_upload_url ();
+
+      if (s3_url != NULL)
+        screenshooter_upload_prewarm (s3_url);
+
+      g_free (s3_url);
+    }
+}
+
+
+
+static void
+action_run_free (ActionRun *run)
+{
+  g_object_unref (run->screenshot);
+  g_free (run->app);
+
+  if (run->app_info != NULL)
+    g_object_unref (run->app_info);
+
+  g_free (run);
+}
+
+
+
+/* Sink of the pipeline: opens or uploads the encoded screenshot */
+static void
+deliver_frame (ScreenshooterFrame *frame, ActionRun *run)
+{
+  if (frame->error != NULL)
+    screenshooter_error ("%s", frame->error->message);
+
+  if (frame->path == NULL)
+    return;
+
+  if (run->action & OPEN)
+    screenshooter_open_screenshot (frame->path, run->app, run->app_info);
+
+  /* The copy encoded within the upload budget is only kept for the uploads */
+  if (run->action & UPLOAD_ACTIONS)
+    {
+      if (frame->upload_path != NULL && g_strcmp0 (frame->upload_path, frame->path) != 0)
+        upload_to_targets (frame->upload_path, TRUE, run->sd, run->action);
+      else
+        upload_to_targets (frame->path, FALSE, run->sd, run->action);
+    }
+}
+
+
+
+static gboolean
+cb_pipeline_drained (ActionRun *run)
+{
+  action_run_free (run);
+  screenshooter_release ();
+
+  return FALSE;
+}
+
+
+
+/* Runs the actions currently selected in the preferences on the
+ * screenshot of @run, then frees it */
+static void
+run_actions (ActionRun *run)
+{
+  ScreenshotData *sd = run->sd;
+
+  run->action = sd->action;
+  run->app = g_strdup (sd->app);
+  run->app_info = sd->app_info != NULL ? g_object_ref (sd->app_info) : NULL;
+
+  if (run->action & CLIPBOARD)
+    screenshooter_copy_to_clipboard (run->screenshot);
+
+  if (run->action & SAVE)
     {
       const gchar *save_location;
 
       if (sd->screenshot_dir == NULL)
         sd->screenshot_dir = screenshooter_get_xdg_image_dir_uri ();
 
-      save_location = screenshooter_save_screenshot (sd->screenshot,
+      save_location = screenshooter_save_screenshot (run->screenshot,
                                                      sd->screenshot_dir,
                                                      sd->title,
                                                      sd->timestamp,
@@ -105,38 +495,173 @@ gboolean screenshooter_action_idle (ScreenshotData *sd)
           temp = g_path_get_dirname (save_location);
           sd->screenshot_dir = g_build_filename ("file://", temp, NULL);
           TRACE ("New save directory: %s", sd->screenshot_dir);
+
+          /* The saved file is opened rather than a temporary copy */
+          if (run->action & OPEN)
+            {
+              screenshooter_open_screenshot (save_location, run->app, run->app_info);
+              run->action &= ~OPEN;
+            }
         }
     }
-  else
+
+  /* The actions are a set: the screenshot is also opened or uploaded
+   * when it was saved */
+  if (run->action & (OPEN | UPLOAD_ACTIONS))
     {
-      GFile *temp_dir = g_file_new_for_path (g_get_tmp_dir ());
-      const gchar *temp_dir_uri = g_file_get_uri (temp_dir);
-      const gchar *screenshot_path =
-        screenshooter_save_screenshot (sd->screenshot,
-                                       temp_dir_uri,
-                                       sd->title,
-                                       sd->timestamp,
-                                       FALSE,
-                                       FALSE);
-
-      if (screenshot_path != NULL)
+      ScreenshooterTransform transforms = SCREENSHOOTER_TRANSFORM_NONE;
+      ScreenshooterPipeline *pipeline;
+      gsize max_upload_bytes = 0;
+
+      /* Blank out the windows matching the redaction rules before the
+       * screenshot leaves the machine, and shrink the upload to the
+       * budget, the opened file keeps the PNG */
+      if (run->action & UPLOAD_ACTIONS)
         {
-          if (sd->action & OPEN)
-            screenshooter_open_screenshot (screenshot_path, sd->app, sd->app_info);
-          else if (sd->action & UPLOAD_IMGUR)
-            screenshooter_upload_to_imgur (screenshot_path, sd->title);
-		  else if (sd->action & UPLOAD_IPFS)
-            screenshooter_upload_to_ipfs (screenshot_path, sd->title);
+          transforms |= SCREENSHOOTER_TRANSFORM_REDACT;
+          max_upload_bytes = MAX (sd->max_upload_bytes, 0);
         }
 
-      g_object_unref (temp_dir);
+      pipeline =
+        screenshooter_pipeline_new (transforms, g_get_tmp_dir (),
+                                    sd->title, sd->timestamp, max_upload_bytes,
+                                    sd->pipeline_depth,
+                                    screenshooter_pipeline_parse_policy (sd->overflow_policy));
+
+      screenshooter_pipeline_add_sink (pipeline, (ScreenshooterFrameSink) deliver_frame, run);
+      screenshooter_pipeline_push (pipeline, run->screenshot);
+
+      /* @run is released once the screenshot is delivered */
+      screenshooter_pipeline_finish (pipeline, (GSourceFunc) cb_pipeline_drained, run);
+
+      return;
     }
 
-  if (!sd->plugin)
-    gtk_main_quit ();
+  action_run_free (run);
+  screenshooter_release ();
+}
+
 
-  g_object_unref (sd->screenshot);
 
-  return FALSE;
+static void
+cb_actions_response (GtkWidget *dialog, gint response, ActionRun *run)
+{
+  gtk_widget_destroy (dialog);
+
+  if (response == GTK_RESPONSE_CANCEL ||
+      response == GTK_RESPONSE_DELETE_EVENT ||
+      response == GTK_RESPONSE_CLOSE)
+    {
+      action_run_free (run);
+      screenshooter_release ();
+      return;
+    }
+
+  run_actions (run);
 }
 
+
+
+static void
+cb_captured (GObject *source, GAsyncResult *result, ScreenshotData *sd)
+{
+  ScreenshooterCapture *capture;
+  ActionRun *run;
+  GError *error = NULL;
+
+  capture = screenshooter_capture_finish (result, &error);
+
+  if (capture == NULL)
+    {
+      /* Nothing to report if the user cancelled the selection */
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        screenshooter_error ("%s", error->message);
+
+      g_error_free (error);
+      screenshooter_release ();
+      return;
+    }
+
+  run = g_new0 (ActionRun, 1);
+  run->sd = sd;
+  run->screenshot = g_object_ref (capture->screenshot);
+
+  /* Crop the uniform margins around windows and selected regions */
+  if (sd->trim && capture->region != FULLSCREEN)
+    {
+      GdkRectangle area;
+      GdkPixbuf *trimmed = screenshooter_trim_uniform_border (run->screenshot, &area);
+
+      screenshooter_redact_transfer (run->screenshot, trimmed, -area.x, -area.y);
+      g_object_unref (run->screenshot);
+      run->screenshot = trimmed;
+    }
+
+  screenshooter_capture_free (capture);
+
+  if (sd->action_specified)
+    run_actions (run);
+  else
+    {
+      /* The dialog does not block, the next screenshot can be taken
+       * while it is open */
+      GtkWidget *dialog = screenshooter_actions_dialog_new (sd, run->screenshot);
+
+      g_signal_connect (dialog, "response",
+                        G_CALLBACK (cb_help_response), NULL);
+      g_signal_connect (dialog, "response",
+                        G_CALLBACK (cb_actions_response), run);
+      g_signal_connect (dialog, "key-press-event",
+                        G_CALLBACK (screenshooter_f1_key), NULL);
+
+      gtk_widget_show (dialog);
+    }
+}
+
+
+
+/* Public */
+
+
+
+/**
+ * screenshooter_take_screenshot_idle:
+ * @sd: the #ScreenshotData holding the options of the screenshot.
+ *
+ * Starts taking a screenshot of the region of @sd, then runs its actions
+ * or asks for them. Nothing here waits for the user or the network: the
+ * capture, the dialogs and the uploads run from the main loop, so several
+ * screenshots can be on their way at the same time. Each of them holds
+ * the application with screenshooter_hold() until it is done.
+ *
+ * The delay is only applied after the selection of a region, the caller
+ * awaits it beforehand for the other regions.
+ *
+ * Return value: %FALSE, to be used as an idle or timeout callback.
+ **/
+gboolean screenshooter_take_screenshot_idle (ScreenshotData *sd)
+{
+  ScreenshooterCaptureRequest *request;
+
+  /* Connect to the upload hosts while the region is being selected */
+  if ((sd->action & UPLOAD_ACTIONS) && screenshooter_spool_is_online (NULL))
+    prewarm_upload_targets (sd);
+
+  /* Released once the screenshot is acted on */
+  screenshooter_hold ();
+
+  request = screenshooter_capture_request_new (sd->region,
+                                               sd->region == SELECT ? sd->delay : 0,
+                                               sd->show_mouse);
+
+  if (G_UNLIKELY (request == NULL))
+    {
+      screenshooter_release ();
+      return FALSE;
+    }
+
+  screenshooter_capture_async (request, NULL, (GAsyncReadyCallback) cb_captured, sd);
+  screenshooter_capture_request_unref (request);
+
+  return FALSE;
+}
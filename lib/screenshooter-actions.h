@@ -24,10 +24,17 @@
 #include "screenshooter-capture.h"
 #include "screenshooter-global.h"
 #include "screenshooter-dialogs.h"
+#include "screenshooter-encode.h"
 #include "screenshooter-imgur.h"
 #include "screenshooter-ipfs.h"
+#include "screenshooter-job-callbacks.h"
+#include "screenshooter-pipeline.h"
+#include "screenshooter-spool.h"
+#include "screenshooter-trim.h"
+#include "screenshooter-upload.h"
+#include "screenshooter-redact.h"
+#include "screenshooter-s3.h"
 
 gboolean screenshooter_take_screenshot_idle (ScreenshotData *sd);
-gboolean screenshooter_action_idle          (ScreenshotData *sd);
 
 #endif
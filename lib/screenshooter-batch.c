@@ -0,0 +1,362 @@
+/*  $Id$
+ *
+ *  Copyright © 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ * */
+
+#include "screenshooter-batch.h"
+#include "screenshooter-imgur.h"
+#include "screenshooter-ipfs.h"
+#include "screenshooter-s3.h"
+#include "screenshooter-upload.h"
+
+#include <signal.h>
+#include <stdio.h>
+
+#include <gio/gio.h>
+#include <glib-unix.h>
+#include <libxfce4util/libxfce4util.h>
+
+/* Bounds of the number of uploads running at the same time; more would
+ * only wait for a connection of the shared session to the same host */
+#define BATCH_MIN_JOBS 1
+#define BATCH_MAX_JOBS 8
+
+/* Cancellation group of the uploads of the batch */
+#define BATCH_JOB_GROUP "batch"
+
+
+
+typedef struct
+{
+  GMainLoop   *loop;
+  GQueue      *pending;
+  const gchar *service;
+  gchar       *endpoint;
+  gint         target;
+  gchar       *ipfs_add_url;
+  guint        n_jobs;
+  guint        n_running;
+  guint        n_failed;
+} BatchData;
+
+/* One file being uploaded */
+typedef struct
+{
+  BatchData *batch;
+  gchar     *path;
+  gchar     *checksum;
+} BatchFile;
+
+
+
+/* Internals */
+
+
+
+static void
+batch_file_free (BatchFile *file)
+{
+  g_free (file->path);
+  g_free (file->checksum);
+  g_free (file);
+}
+
+
+
+static gint
+compare_names (gconstpointer a, gconstpointer b)
+{
+  return g_strcmp0 (*(const gchar **) a, *(const gchar **) b);
+}
+
+
+
+/* Adds the images below @directory to @files, in a stable order */
+static void
+collect_images (const gchar *directory, GQueue *files)
+{
+  GPtrArray *names = g_ptr_array_new_with_free_func (g_free);
+  const gchar *name;
+  GDir *dir;
+  guint i;
+
+  dir = g_dir_open (directory, 0, NULL);
+
+  if (dir == NULL)
+    {
+      g_ptr_array_free (names, TRUE);
+      return;
+    }
+
+  while ((name = g_dir_read_name (dir)) != NULL)
+    g_ptr_array_add (names, g_strdup (name));
+
+  g_dir_close (dir);
+
+  g_ptr_array_sort (names, compare_names);
+
+  for (i = 0; i < names->len; i++)
+    {
+      gchar *path = g_build_filename (directory, g_ptr_array_index (names, i), NULL);
+
+      if (g_file_test (path, G_FILE_TEST_IS_SYMLINK))
+        g_free (path);
+      else if (g_file_test (path, G_FILE_TEST_IS_DIR))
+        {
+          collect_images (path, files);
+          g_free (path);
+        }
+      else
+        {
+          gchar *content_type = g_content_type_guess (path, NULL, 0, NULL);
+
+          if (g_str_has_prefix (content_type, "image/"))
+            g_queue_push_tail (files, path);
+          else
+            g_free (path);
+
+          g_free (content_type);
+        }
+    }
+
+  g_ptr_array_free (names, TRUE);
+}
+
+
+
+static void batch_pump (BatchData *batch);
+
+
+
+static void
+print_result (const gchar *path, const gchar *link)
+{
+  g_print ("%s\t%s\n", path, link);
+  fflush (stdout);
+}
+
+
+
+static void
+cb_file_uploaded (ScreenshooterJob *job, gchar *upload_name, BatchFile *file)
+{
+  gchar *link;
+
+  g_return_if_fail (upload_name != NULL);
+
+  if (file->batch->target == UPLOAD_IMGUR)
+    link = screenshooter_imgur_get_image_url (upload_name);
+  else if (file->batch->target == UPLOAD_S3)
+    link = screenshooter_s3_get_image_url (upload_name);
+  else
+    link = screenshooter_ipfs_get_image_url (upload_name);
+
+  screenshooter_upload_cache_store (file->batch->service, file->batch->endpoint,
+                                    file->checksum, link);
+  print_result (file->path, link);
+
+  g_free (link);
+}
+
+
+
+static void
+cb_file_error (ExoJob *job, GError *error, BatchFile *file)
+{
+  g_return_if_fail (error != NULL);
+
+  file->batch->n_failed++;
+  g_printerr ("%s\terror: %s\n", file->path, error->message);
+}
+
+
+
+static void
+cb_file_finished (ExoJob *job, BatchFile *file)
+{
+  BatchData *batch = file->batch;
+
+  g_signal_handlers_disconnect_by_data (job, file);
+  g_object_unref (job);
+  batch_file_free (file);
+
+  batch->n_running--;
+  batch_pump (batch);
+}
+
+
+
+/* Ctrl+C: the files not started yet are skipped, the running uploads are
+ * cancelled and the loop quits once they are wound down */
+static gboolean
+cb_interrupted (BatchData *batch)
+{
+  batch->n_failed += g_queue_get_length (batch->pending);
+  g_queue_foreach (batch->pending, (GFunc) g_free, NULL);
+  g_queue_clear (batch->pending);
+
+  screenshooter_job_cancel_group (BATCH_JOB_GROUP);
+
+  return TRUE;
+}
+
+
+
+/* Starts uploads until @batch runs n_jobs of them, quits the loop when
+ * everything is done */
+static void
+batch_pump (BatchData *batch)
+{
+  while (batch->n_running < batch->n_jobs && !g_queue_is_empty (batch->pending))
+    {
+      ScreenshooterJob *job;
+      BatchFile *file;
+      GError *error = NULL;
+      gchar *link, *title;
+
+      file = g_new0 (BatchFile, 1);
+      file->batch = batch;
+      file->path = g_queue_pop_head (batch->pending);
+      file->checksum = screenshooter_upload_compute_checksum (file->path, &error);
+
+      if (file->checksum == NULL)
+        {
+          batch->n_failed++;
+          g_printerr ("%s\terror: %s\n", file->path, error->message);
+          g_error_free (error);
+          batch_file_free (file);
+          continue;
+        }
+
+      /* Same contents already uploaded there */
+      link = screenshooter_upload_cache_lookup (batch->service, batch->endpoint,
+                                                file->checksum);
+
+      if (link != NULL)
+        {
+          print_result (file->path, link);
+          g_free (link);
+          batch_file_free (file);
+          continue;
+        }
+
+      title = g_path_get_basename (file->path);
+
+      if (batch->target == UPLOAD_IMGUR)
+        job = screenshooter_imgur_upload_launch (file->path, title);
+      else if (batch->target == UPLOAD_S3)
+        job = screenshooter_s3_upload_launch (file->path, title);
+      else
+        job = screenshooter_ipfs_upload_launch (file->path, title, batch->ipfs_add_url);
+
+      g_free (title);
+
+      screenshooter_job_set_priority (job, SCREENSHOOTER_JOB_PRIORITY_BACKGROUND);
+      screenshooter_job_set_group (job, BATCH_JOB_GROUP);
+
+      g_signal_connect (job, "image-uploaded", G_CALLBACK (cb_file_uploaded), file);
+      g_signal_connect (job, "error", G_CALLBACK (cb_file_error), file);
+      g_signal_connect (job, "finished", G_CALLBACK (cb_file_finished), file);
+
+      batch->n_running++;
+    }
+
+  if (batch->n_running == 0 && g_queue_is_empty (batch->pending))
+    g_main_loop_quit (batch->loop);
+}
+
+
+
+/* Public */
+
+
+
+/**
+ * screenshooter_batch_upload:
+ * @directory: the directory whose images are uploaded, recursively.
+ * @target: UPLOAD_IMGUR, UPLOAD_IPFS or UPLOAD_S3.
+ * @n_jobs: the number of uploads running at the same time.
+ * @sd: the #ScreenshotData holding the preferences of the services.
+ *
+ * Uploads all the images below @directory, running @n_jobs uploads at a
+ * time over the shared session, and prints a manifest line "path\tlink"
+ * on the standard output as each of them is done. Files whose contents
+ * were already uploaded to the same server, node or bucket of @target,
+ * according to the upload cache, are not uploaded again. Failures
+ * are reported on the standard error. The uploads run in the background
+ * class of the job scheduler and are cancelled on SIGINT.
+ *
+ * Return value: the number of files which could not be uploaded.
+ **/
+guint
+screenshooter_batch_upload (const gchar          *directory,
+                            gint                  target,
+                            guint                 n_jobs,
+                            const ScreenshotData *sd)
+{
+  BatchData batch = { 0 };
+  guint interrupt_id;
+
+  g_return_val_if_fail (directory != NULL, 1);
+  g_return_val_if_fail (target == UPLOAD_IMGUR || target == UPLOAD_IPFS ||
+                        target == UPLOAD_S3, 1);
+
+  if (!g_file_test (directory, G_FILE_TEST_IS_DIR))
+    {
+      g_printerr (_("%s is not a valid directory.\n"), directory);
+      return 1;
+    }
+
+  batch.pending = g_queue_new ();
+  batch.target = target;
+  batch.service = target == UPLOAD_IMGUR ? "imgur" : target == UPLOAD_S3 ? "s3" : "ipfs";
+  batch.ipfs_add_url = screenshooter_ipfs_get_add_url (sd);
+
+  /* Links are only reused from the same server, node or bucket */
+  if (target == UPLOAD_IMGUR)
+    batch.endpoint = g_strdup (screenshooter_imgur_get_upload_url ());
+  else if (target == UPLOAD_S3)
+    batch.endpoint = screenshooter_s3_get_upload_url ();
+  else
+    batch.endpoint = g_strdup (screenshooter_ipfs_get_upload_url (batch.ipfs_add_url));
+
+  batch.n_jobs = CLAMP (n_jobs, BATCH_MIN_JOBS, BATCH_MAX_JOBS);
+
+  /* The scheduler would hold back the uploads beyond its own limit */
+  screenshooter_job_set_upload_slots (batch.n_jobs);
+
+  collect_images (directory, batch.pending);
+
+  TRACE ("Upload %u images with %u jobs", g_queue_get_length (batch.pending), batch.n_jobs);
+
+  batch.loop = g_main_loop_new (NULL, FALSE);
+
+  interrupt_id = g_unix_signal_add (SIGINT, (GSourceFunc) cb_interrupted, &batch);
+
+  batch_pump (&batch);
+
+  if (batch.n_running > 0)
+    g_main_loop_run (batch.loop);
+
+  g_source_remove (interrupt_id);
+  g_main_loop_unref (batch.loop);
+  g_queue_free_full (batch.pending, g_free);
+  g_free (batch.ipfs_add_url);
+  g_free (batch.endpoint);
+
+  return batch.n_failed;
+}
@@ -0,0 +1,368 @@
+/*  $Id$
+ *
+ *  Copyright © 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ * */
+
+#include "screenshooter-burst.h"
+#include "screenshooter-capture.h"
+#include "screenshooter-dialogs.h"
+#include "screenshooter-simple-job.h"
+#include "screenshooter-utils.h"
+
+#include <libxfce4util/libxfce4util.h>
+
+
+
+typedef struct
+{
+  GMainLoop        *loop;
+  GdkWindow        *root;
+  GdkRectangle      area;
+  gchar            *directory;
+  const gchar      *title;
+  gchar            *datetime;
+  guint             n_frames;
+  gint64            interval;
+
+  /* Allocated before the first grab, the burst only paints into them */
+  cairo_surface_t **frames;
+
+  guint             n_writing;
+  gint              n_failed;
+  gboolean          success;
+} BurstData;
+
+
+
+/* Internals */
+
+
+
+static gboolean
+allocate_frames (BurstData *data)
+{
+  guint i;
+
+  data->frames = g_new0 (cairo_surface_t *, data->n_frames);
+
+  for (i = 0; i < data->n_frames; i++)
+    {
+      data->frames[i] = cairo_image_surface_create (CAIRO_FORMAT_RGB24,
+                                                    data->area.width,
+                                                    data->area.height);
+
+      if (cairo_surface_status (data->frames[i]) != CAIRO_STATUS_SUCCESS)
+        {
+          g_printerr (_("Not enough memory for %u screenshots of %dx%d.\n"),
+                      data->n_frames, data->area.width, data->area.height);
+          return FALSE;
+        }
+    }
+
+  return TRUE;
+}
+
+
+
+/* Job writing one of the frames, in one of the processor slots */
+static gboolean
+write_frame_job (ScreenshooterJob *job, GArray *param_values, GError **error)
+{
+  BurstData *data = g_value_get_pointer (&g_array_index (param_values, GValue, 0));
+  guint i = g_value_get_uint (&g_array_index (param_values, GValue, 1));
+  cairo_status_t status;
+  gchar *name, *path;
+
+  name = g_strdup_printf ("%s_%s_%03u.png", data->title, data->datetime, i + 1);
+  path = g_build_filename (data->directory, name, NULL);
+
+  status = cairo_surface_write_to_png (data->frames[i], path);
+
+  if (status == CAIRO_STATUS_SUCCESS)
+    g_print ("%s\n", path);
+  else
+    {
+      g_printerr ("%s\terror: %s\n", path, cairo_status_to_string (status));
+      g_atomic_int_inc (&data->n_failed);
+    }
+
+  g_free (name);
+  g_free (path);
+
+  return TRUE;
+}
+
+
+
+static void
+cb_frame_written (ExoJob *job, BurstData *data)
+{
+  g_signal_handlers_disconnect_by_data (job, data);
+  g_object_unref (job);
+
+  if (--data->n_writing > 0)
+    return;
+
+  data->success = g_atomic_int_get (&data->n_failed) == 0;
+  g_main_loop_quit (data->loop);
+}
+
+
+
+/* The frames are only encoded once the burst is over and the user chose
+ * which ones to keep, in interactive jobs taking turns with the other
+ * encodes of the process */
+static void
+write_frames (BurstData *data, gint keep)
+{
+  ScreenshooterJob *job;
+  guint i;
+
+  for (i = 0; i < data->n_frames; i++)
+    if (keep < 0 || (guint) keep == i)
+      {
+        job = screenshooter_simple_job_launch_with_priority (SCREENSHOOTER_JOB_PRIORITY_INTERACTIVE,
+                                                             write_frame_job, 2,
+                                                             G_TYPE_POINTER, data,
+                                                             G_TYPE_UINT, i);
+        g_signal_connect (job, "finished", G_CALLBACK (cb_frame_written), data);
+        data->n_writing++;
+      }
+}
+
+
+
+static void
+cb_dialog_response (GtkWidget *dialog, gint response, BurstData *data)
+{
+  gint selected = screenshooter_burst_dialog_get_selected (dialog);
+
+  gtk_widget_destroy (dialog);
+
+  if (response == SCREENSHOOTER_RESPONSE_KEEP_ALL)
+    write_frames (data, -1);
+  else if (response == GTK_RESPONSE_OK && selected >= 0)
+    write_frames (data, selected);
+
+  /* Otherwise the loop quits once the last frame is written */
+  if (data->n_writing == 0)
+    {
+      data->success = TRUE;
+      g_main_loop_quit (data->loop);
+    }
+}
+
+
+
+static gboolean
+grab_frames (BurstData *data)
+{
+  GtkWidget *dialog;
+  cairo_pattern_t *source;
+  cairo_t *cr;
+  gint64 start, end;
+  guint i;
+
+  if (!allocate_frames (data))
+    {
+      g_main_loop_quit (data->loop);
+      return FALSE;
+    }
+
+  TRACE ("Grab %u frames of %dx%d+%d+%d", data->n_frames,
+         data->area.width, data->area.height, data->area.x, data->area.y);
+
+  /* The pattern of the root window is set up once for all the frames */
+  cr = cairo_create (data->frames[0]);
+  gdk_cairo_set_source_window (cr, data->root, -data->area.x, -data->area.y);
+  source = cairo_pattern_reference (cairo_get_source (cr));
+  cairo_destroy (cr);
+
+  /* Nothing else happens during the burst, so the frames are grabbed in
+   * a row rather than from the main loop */
+  start = g_get_monotonic_time ();
+
+  for (i = 0; i < data->n_frames; i++)
+    {
+      gint64 deadline = start + (gint64) i * data->interval;
+      gint64 now = g_get_monotonic_time ();
+
+      if (deadline > now)
+        g_usleep (deadline - now);
+
+      cr = cairo_create (data->frames[i]);
+      cairo_set_source (cr, source);
+      cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+      cairo_paint (cr);
+      cairo_destroy (cr);
+    }
+
+  end = g_get_monotonic_time ();
+
+  cairo_pattern_destroy (source);
+
+  data->datetime = screenshooter_get_datetime ("%Y-%m-%d_%H-%M-%S");
+
+  g_print (_("%u screenshots in %.0f ms, %.1f per second\n"),
+           data->n_frames, (end - start) / 1000.0,
+           end > start ? data->n_frames * (gdouble) G_USEC_PER_SEC / (end - start) : 0.0);
+
+  for (i = 0; i < data->n_frames; i++)
+    cairo_surface_flush (data->frames[i]);
+
+  /* Let the user pick the frames to keep */
+  dialog = screenshooter_burst_dialog_new (data->frames, data->n_frames);
+  g_signal_connect (dialog, "response", G_CALLBACK (cb_dialog_response), data);
+  gtk_widget_show (dialog);
+
+  return FALSE;
+}
+
+
+
+static gboolean
+start_burst (BurstData *data)
+{
+  if (!screenshooter_capture_get_area (ACTIVE_WINDOW, &data->area))
+    {
+      g_printerr (_("The captured area is off the screen.\n"));
+      g_main_loop_quit (data->loop);
+      return FALSE;
+    }
+
+  return grab_frames (data);
+}
+
+
+
+/* The region was selected, and the delay elapsed */
+static void
+cb_area_captured (GObject *source, GAsyncResult *result, BurstData *data)
+{
+  ScreenshooterCapture *capture;
+  GError *error = NULL;
+
+  capture = screenshooter_capture_finish (result, &error);
+
+  if (capture == NULL)
+    {
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        g_printerr ("%s\n", error->message);
+
+      g_error_free (error);
+      g_main_loop_quit (data->loop);
+      return;
+    }
+
+  data->area = capture->area;
+  screenshooter_capture_free (capture);
+
+  grab_frames (data);
+}
+
+
+
+/* Public */
+
+
+
+/**
+ * screenshooter_burst_capture:
+ * @sd: the #ScreenshotData holding the save directory and the title.
+ * @region: FULLSCREEN, ACTIVE_WINDOW or SELECT.
+ * @delay: the delay before the burst, in seconds.
+ * @n_frames: the number of screenshots of the burst.
+ * @interval: the time between two screenshots, in milliseconds, 0 to
+ * take them as fast as possible.
+ *
+ * Takes @n_frames screenshots of @region in a row, to catch menus,
+ * tooltips or animations. The area of @region is computed as for a
+ * single screenshot, then grabbed into buffers allocated beforehand.
+ * Once the burst is over, the user keeps one screenshot or all of them
+ * in the save directory of @sd; they are only encoded then.
+ *
+ * The mouse pointer is not drawn.
+ *
+ * Return value: %FALSE if the burst could not be taken or the
+ * screenshots kept could not be written.
+ **/
+gboolean
+screenshooter_burst_capture (const ScreenshotData *sd,
+                             gint                  region,
+                             gint                  delay,
+                             guint                 n_frames,
+                             guint                 interval)
+{
+  BurstData data = { 0 };
+  guint i;
+
+  g_return_val_if_fail (sd != NULL, FALSE);
+  g_return_val_if_fail (n_frames > 0, FALSE);
+
+  data.directory = g_filename_from_uri (sd->screenshot_dir, NULL, NULL);
+
+  if (data.directory == NULL || !g_file_test (data.directory, G_FILE_TEST_IS_DIR))
+    {
+      g_printerr (_("%s is not a valid local directory.\n"), sd->screenshot_dir);
+      g_free (data.directory);
+      return FALSE;
+    }
+
+  data.root = gdk_get_default_root_window ();
+  data.title = sd->title;
+  data.n_frames = n_frames;
+  data.interval = (gint64) interval * 1000;
+  data.loop = g_main_loop_new (NULL, FALSE);
+
+  if (region == SELECT)
+    {
+      /* The delay is applied after the selection */
+      ScreenshooterCaptureRequest *request =
+        screenshooter_capture_request_new (region, delay, FALSE);
+
+      screenshooter_capture_async (request, NULL,
+                                   (GAsyncReadyCallback) cb_area_captured, &data);
+      screenshooter_capture_request_unref (request);
+    }
+  else if (region == FULLSCREEN)
+    {
+      screenshooter_capture_get_area (FULLSCREEN, &data.area);
+      g_timeout_add_seconds (MAX (delay, 0), (GSourceFunc) grab_frames, &data);
+    }
+  else
+    {
+      /* The active window is the one at the end of the delay */
+      g_timeout_add_seconds (MAX (delay, 0), (GSourceFunc) start_burst, &data);
+    }
+
+  g_main_loop_run (data.loop);
+
+  if (data.frames != NULL)
+    {
+      for (i = 0; i < data.n_frames; i++)
+        if (data.frames[i] != NULL)
+          cairo_surface_destroy (data.frames[i]);
+
+      g_free (data.frames);
+    }
+
+  g_main_loop_unref (data.loop);
+  g_free (data.directory);
+  g_free (data.datetime);
+
+  return data.success;
+}
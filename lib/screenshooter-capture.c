@@ -42,6 +42,11 @@ typedef struct
   gint y_root;
   cairo_rectangle_int_t rectangle;
   cairo_rectangle_int_t rectangle_root;
+  GtkWidget *window;
+  GdkCursor *cursor;
+  guint grab_id;
+  GSource *cancel_source;
+  GTask *task;
 } RubberBandData;
 
 /* For non-composited environments */
@@ -53,9 +58,40 @@ typedef struct
   gint anchor;
   cairo_rectangle_int_t rectangle;
   gint x1, y1; /* holds the position where the mouse was pressed */
-  GC *context;
+  GC context;
+  GdkCursor *cursor;
+  guint grab_id;
+  GSource *cancel_source;
+  GTask *task;
 } RbData;
 
+/* Whether a region is being selected by this process: the X server
+ * grants the grabs again to the client which holds them */
+static gboolean selection_active = FALSE;
+
+/* Immutable description of a capture */
+struct _ScreenshooterCaptureRequest
+{
+  gint     ref_count;
+  gint     region;
+  gint     delay;
+  gboolean show_mouse;
+};
+
+/* Result of screenshooter_take_screenshot () */
+typedef struct
+{
+  GMainLoop *loop;
+  GdkPixbuf *screenshot;
+} SyncCapture;
+
+/* State of a capture in flight, owned by its task */
+typedef struct
+{
+  ScreenshooterCaptureRequest *request;
+  GdkRectangle                 area;
+} CaptureData;
+
 
 /* Prototypes */
 
@@ -72,13 +108,20 @@ static GdkPixbuf       *get_cursor_pixbuf                   (GdkDisplay *display
                                                              gint *cursory,
                                                              gint *xhot,
                                                              gint *yhot);
+static void             clip_to_screen                      (const GdkRectangle *rectangle,
+                                                             GdkRectangle   *area);
 static GdkPixbuf       *get_window_screenshot               (GdkWindow      *window,
                                                              gboolean        show_mouse,
-                                                             gboolean        border);
+                                                             gboolean        border,
+                                                             GdkRectangle   *area);
 static GdkFilterReturn  region_filter_func                  (GdkXEvent      *xevent,
                                                              GdkEvent       *event,
                                                              RbData         *rbdata);
-static GdkPixbuf       *get_rectangle_screenshot            (gint delay);
+static void             start_selection                     (GTask          *task);
+static gboolean         cb_grab_devices                     (RbData         *rbdata);
+static void             end_selection                       (RbData         *rbdata);
+static gboolean         cb_selection_cancelled              (GCancellable   *cancellable,
+                                                             RbData         *rbdata);
 static gboolean         cb_key_pressed                      (GtkWidget      *widget,
                                                              GdkEventKey    *event,
                                                              RubberBandData *rbdata);
@@ -97,7 +140,22 @@ static gboolean         cb_button_released                  (GtkWidget      *wid
 static gboolean         cb_motion_notify                    (GtkWidget      *widget,
                                                              GdkEventMotion *event,
                                                              RubberBandData *rbdata);
-static GdkPixbuf       *get_rectangle_screenshot_composited (gint delay);
+static void             start_selection_composited          (GTask          *task);
+static gboolean         cb_grab_devices_composited          (RubberBandData *rbdata);
+static void             end_selection_composited            (RubberBandData *rbdata,
+                                                             GError         *error);
+static gboolean         cb_selection_cancelled_composited   (GCancellable   *cancellable,
+                                                             RubberBandData *rbdata);
+static GSource         *watch_cancellable                   (GTask          *task,
+                                                             GSourceFunc     func,
+                                                             gpointer        data);
+static gboolean         grab_devices                        (GdkWindow      *window,
+                                                             GdkCursor      *cursor,
+                                                             GError        **error);
+static void             ungrab_devices                      (void);
+static void             complete_selection                  (GTask          *task,
+                                                             GError         *error);
+static gboolean         cb_capture_due                      (GTask          *task);
 
 
 
@@ -287,10 +345,40 @@ fallback:
 }
 
 
+/* Sets @area to the part of @rectangle which is on the screen */
+static void
+clip_to_screen (const GdkRectangle *rectangle, GdkRectangle *area)
+{
+  TRACE ("Make sure we don't grab things offscreen");
+
+  *area = *rectangle;
+
+  if (area->x < 0)
+    {
+      area->width = area->width + area->x;
+      area->x = 0;
+    }
+
+  if (area->y < 0)
+    {
+      area->height = area->height + area->y;
+      area->y = 0;
+    }
+
+  if (area->x + area->width > gdk_screen_width ())
+    area->width = gdk_screen_width () - area->x;
+
+  if (area->y + area->height > gdk_screen_height ())
+    area->height = gdk_screen_height () - area->y;
+}
+
+
+
 static GdkPixbuf
-*get_window_screenshot (GdkWindow *window,
-                        gboolean show_mouse,
-                        gboolean border)
+*get_window_screenshot (GdkWindow    *window,
+                        gboolean      show_mouse,
+                        gboolean      border,
+                        GdkRectangle *area)
 {
   gint x_orig, y_orig;
   gint width, height;
@@ -317,31 +405,12 @@ static GdkPixbuf
   gdk_window_get_origin (window, &rectangle.x, &rectangle.y);
 
   /* Don't grab thing offscreen. */
+  clip_to_screen (&rectangle, area);
 
-  TRACE ("Make sure we don't grab things offscreen");
-
-  x_orig = rectangle.x;
-  y_orig = rectangle.y;
-  width  = rectangle.width;
-  height = rectangle.height;
-
-  if (x_orig < 0)
-    {
-      width = width + x_orig;
-      x_orig = 0;
-    }
-
-  if (y_orig < 0)
-    {
-      height = height + y_orig;
-      y_orig = 0;
-    }
-
-  if (x_orig + width > gdk_screen_width ())
-    width = gdk_screen_width () - x_orig;
-
-  if (y_orig + height > gdk_screen_height ())
-    height = gdk_screen_height () - y_orig;
+  x_orig = area->x;
+  y_orig = area->y;
+  width  = area->width;
+  height = area->height;
 
   /* Take the screenshot from the root GdkWindow, to grab things such as
    * menus. */
@@ -499,6 +568,8 @@ static GdkPixbuf
           }
     }
 
+  screenshooter_redact_collect (screenshot, x_orig, y_orig);
+
   return screenshot;
 }
 
@@ -512,8 +583,8 @@ static gboolean cb_key_pressed (GtkWidget      *widget,
 
   if (key == GDK_KEY_Escape)
     {
-      gtk_widget_hide (widget);
       rbdata->cancelled = TRUE;
+      end_selection_composited (rbdata, NULL);
       return TRUE;
     }
 
@@ -641,7 +712,7 @@ static gboolean cb_button_released (GtkWidget *widget,
     {
       if (rbdata->rubber_banding)
         {
-          gtk_dialog_response (GTK_DIALOG (widget), GTK_RESPONSE_NONE);
+          end_selection_composited (rbdata, NULL);
           return TRUE;
         }
       else
@@ -764,8 +835,9 @@ static gboolean cb_motion_notify (GtkWidget *widget,
 
 
 static GdkPixbuf
-*capture_rectangle_screenshot (gint x, gint y, gint w, gint h, gint delay)
+*capture_rectangle_screenshot (GdkRectangle *area)
 {
+  GdkPixbuf *screenshot;
   GdkWindow *root;
   int root_width, root_height;
 
@@ -774,53 +846,147 @@ static GdkPixbuf
   root_height = gdk_window_get_height (root);
 
   /* Avoid rectangle parts outside the screen */
-  if (x < 0)
-    w += x;
-  if (y < 0)
-    h += y;
-
-  x = MAX(0, x);
-  y = MAX(0, y);
-
-  if (x + w > root_width)
-    w = root_width - x;
-  if (y + h > root_height)
-    h = root_height - y;
-
-  /* Await the specified delay, but not less than 200ms */
-  if (delay == 0)
-    g_usleep (200000);
-  else
-    sleep (delay);
+  if (area->x < 0)
+    area->width += area->x;
+  if (area->y < 0)
+    area->height += area->y;
+
+  area->x = MAX(0, area->x);
+  area->y = MAX(0, area->y);
+
+  if (area->x + area->width > root_width)
+    area->width = root_width - area->x;
+  if (area->y + area->height > root_height)
+    area->height = root_height - area->y;
 
-  return gdk_pixbuf_get_from_window (root, x, y, w, h);
+  screenshot = gdk_pixbuf_get_from_window (root, area->x, area->y,
+                                           area->width, area->height);
+
+  if (G_LIKELY (screenshot != NULL))
+    screenshooter_redact_collect (screenshot, area->x, area->y);
+
+  return screenshot;
 }
 
 
 
-static GdkPixbuf
-*get_rectangle_screenshot_composited (gint delay)
+/* Grabs the mouse and the keyboard to prevent any interaction with
+ * other applications during the selection */
+static gboolean
+grab_devices (GdkWindow *window, GdkCursor *cursor, GError **error)
 {
-  GtkWidget *window;
-  RubberBandData rbdata;
-  GdkPixbuf *screenshot = NULL;
-  GdkWindow *root;
   GdkDevice *pointer, *keyboard;
   GdkGrabStatus res;
   GdkSeat   *seat;
-  GdkCursor *xhair_cursor;
+
+  seat = gdk_display_get_default_seat (gdk_display_get_default ());
+  pointer = gdk_seat_get_pointer (seat);
+  keyboard = gdk_seat_get_keyboard (seat);
+
+  res = gdk_device_grab (keyboard, window,
+                         GDK_OWNERSHIP_NONE, FALSE,
+                         GDK_KEY_PRESS_MASK |
+                         GDK_KEY_RELEASE_MASK,
+                         NULL, GDK_CURRENT_TIME);
+
+  if (res != GDK_GRAB_SUCCESS)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_BUSY, _("Failed to grab the keyboard."));
+      return FALSE;
+    }
+
+  res = gdk_device_grab (pointer, window,
+                         GDK_OWNERSHIP_NONE, FALSE,
+                         GDK_POINTER_MOTION_MASK |
+                         GDK_BUTTON_PRESS_MASK |
+                         GDK_BUTTON_RELEASE_MASK,
+                         cursor, GDK_CURRENT_TIME);
+
+  if (res != GDK_GRAB_SUCCESS)
+    {
+      gdk_device_ungrab (keyboard, GDK_CURRENT_TIME);
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_BUSY, _("Failed to grab the pointer."));
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+
+
+static void
+ungrab_devices (void)
+{
+  GdkSeat *seat = gdk_display_get_default_seat (gdk_display_get_default ());
+
+  gdk_device_ungrab (gdk_seat_get_pointer (seat), GDK_CURRENT_TIME);
+  gdk_device_ungrab (gdk_seat_get_keyboard (seat), GDK_CURRENT_TIME);
+}
+
+
+
+/* Completes @task with @error, or awaits its delay now that the region
+ * is selected */
+static void
+complete_selection (GTask *task, GError *error)
+{
+  CaptureData *data = g_task_get_task_data (task);
+
+  selection_active = FALSE;
+
+  if (error != NULL)
+    {
+      g_task_return_error (task, error);
+      g_object_unref (task);
+      return;
+    }
+
+  /* Await the specified delay, but not less than 200ms so that the
+   * selection is gone from the screen */
+  if (data->request->delay == 0)
+    g_timeout_add (200, (GSourceFunc) cb_capture_due, task);
+  else
+    g_timeout_add_seconds (data->request->delay, (GSourceFunc) cb_capture_due, task);
+}
+
+
+
+/* Calls @func with @data in the main loop when the cancellable of @task
+ * is cancelled, until the returned source is destroyed */
+static GSource *
+watch_cancellable (GTask *task, GSourceFunc func, gpointer data)
+{
+  GCancellable *cancellable = g_task_get_cancellable (task);
+  GSource *source;
+
+  if (cancellable == NULL)
+    return NULL;
+
+  source = g_cancellable_source_new (cancellable);
+  g_source_set_callback (source, func, data, NULL);
+  g_source_attach (source, NULL);
+
+  return source;
+}
+
+
+
+/* Shows the window the rubber banding is drawn on; the selection goes on
+ * from its signal handlers, which end it with end_selection_composited () */
+static void
+start_selection_composited (GTask *task)
+{
+  RubberBandData *rbdata;
+  GtkWidget *window;
 
   /* Initialize the rubber band data */
-  rbdata.left_pressed = FALSE;
-  rbdata.rubber_banding = FALSE;
-  rbdata.x = rbdata.y = 0;
-  rbdata.cancelled = FALSE;
-  rbdata.move_rectangle = FALSE;
-  rbdata.anchor = ANCHOR_UNSET;
+  rbdata = g_new0 (RubberBandData, 1);
+  rbdata->anchor = ANCHOR_UNSET;
+  rbdata->task = task;
 
   /* Create the fullscreen window on which the rubber banding
    * will be drawn. */
-  window = gtk_dialog_new ();
+  window = rbdata->window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
   gtk_window_set_decorated (GTK_WINDOW (window), FALSE);
   gtk_window_set_deletable (GTK_WINDOW (window), FALSE);
   gtk_window_set_resizable (GTK_WINDOW (window), FALSE);
@@ -835,23 +1001,23 @@ static GdkPixbuf
 
   /* Connect to the interesting signals */
   g_signal_connect (window, "key-press-event",
-                    G_CALLBACK (cb_key_pressed), &rbdata);
+                    G_CALLBACK (cb_key_pressed), rbdata);
   g_signal_connect (window, "key-release-event",
-                    G_CALLBACK (cb_key_released), &rbdata);
+                    G_CALLBACK (cb_key_released), rbdata);
   g_signal_connect (window, "draw",
-                    G_CALLBACK (cb_draw), &rbdata);
+                    G_CALLBACK (cb_draw), rbdata);
   g_signal_connect (window, "button-press-event",
-                    G_CALLBACK (cb_button_pressed), &rbdata);
+                    G_CALLBACK (cb_button_pressed), rbdata);
   g_signal_connect (window, "button-release-event",
-                    G_CALLBACK (cb_button_released), &rbdata);
+                    G_CALLBACK (cb_button_released), rbdata);
   g_signal_connect (window, "motion-notify-event",
-                    G_CALLBACK (cb_motion_notify), &rbdata);
+                    G_CALLBACK (cb_motion_notify), rbdata);
 
   /* This window is not managed by the window manager, we have to set everything
    * ourselves */
   gtk_widget_realize (window);
-  xhair_cursor = gdk_cursor_new_for_display (gdk_display_get_default (), GDK_CROSSHAIR);
-  gdk_window_set_cursor (gtk_widget_get_window (window), xhair_cursor);
+  rbdata->cursor = gdk_cursor_new_for_display (gdk_display_get_default (), GDK_CROSSHAIR);
+  gdk_window_set_cursor (gtk_widget_get_window (window), rbdata->cursor);
   gdk_window_set_override_redirect (gtk_widget_get_window (window), TRUE);
   gtk_widget_set_size_request (window,
                                gdk_screen_get_width (gdk_screen_get_default ()),
@@ -862,69 +1028,83 @@ static GdkPixbuf
   gdk_flush ();
 
   /* Wait 100ms before grabbing devices, useful when invoked by global hotkey
-   * because xfsettings will grab the key for a moment */ 
-  g_usleep(100000);
+   * because xfsettings will grab the key for a moment */
+  rbdata->grab_id = g_timeout_add (100, (GSourceFunc) cb_grab_devices_composited, rbdata);
 
-  /* Grab the mouse and the keyboard to prevent any interaction with other
-   * applications */
-  seat = gdk_display_get_default_seat (gdk_display_get_default ());
-  pointer = gdk_seat_get_pointer (seat);
-  keyboard = gdk_seat_get_keyboard (seat);
+  rbdata->cancel_source =
+    watch_cancellable (task, (GSourceFunc) cb_selection_cancelled_composited, rbdata);
+}
 
-  res = gdk_device_grab (keyboard, gtk_widget_get_window (window),
-                         GDK_OWNERSHIP_NONE, FALSE,
-                         GDK_KEY_PRESS_MASK |
-                         GDK_KEY_RELEASE_MASK,
-                         NULL, GDK_CURRENT_TIME);
 
-  if (res != GDK_GRAB_SUCCESS)
+
+static gboolean
+cb_grab_devices_composited (RubberBandData *rbdata)
+{
+  GError *error = NULL;
+
+  rbdata->grab_id = 0;
+
+  if (!grab_devices (gtk_widget_get_window (rbdata->window), NULL, &error))
+    end_selection_composited (rbdata, error);
+
+  return FALSE;
+}
+
+
+
+/* Hides the rubber banding, releases the devices and completes the
+ * capture, with @error if it is set */
+static void
+end_selection_composited (RubberBandData *rbdata, GError *error)
+{
+  CaptureData *data = g_task_get_task_data (rbdata->task);
+
+  if (rbdata->grab_id != 0)
+    g_source_remove (rbdata->grab_id);
+
+  if (rbdata->cancel_source != NULL)
     {
-      gtk_widget_destroy (window);
-      g_object_unref (xhair_cursor);
-      g_warning ("Failed to grab keyboard");
-      return NULL;
+      g_source_destroy (rbdata->cancel_source);
+      g_source_unref (rbdata->cancel_source);
     }
 
-  res = gdk_device_grab (pointer, gtk_widget_get_window (window),
-                         GDK_OWNERSHIP_NONE, FALSE,
-                         GDK_POINTER_MOTION_MASK |
-                         GDK_BUTTON_PRESS_MASK | 
-                         GDK_BUTTON_RELEASE_MASK,
-                         NULL, GDK_CURRENT_TIME);
+  /* Called from the handlers of the window, none may run once it is freed */
+  g_signal_handlers_disconnect_matched (rbdata->window, G_SIGNAL_MATCH_DATA,
+                                        0, 0, NULL, NULL, rbdata);
+  gtk_widget_destroy (rbdata->window);
+  g_object_unref (rbdata->cursor);
+  gdk_flush();
 
-  if (res != GDK_GRAB_SUCCESS)
+  /* Ungrab the mouse and the keyboard */
+  ungrab_devices ();
+  gdk_flush ();
+
+  if (error == NULL && rbdata->cancelled)
+    error = g_error_new (G_IO_ERROR, G_IO_ERROR_CANCELLED, _("The selection was cancelled."));
+
+  if (error == NULL)
     {
-      gtk_widget_destroy (window);
-      g_object_unref (xhair_cursor);
-      gdk_device_ungrab (keyboard, GDK_CURRENT_TIME);
-      g_warning ("Failed to grab pointer");
-      return NULL;
+      data->area.x = rbdata->rectangle_root.x;
+      data->area.y = rbdata->rectangle_root.y;
+      data->area.width = rbdata->rectangle.width;
+      data->area.height = rbdata->rectangle.height;
     }
 
-  gtk_dialog_run (GTK_DIALOG (window));
-  gtk_widget_destroy (window);
-  g_object_unref (xhair_cursor);
-  gdk_flush();
+  complete_selection (rbdata->task, error);
+  g_free (rbdata);
+}
 
-  if (rbdata.cancelled)
-    goto cleanup;
 
-  /* Grab the screenshot on the main window */
-  root = gdk_get_default_root_window ();
 
-  screenshot = capture_rectangle_screenshot (rbdata.rectangle_root.x,
-                                             rbdata.rectangle_root.y,
-                                             rbdata.rectangle.width,
-                                             rbdata.rectangle.height,
-                                             delay);
+static gboolean
+cb_selection_cancelled_composited (GCancellable *cancellable, RubberBandData *rbdata)
+{
+  TRACE ("The capture was cancelled during the selection");
 
-  cleanup:
-  /* Ungrab the mouse and the keyboard */
-  gdk_device_ungrab (pointer, GDK_CURRENT_TIME);
-  gdk_device_ungrab (keyboard, GDK_CURRENT_TIME);
-  gdk_flush ();
+  rbdata->cancelled = TRUE;
+  end_selection_composited (rbdata, NULL);
 
-  return screenshot;
+  return FALSE;
 }
 
 
@@ -975,13 +1155,13 @@ region_filter_func (GdkXEvent *xevent, GdkEvent *event, RbData *rbdata)
 
                 XDrawRectangle (display,
                                 root_window,
-                                *rbdata->context,
+                                rbdata->context,
                                 rbdata->rectangle.x,
                                 rbdata->rectangle.y,
                                 (unsigned int) rbdata->rectangle.width-1,
                                 (unsigned int) rbdata->rectangle.height-1);
 
-                gtk_main_quit ();
+                end_selection (rbdata);
               }
             else
               {
@@ -1007,7 +1187,7 @@ region_filter_func (GdkXEvent *xevent, GdkEvent *event, RbData *rbdata)
 
                 XDrawRectangle (display,
                                 root_window,
-                                *rbdata->context,
+                                rbdata->context,
                                 rbdata->rectangle.x,
                                 rbdata->rectangle.y,
                                 (unsigned int) rbdata->rectangle.width-1,
@@ -1053,7 +1233,7 @@ region_filter_func (GdkXEvent *xevent, GdkEvent *event, RbData *rbdata)
               {
                 XDrawRectangle (display,
                                 root_window,
-                                *rbdata->context,
+                                rbdata->context,
                                 rbdata->rectangle.x,
                                 rbdata->rectangle.y,
                                 (unsigned int) rbdata->rectangle.width-1,
@@ -1089,7 +1269,7 @@ region_filter_func (GdkXEvent *xevent, GdkEvent *event, RbData *rbdata)
 
                     XDrawRectangle (display,
                                    root_window,
-                                   *rbdata->context,
+                                   rbdata->context,
                                    rbdata->rectangle.x,
                                    rbdata->rectangle.y,
                                    (unsigned int) rbdata->rectangle.width-1,
@@ -1098,7 +1278,7 @@ region_filter_func (GdkXEvent *xevent, GdkEvent *event, RbData *rbdata)
               }
 
             rbdata->cancelled = TRUE;
-            gtk_main_quit ();
+            end_selection (rbdata);
             return GDK_FILTER_REMOVE;
           }
         break;
@@ -1127,71 +1307,61 @@ region_filter_func (GdkXEvent *xevent, GdkEvent *event, RbData *rbdata)
 
 
 
-static GdkPixbuf
-*get_rectangle_screenshot (gint delay)
+/* Grabs the devices and draws the selection on the root window with a
+ * XOR rectangle; the selection goes on from region_filter_func (),
+ * which ends it with end_selection () */
+static void
+start_selection (GTask *task)
 {
-  GdkPixbuf *screenshot = NULL;
-  GdkWindow *root_window;
-
-  XGCValues gc_values;
-  GC gc;
-
-  Display *display;
-  gint screen;
-  RbData rbdata;
-  GdkCursor *xhair_cursor;
-  GdkDevice *pointer, *keyboard;
-  GdkGrabStatus res;
-  GdkSeat   *seat;
-  long value_mask;
+  RbData *rbdata;
 
-  /* Get root window */
-  TRACE ("Get the root window");
-  root_window = gdk_get_default_root_window ();
-  display = gdk_x11_get_default_xdisplay ();
-  screen = gdk_x11_get_default_screen ();
+  /* Initialize the rubber band data */
+  TRACE ("Initialize the rubber band data");
+  rbdata = g_new0 (RbData, 1);
+  rbdata->task = task;
 
   /* Change cursor to cross-hair */
   TRACE ("Set the cursor");
-  xhair_cursor = gdk_cursor_new_for_display (gdk_display_get_default (),
-                                             GDK_CROSSHAIR);
+  rbdata->cursor = gdk_cursor_new_for_display (gdk_display_get_default (),
+                                               GDK_CROSSHAIR);
 
   /* Wait 100ms before grabbing devices, useful when invoked by global hotkey
-   * because xfsettings will grab the key for a moment */ 
-  g_usleep(100000);
+   * because xfsettings will grab the key for a moment */
+  rbdata->grab_id = g_timeout_add (100, (GSourceFunc) cb_grab_devices, rbdata);
 
-  /* Grab the mouse and the keyboard to prevent any interaction with other
-   * applications */
-  seat = gdk_display_get_default_seat (gdk_display_get_default ());
-  pointer = gdk_seat_get_pointer (seat);
-  keyboard = gdk_seat_get_keyboard (seat);
+  rbdata->cancel_source =
+    watch_cancellable (task, (GSourceFunc) cb_selection_cancelled, rbdata);
+}
 
-  res = gdk_device_grab (keyboard, root_window,
-                         GDK_OWNERSHIP_NONE, FALSE,
-                         GDK_KEY_PRESS_MASK |
-                         GDK_KEY_RELEASE_MASK,
-                         NULL, GDK_CURRENT_TIME);
 
-  if (res != GDK_GRAB_SUCCESS)
-    {
-      g_object_unref (xhair_cursor);
-      g_warning ("Failed to grab keyboard");
-      return NULL;
-    }
 
-  res = gdk_device_grab (pointer, root_window,
-                         GDK_OWNERSHIP_NONE, FALSE,
-                         GDK_POINTER_MOTION_MASK |
-                         GDK_BUTTON_PRESS_MASK | 
-                         GDK_BUTTON_RELEASE_MASK,
-                         xhair_cursor, GDK_CURRENT_TIME);
+static gboolean
+cb_grab_devices (RbData *rbdata)
+{
+  XGCValues gc_values;
+  Display *display;
+  gint screen;
+  long value_mask;
+  GError *error = NULL;
 
-  if (res != GDK_GRAB_SUCCESS)
+  rbdata->grab_id = 0;
+
+  display = gdk_x11_get_default_xdisplay ();
+  screen = gdk_x11_get_default_screen ();
+
+  if (!grab_devices (gdk_get_default_root_window (), rbdata->cursor, &error))
     {
-      gdk_device_ungrab (keyboard, GDK_CURRENT_TIME);
-      g_object_unref (xhair_cursor);
-      g_warning ("Failed to grab pointer");
-      return NULL;
+      if (rbdata->cancel_source != NULL)
+        {
+          g_source_destroy (rbdata->cancel_source);
+          g_source_unref (rbdata->cancel_source);
+        }
+
+      g_object_unref (rbdata->cursor);
+      complete_selection (rbdata->task, error);
+      g_free (rbdata);
+
+      return FALSE;
     }
 
   /*Set up graphics context for a XOR rectangle that will be drawn as
@@ -1211,137 +1381,493 @@ static GdkPixbuf
                GCFillStyle | GCGraphicsExposures | GCSubwindowMode |
                GCBackground | GCForeground;
 
-  gc = XCreateGC (display,
-                  gdk_x11_get_default_root_xwindow (),
-                  value_mask,
-                  &gc_values);
-
-  /* Initialize the rubber band data */
-  TRACE ("Initialize the rubber band data");
-  rbdata.context = &gc;
-  rbdata.pressed = FALSE;
-  rbdata.cancelled = FALSE;
+  rbdata->context = XCreateGC (display,
+                               gdk_x11_get_default_root_xwindow (),
+                               value_mask,
+                               &gc_values);
 
   /* Set the filter function to handle the GDK events */
   TRACE ("Add the events filter");
-  gdk_window_add_filter (root_window,
-                         (GdkFilterFunc) region_filter_func, &rbdata);
+  gdk_window_add_filter (gdk_get_default_root_window (),
+                         (GdkFilterFunc) region_filter_func, rbdata);
 
   gdk_flush ();
 
-  gtk_main ();
+  return FALSE;
+}
+
 
-  gdk_window_remove_filter (root_window,
-                            (GdkFilterFunc) region_filter_func,
-                            &rbdata);
 
-  gdk_device_ungrab (pointer, GDK_CURRENT_TIME);
-  gdk_device_ungrab (keyboard, GDK_CURRENT_TIME);
+/* Removes the filter, releases the devices and completes the capture */
+static void
+end_selection (RbData *rbdata)
+{
+  CaptureData *data = g_task_get_task_data (rbdata->task);
+  GError *error = NULL;
 
-  /* Get the screenshot's pixbuf */
-  if (G_LIKELY (!rbdata.cancelled))
-    {
-      TRACE ("Get the pixbuf for the screenshot");
+  if (rbdata->grab_id != 0)
+    g_source_remove (rbdata->grab_id);
 
-      screenshot = capture_rectangle_screenshot (rbdata.rectangle.x,
-                                                 rbdata.rectangle.y,
-                                                 rbdata.rectangle.width,
-                                                 rbdata.rectangle.height,
-                                                 delay);
+  if (rbdata->cancel_source != NULL)
+    {
+      g_source_destroy (rbdata->cancel_source);
+      g_source_unref (rbdata->cancel_source);
     }
 
-  if (G_LIKELY (gc != NULL))
-    XFreeGC (display, gc);
+  /* Called from the filter, GDK keeps it alive until it returns */
+  gdk_window_remove_filter (gdk_get_default_root_window (),
+                            (GdkFilterFunc) region_filter_func,
+                            rbdata);
 
-  g_object_unref (xhair_cursor);
+  ungrab_devices ();
 
-  return screenshot;
+  if (G_LIKELY (rbdata->context != NULL))
+    XFreeGC (gdk_x11_get_default_xdisplay (), rbdata->context);
+
+  g_object_unref (rbdata->cursor);
+
+  if (G_UNLIKELY (rbdata->cancelled))
+    error = g_error_new (G_IO_ERROR, G_IO_ERROR_CANCELLED, _("The selection was cancelled."));
+  else
+    data->area = rbdata->rectangle;
+
+  complete_selection (rbdata->task, error);
+  g_free (rbdata);
 }
 
 
 
-/* Public */
+static gboolean
+cb_selection_cancelled (GCancellable *cancellable, RbData *rbdata)
+{
+  TRACE ("The capture was cancelled during the selection");
 
+  /* Remove the rectangle drawn previously */
+  if (rbdata->pressed && rbdata->rectangle.width > 0 && rbdata->rectangle.height > 0)
+    XDrawRectangle (gdk_x11_get_default_xdisplay (),
+                    gdk_x11_get_default_root_xwindow (),
+                    rbdata->context,
+                    rbdata->rectangle.x,
+                    rbdata->rectangle.y,
+                    (unsigned int) rbdata->rectangle.width-1,
+                    (unsigned int) rbdata->rectangle.height-1);
 
+  rbdata->cancelled = TRUE;
+  end_selection (rbdata);
 
-/**
- * screenshooter_take_screenshot:
- * @region: the region to be screenshoted. It can be FULLSCREEN,
- *          ACTIVE_WINDOW or SELECT.
- * @delay: the delay before the screenshot is taken, in seconds.
- * @mouse: whether the mouse pointer should be displayed on the screenshot.
- *
- * Takes a screenshot with the given options. If @region is FULLSCREEN,
- * the screenshot is taken after @delay seconds. If @region is
- * ACTIVE_WINDOW, a delay of @delay seconds elapses, then the active
- * window is detected and captured. If @region is SELECT, the user will
- * have to select a portion of the screen with the mouse. Then a delay of
- * @delay seconds elapses, and a screenshot is taken.
- *
- * @show_mouse is only taken into account when @region is FULLSCREEN
- * or ACTIVE_WINDOW.
- *
- * Return value: a #GdkPixbuf containing the screenshot or %NULL
- * (if @region is SELECT, the user can cancel the operation).
- **/
-GdkPixbuf *screenshooter_take_screenshot (gint     region,
-                                          gint     delay,
-                                          gboolean show_mouse,
-                                          gboolean plugin)
+  return FALSE;
+}
+
+
+
+/* Takes the screenshot of the whole screen or of the active window */
+static GdkPixbuf
+*capture_window (const ScreenshooterCaptureRequest *request, GdkRectangle *area)
 {
-  GdkPixbuf *screenshot = NULL;
-  GdkWindow *window = NULL;
-  GdkScreen *screen;
-  GdkDisplay *display;
-  gboolean border;
+  GdkPixbuf *screenshot;
+  GdkWindow *window;
+  gboolean border = FALSE;
 
   /* gdk_get_default_root_window () does not need to be unrefed,
    * needs_unref enables us to unref *window only if a non default
    * window has been grabbed. */
   gboolean needs_unref = TRUE;
 
-  /* Get the screen on which the screenshot should be taken */
-  screen = gdk_screen_get_default ();
-
   /* Sync the display */
-  display = gdk_display_get_default ();
-  gdk_display_sync (display);
+  gdk_display_sync (gdk_display_get_default ());
 
   gdk_window_process_all_updates ();
 
   /* Get the window/desktop we want to screenshot*/
-  if (region == FULLSCREEN)
+  if (request->region == FULLSCREEN)
     {
       TRACE ("We grab the entire screen");
 
       window = gdk_get_default_root_window ();
       needs_unref = FALSE;
-      border = FALSE;
     }
-  else if (region == ACTIVE_WINDOW)
+  else
     {
       TRACE ("We grab the active window");
 
-      window = get_active_window (screen, &needs_unref, &border);
+      window = get_active_window (gdk_screen_get_default (), &needs_unref, &border);
     }
 
-  if (region == FULLSCREEN || region == ACTIVE_WINDOW)
+  TRACE ("Get the screenshot of the given window");
+
+  screenshot = get_window_screenshot (window, request->show_mouse, border, area);
+
+  if (needs_unref)
+    g_object_unref (window);
+
+  return screenshot;
+}
+
+
+
+static void
+capture_data_free (CaptureData *data)
+{
+  screenshooter_capture_request_unref (data->request);
+  g_free (data);
+}
+
+
+
+/* Takes the screenshot once the delay elapsed, and completes @task */
+static gboolean
+cb_capture_due (GTask *task)
+{
+  CaptureData *data = g_task_get_task_data (task);
+  ScreenshooterCapture *capture;
+  GdkPixbuf *screenshot;
+
+  if (g_task_return_error_if_cancelled (task))
     {
-      TRACE ("Get the screenshot of the given window");
+      g_object_unref (task);
+      return FALSE;
+    }
 
-      screenshot = get_window_screenshot (window, show_mouse, border);
+  if (data->request->region == SELECT)
+    screenshot = capture_rectangle_screenshot (&data->area);
+  else
+    screenshot = capture_window (data->request, &data->area);
 
-      if (needs_unref)
-        g_object_unref (window);
+  if (G_UNLIKELY (screenshot == NULL))
+    {
+      g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_FAILED,
+                               _("Could not take the screenshot."));
+      g_object_unref (task);
+      return FALSE;
     }
-  else if (region == SELECT)
+
+  capture = g_new0 (ScreenshooterCapture, 1);
+  capture->screenshot = screenshot;
+  capture->region = data->request->region;
+  capture->area = data->area;
+  capture->capture_time = g_get_real_time ();
+
+  g_task_return_pointer (task, capture, (GDestroyNotify) screenshooter_capture_free);
+  g_object_unref (task);
+
+  return FALSE;
+}
+
+
+
+/* Lets the user select the region; the selection then completes the
+ * task or waits for the delay */
+static gboolean
+cb_select_region (GTask *task)
+{
+  if (g_task_return_error_if_cancelled (task))
     {
-      TRACE ("Let the user select the region to screenshot");
-      if (!gdk_screen_is_composited (screen))
-        screenshot = get_rectangle_screenshot (delay);
-      else
-        screenshot = get_rectangle_screenshot_composited (delay);
+      g_object_unref (task);
+      return FALSE;
     }
 
-  return screenshot;
+  /* The grabs would succeed, and the first selection to end would
+   * release those of the other */
+  if (selection_active)
+    {
+      g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_BUSY,
+                               _("Another region is being selected."));
+      g_object_unref (task);
+      return FALSE;
+    }
+
+  selection_active = TRUE;
+
+  TRACE ("Let the user select the region to screenshot");
+
+  if (!gdk_screen_is_composited (gdk_screen_get_default ()))
+    start_selection (task);
+  else
+    start_selection_composited (task);
+
+  return FALSE;
+}
+
+
+
+/* Ends the synchronous capture */
+static void
+cb_capture_finished (GObject *source, GAsyncResult *result, SyncCapture *sync)
+{
+  ScreenshooterCapture *capture;
+  GError *error = NULL;
+
+  capture = screenshooter_capture_finish (result, &error);
+
+  if (capture != NULL)
+    {
+      sync->screenshot = g_object_ref (capture->screenshot);
+      screenshooter_capture_free (capture);
+    }
+  else
+    {
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        g_warning ("%s", error->message);
+
+      g_error_free (error);
+    }
+
+  g_main_loop_quit (sync->loop);
+}
+
+
+
+/* Public */
+
+
+
+/**
+ * screenshooter_capture_request_new:
+ * @region: the region to be screenshoted. It can be FULLSCREEN,
+ *          ACTIVE_WINDOW or SELECT.
+ * @delay: the delay before the screenshot is taken, in seconds.
+ * @show_mouse: whether the mouse pointer should be displayed on the
+ *              screenshot, when @region is FULLSCREEN or ACTIVE_WINDOW.
+ *
+ * Creates the description of a capture for screenshooter_capture_async().
+ * It cannot be changed afterwards, so it can be shared by any number of
+ * captures in flight.
+ *
+ * Return value: a new #ScreenshooterCaptureRequest, release it with
+ * screenshooter_capture_request_unref().
+ **/
+ScreenshooterCaptureRequest *
+screenshooter_capture_request_new (gint region, gint delay, gboolean show_mouse)
+{
+  ScreenshooterCaptureRequest *request;
+
+  g_return_val_if_fail (region == FULLSCREEN || region == ACTIVE_WINDOW ||
+                        region == SELECT, NULL);
+
+  request = g_new (ScreenshooterCaptureRequest, 1);
+  request->ref_count = 1;
+  request->region = region;
+  request->delay = MAX (delay, 0);
+  request->show_mouse = show_mouse;
+
+  return request;
+}
+
+
+
+ScreenshooterCaptureRequest *
+screenshooter_capture_request_ref (ScreenshooterCaptureRequest *request)
+{
+  g_return_val_if_fail (request != NULL, NULL);
+
+  g_atomic_int_inc (&request->ref_count);
+
+  return request;
+}
+
+
+
+void
+screenshooter_capture_request_unref (ScreenshooterCaptureRequest *request)
+{
+  g_return_if_fail (request != NULL);
+
+  if (g_atomic_int_dec_and_test (&request->ref_count))
+    g_free (request);
+}
+
+
+
+/**
+ * screenshooter_capture_free:
+ * @capture: a #ScreenshooterCapture.
+ *
+ * Releases @capture and its reference to the screenshot.
+ **/
+void
+screenshooter_capture_free (ScreenshooterCapture *capture)
+{
+  if (capture == NULL)
+    return;
+
+  g_object_unref (capture->screenshot);
+  g_free (capture);
+}
+
+
+
+/**
+ * screenshooter_capture_async:
+ * @request: what to capture.
+ * @cancellable: a #GCancellable or %NULL.
+ * @callback: the function called with the result.
+ * @user_data: the data passed to @callback.
+ *
+ * Starts taking a screenshot as described by @request, from the main
+ * loop. If the region is FULLSCREEN or ACTIVE_WINDOW, the screenshot is
+ * taken after the delay; if it is SELECT, the user selects a portion of
+ * the screen with the mouse first, then the delay elapses, but not less
+ * than 200 ms.
+ *
+ * All the state of the capture belongs to it, so several captures can be
+ * in flight at once. Only one region can be selected at a time though:
+ * the others fail with %G_IO_ERROR_BUSY, whether the pointer is grabbed
+ * by this process or by another one. Cancelling @cancellable during the
+ * selection ends it.
+ *
+ * Get the result in @callback with screenshooter_capture_finish().
+ **/
+void
+screenshooter_capture_async (ScreenshooterCaptureRequest *request,
+                             GCancellable                *cancellable,
+                             GAsyncReadyCallback          callback,
+                             gpointer                     user_data)
+{
+  CaptureData *data;
+  GTask *task;
+
+  g_return_if_fail (request != NULL);
+
+  data = g_new0 (CaptureData, 1);
+  data->request = screenshooter_capture_request_ref (request);
+
+  task = g_task_new (NULL, cancellable, callback, user_data);
+  g_task_set_source_tag (task, screenshooter_capture_async);
+  g_task_set_task_data (task, data, (GDestroyNotify) capture_data_free);
+
+  /* The task holds itself until one of the sources completes it */
+  if (request->region == SELECT)
+    g_idle_add ((GSourceFunc) cb_select_region, task);
+  else if (request->delay == 0)
+    g_idle_add ((GSourceFunc) cb_capture_due, task);
+  else
+    g_timeout_add_seconds (request->delay, (GSourceFunc) cb_capture_due, task);
+}
+
+
+
+/**
+ * screenshooter_capture_finish:
+ * @result: the #GAsyncResult passed to the callback of
+ *          screenshooter_capture_async().
+ * @error: return location for a #GError.
+ *
+ * Return value: the screenshot and where it was taken, release it with
+ * screenshooter_capture_free(); %NULL if the capture failed or the user
+ * cancelled the selection, with %G_IO_ERROR_CANCELLED.
+ **/
+ScreenshooterCapture *
+screenshooter_capture_finish (GAsyncResult *result, GError **error)
+{
+  g_return_val_if_fail (g_task_is_valid (result, NULL), NULL);
+  g_return_val_if_fail (g_task_get_source_tag (G_TASK (result)) == screenshooter_capture_async, NULL);
+
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
+
+
+
+/**
+ * screenshooter_capture_get_area:
+ * @region: FULLSCREEN or ACTIVE_WINDOW.
+ * @area: return location for the area.
+ *
+ * Sets @area to the part of the screen a screenshot of @region would be
+ * taken from, without taking it, so that the caller can grab it into
+ * buffers of its own.
+ *
+ * Return value: %FALSE if no part of @region is on the screen.
+ **/
+gboolean
+screenshooter_capture_get_area (gint region, GdkRectangle *area)
+{
+  GdkRectangle rectangle;
+  GdkWindow *window;
+  gboolean border = FALSE;
+  gboolean needs_unref = FALSE;
+
+  g_return_val_if_fail (region == FULLSCREEN || region == ACTIVE_WINDOW, FALSE);
+  g_return_val_if_fail (area != NULL, FALSE);
+
+  if (region == FULLSCREEN)
+    window = gdk_get_default_root_window ();
+  else
+    {
+      needs_unref = TRUE;
+      window = get_active_window (gdk_screen_get_default (), &needs_unref, &border);
+    }
+
+  /* The decorations are grabbed with the window */
+  if (border)
+    {
+      GdkWindow *frame =
+        gdk_x11_window_foreign_new_for_display (gdk_window_get_display (window),
+                                                find_wm_window (GDK_WINDOW_XID (window)));
+
+      if (needs_unref)
+        g_object_unref (window);
+
+      window = frame;
+      needs_unref = TRUE;
+    }
+
+  rectangle.width = gdk_window_get_width (window);
+  rectangle.height = gdk_window_get_height (window);
+  gdk_window_get_origin (window, &rectangle.x, &rectangle.y);
+
+  if (needs_unref)
+    g_object_unref (window);
+
+  clip_to_screen (&rectangle, area);
+
+  return area->width > 0 && area->height > 0;
+}
+
+
+
+/**
+ * screenshooter_take_screenshot:
+ * @region: the region to be screenshoted. It can be FULLSCREEN,
+ *          ACTIVE_WINDOW or SELECT.
+ * @delay: the delay before the screenshot is taken, in seconds.
+ * @mouse: whether the mouse pointer should be displayed on the screenshot.
+ *
+ * Takes a screenshot with the given options. If @region is FULLSCREEN or
+ * ACTIVE_WINDOW, the screenshot is taken right away, the caller awaits
+ * the delay beforehand. If @region is SELECT, the user will have to
+ * select a portion of the screen with the mouse. Then a delay of @delay
+ * seconds elapses, and a screenshot is taken.
+ *
+ * This runs screenshooter_capture_async() in a main loop of its own.
+ *
+ * @show_mouse is only taken into account when @region is FULLSCREEN
+ * or ACTIVE_WINDOW.
+ *
+ * Return value: a #GdkPixbuf containing the screenshot or %NULL
+ * (if @region is SELECT, the user can cancel the operation).
+ **/
+GdkPixbuf *screenshooter_take_screenshot (gint     region,
+                                          gint     delay,
+                                          gboolean show_mouse,
+                                          gboolean plugin)
+{
+  ScreenshooterCaptureRequest *request;
+  SyncCapture sync;
+
+  request = screenshooter_capture_request_new (region, region == SELECT ? delay : 0, show_mouse);
+
+  if (G_UNLIKELY (request == NULL))
+    return NULL;
+
+  sync.loop = g_main_loop_new (NULL, FALSE);
+  sync.screenshot = NULL;
+
+  screenshooter_capture_async (request, NULL,
+                               (GAsyncReadyCallback) cb_capture_finished, &sync);
+  g_main_loop_run (sync.loop);
+
+  g_main_loop_unref (sync.loop);
+  screenshooter_capture_request_unref (request);
+
+  return sync.screenshot;
 }
@@ -25,6 +25,7 @@
 #endif
 
 #include "screenshooter-global.h"
+#include "screenshooter-redact.h"
 
 #ifdef HAVE_XFIXES
 #include <X11/extensions/Xfixes.h>
@@ -33,6 +34,7 @@
 #include <X11/extensions/XInput2.h>
 #include <gdk/gdkkeysyms.h>
 #include <gdk/gdkx.h>
+#include <gio/gio.h>
 #include <glib.h>
 #include <unistd.h>
 
@@ -40,10 +42,47 @@
 
 
 
+/* Immutable description of a capture */
+typedef struct _ScreenshooterCaptureRequest ScreenshooterCaptureRequest;
+
+/* A screenshot and where it was taken */
+typedef struct
+{
+  GdkPixbuf    *screenshot;
+  gint          region;
+  GdkRectangle  area;
+  gint64        capture_time;
+} ScreenshooterCapture;
+
+
+
+ScreenshooterCaptureRequest
+*screenshooter_capture_request_new   (gint                         region,
+                                      gint                         delay,
+                                      gboolean                     show_mouse);
+ScreenshooterCaptureRequest
+*screenshooter_capture_request_ref   (ScreenshooterCaptureRequest *request);
+void
+screenshooter_capture_request_unref  (ScreenshooterCaptureRequest *request);
+
+void
+screenshooter_capture_async          (ScreenshooterCaptureRequest *request,
+                                      GCancellable                *cancellable,
+                                      GAsyncReadyCallback          callback,
+                                      gpointer                     user_data);
+ScreenshooterCapture
+*screenshooter_capture_finish        (GAsyncResult                *result,
+                                      GError                     **error);
+void
+screenshooter_capture_free           (ScreenshooterCapture        *capture);
+gboolean
+screenshooter_capture_get_area       (gint                         region,
+                                      GdkRectangle                *area);
+
 GdkPixbuf
-*screenshooter_take_screenshot   (gint     region,
-                                  gint     delay,
-                                  gboolean show_mouse,
-                                  gboolean plugin);
+*screenshooter_take_screenshot       (gint                         region,
+                                      gint                         delay,
+                                      gboolean                     show_mouse,
+                                      gboolean                     plugin);
 
 #endif
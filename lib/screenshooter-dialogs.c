@@ -38,6 +38,9 @@ static void
 cb_show_mouse_toggled              (GtkToggleButton    *tb,
                                     ScreenshotData     *sd);
 static void
+cb_trim_toggled                    (GtkToggleButton    *tb,
+                                    ScreenshotData     *sd);
+static void
 cb_save_toggled                    (GtkToggleButton    *tb,
                                     ScreenshotData     *sd);
 static void
@@ -60,6 +63,9 @@ static void
 cb_ipfs_toggled                   (GtkToggleButton    *tb,
                                     ScreenshotData     *sd);
 static void
+cb_s3_toggled                      (GtkToggleButton    *tb,
+                                    ScreenshotData     *sd);
+static void
 cb_delay_spinner_changed           (GtkWidget          *spinner,
                                     ScreenshotData     *sd);
 static gchar
@@ -145,11 +151,29 @@ static void cb_show_mouse_toggled (GtkToggleButton *tb, ScreenshotData   *sd)
 
 
 
-/* Set the action when the button is toggled */
-static void cb_save_toggled (GtkToggleButton *tb, ScreenshotData  *sd)
+/* Set whether the uniform borders should be trimmed when the button is toggled */
+static void cb_trim_toggled (GtkToggleButton *tb, ScreenshotData *sd)
+{
+  sd->trim = gtk_toggle_button_get_active (tb);
+}
+
+
+
+/* Add @action to the set of actions, or remove it, as @tb is toggled */
+static void
+toggle_action (GtkToggleButton *tb, ScreenshotData *sd, gint action)
 {
   if (gtk_toggle_button_get_active (tb))
-    sd->action = SAVE;
+    sd->action |= action;
+  else
+    sd->action &= ~action;
+}
+
+
+
+static void cb_save_toggled (GtkToggleButton *tb, ScreenshotData  *sd)
+{
+  toggle_action (tb, sd, SAVE);
 }
 
 
@@ -174,30 +198,31 @@ cb_toggle_set_insensi (GtkToggleButton *tb, GtkWidget *widget)
 
 static void cb_open_toggled (GtkToggleButton *tb, ScreenshotData *sd)
 {
-  if (gtk_toggle_button_get_active (tb))
-    sd->action = OPEN;
+  toggle_action (tb, sd, OPEN);
 }
 
 
 
 static void cb_clipboard_toggled (GtkToggleButton *tb, ScreenshotData *sd)
 {
-  if (gtk_toggle_button_get_active (tb))
-    sd->action = CLIPBOARD;
+  toggle_action (tb, sd, CLIPBOARD);
 }
 
 
 
 static void cb_imgur_toggled (GtkToggleButton *tb, ScreenshotData *sd)
 {
-  if (gtk_toggle_button_get_active (tb))
-    sd->action = UPLOAD_IMGUR;
+  toggle_action (tb, sd, UPLOAD_IMGUR);
 }
 
 static void cb_ipfs_toggled (GtkToggleButton *tb, ScreenshotData *sd)
 {
-  if (gtk_toggle_button_get_active (tb))
-    sd->action = UPLOAD_IPFS;
+  toggle_action (tb, sd, UPLOAD_IPFS);
+}
+
+static void cb_s3_toggled (GtkToggleButton *tb, ScreenshotData *sd)
+{
+  toggle_action (tb, sd, UPLOAD_S3);
 }
 
 
@@ -687,6 +712,7 @@ GtkWidget *screenshooter_region_dialog_new (ScreenshotData *sd, gboolean plugin)
             *rectangle_button;
 
   GtkWidget *show_mouse_checkbox;
+  GtkWidget *trim_checkbox;
 
   GtkWidget *delay_main_box, *delay_box, *delay_label, *delay_alignment;
   GtkWidget *delay_spinner_box, *delay_spinner, *seconds_label;
@@ -844,6 +870,22 @@ GtkWidget *screenshooter_region_dialog_new (ScreenshotData *sd, gboolean plugin)
   g_signal_connect (G_OBJECT (rectangle_button), "toggled",
                     G_CALLBACK (cb_toggle_set_insensi), show_mouse_checkbox);
 
+  /* Create trim borders checkbox */
+  trim_checkbox =
+    gtk_check_button_new_with_label (_("Trim uniform borders"));
+  gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (trim_checkbox), sd->trim);
+  gtk_widget_set_sensitive (trim_checkbox, (sd->region != FULLSCREEN));
+  gtk_widget_set_tooltip_text (trim_checkbox,
+                               _("Crop the margins of a single color around the "
+                                 "captured window or region"));
+  gtk_box_pack_start (GTK_BOX (area_box),
+                      trim_checkbox, FALSE,
+                      FALSE, 0);
+  g_signal_connect (G_OBJECT (trim_checkbox), "toggled",
+                    G_CALLBACK (cb_trim_toggled), sd);
+  g_signal_connect (G_OBJECT (fullscreen_button), "toggled",
+                    G_CALLBACK (cb_toggle_set_insensi), trim_checkbox);
+
   /* Create the main box for the delay stuff */
   delay_main_box = gtk_box_new (GTK_ORIENTATION_VERTICAL, 6);
   gtk_grid_attach (GTK_GRID (layout_grid), delay_main_box, 1, 0, 1, 1);
@@ -911,7 +953,8 @@ GtkWidget *screenshooter_region_dialog_new (ScreenshotData *sd, gboolean plugin)
 
 
 
-GtkWidget *screenshooter_actions_dialog_new (ScreenshotData *sd)
+GtkWidget *screenshooter_actions_dialog_new (ScreenshotData *sd,
+                                             GdkPixbuf      *screenshot)
 {
   GtkWidget *dlg, *main_alignment;
   GtkWidget *vbox;
@@ -920,10 +963,11 @@ GtkWidget *screenshooter_actions_dialog_new (ScreenshotData *sd)
 
   GtkWidget *left_box;
   GtkWidget *actions_label, *actions_alignment, *actions_grid;
-  GtkWidget *save_radio_button;
-  GtkWidget *clipboard_radio_button, *open_with_radio_button;
-  GtkWidget *imgur_radio_button;
-  GtkWidget *ipfs_radio_button;
+  GtkWidget *save_check_button;
+  GtkWidget *clipboard_check_button, *open_with_check_button;
+  GtkWidget *imgur_check_button;
+  GtkWidget *ipfs_check_button;
+  GtkWidget *s3_check_button;
 
   GtkListStore *liststore;
   GtkWidget *combobox;
@@ -1001,43 +1045,43 @@ GtkWidget *screenshooter_actions_dialog_new (ScreenshotData *sd)
   gtk_grid_set_column_spacing (GTK_GRID (actions_grid), 6);
   gtk_container_set_border_width (GTK_CONTAINER (actions_grid), 0);
 
-  /* Save option radio button */
-  save_radio_button = gtk_radio_button_new_with_mnemonic (NULL, _("Save"));
-  gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (save_radio_button),
+  /* Check buttons, since all the actions selected are run */
+
+  /* Save option check button */
+  save_check_button = gtk_check_button_new_with_mnemonic (_("Save"));
+  gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (save_check_button),
                                 (sd->action & SAVE));
-  g_signal_connect (G_OBJECT (save_radio_button), "toggled",
+  g_signal_connect (G_OBJECT (save_check_button), "toggled",
                     G_CALLBACK (cb_save_toggled), sd);
-  gtk_widget_set_tooltip_text (save_radio_button, _("Save the screenshot to a PNG file"));
-  gtk_grid_attach (GTK_GRID (actions_grid), save_radio_button, 0, 0, 1, 1);
+  gtk_widget_set_tooltip_text (save_check_button, _("Save the screenshot to a PNG file"));
+  gtk_grid_attach (GTK_GRID (actions_grid), save_check_button, 0, 0, 1, 1);
 
   if (sd->plugin ||
       gdk_display_supports_clipboard_persistence (gdk_display_get_default ()))
     {
-      /* Copy to clipboard radio button */
-      clipboard_radio_button =
-        gtk_radio_button_new_with_label_from_widget (GTK_RADIO_BUTTON (save_radio_button),
-                                                     _("Copy to the clipboard"));
-      gtk_widget_set_tooltip_text (clipboard_radio_button,
+      /* Copy to clipboard check button */
+      clipboard_check_button =
+        gtk_check_button_new_with_label (_("Copy to the clipboard"));
+      gtk_widget_set_tooltip_text (clipboard_check_button,
                                    _("Copy the screenshot to the clipboard so that it can be "
                                      "pasted later"));
-      gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (clipboard_radio_button),
+      gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (clipboard_check_button),
                                     (sd->action & CLIPBOARD));
-      g_signal_connect (G_OBJECT (clipboard_radio_button), "toggled",
+      g_signal_connect (G_OBJECT (clipboard_check_button), "toggled",
                         G_CALLBACK (cb_clipboard_toggled), sd);
-      gtk_grid_attach (GTK_GRID (actions_grid), clipboard_radio_button, 0, 1, 1, 1);
+      gtk_grid_attach (GTK_GRID (actions_grid), clipboard_check_button, 0, 1, 1, 1);
     }
 
-  /* Open with radio button */
-  open_with_radio_button =
-    gtk_radio_button_new_with_label_from_widget (GTK_RADIO_BUTTON (save_radio_button),
-                                                 _("Open with:"));
-  gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (open_with_radio_button),
+  /* Open with check button */
+  open_with_check_button =
+    gtk_check_button_new_with_label (_("Open with:"));
+  gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (open_with_check_button),
                                 (sd->action & OPEN));
-  g_signal_connect (G_OBJECT (open_with_radio_button), "toggled",
+  g_signal_connect (G_OBJECT (open_with_check_button), "toggled",
                     G_CALLBACK (cb_open_toggled), sd);
-  gtk_widget_set_tooltip_text (open_with_radio_button,
+  gtk_widget_set_tooltip_text (open_with_check_button,
                                _("Open the screenshot with the chosen application"));
-  gtk_grid_attach (GTK_GRID (actions_grid), open_with_radio_button, 0, 2, 1, 1);
+  gtk_grid_attach (GTK_GRID (actions_grid), open_with_check_button, 0, 2, 1, 1);
 
   /* Open with combobox */
   liststore = gtk_list_store_new (4, GDK_TYPE_PIXBUF, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_APP_INFO);
@@ -1056,37 +1100,47 @@ GtkWidget *screenshooter_actions_dialog_new (ScreenshotData *sd)
   g_signal_connect (G_OBJECT (combobox), "changed",
                     G_CALLBACK (cb_combo_active_item_changed), sd);
   gtk_widget_set_tooltip_text (combobox, _("Application to open the screenshot"));
-  g_signal_connect (G_OBJECT (open_with_radio_button), "toggled",
+  g_signal_connect (G_OBJECT (open_with_check_button), "toggled",
                     G_CALLBACK (cb_toggle_set_sensi), combobox);
 
   /* Run the callback functions to grey/ungrey the correct widgets */
-  cb_toggle_set_sensi (GTK_TOGGLE_BUTTON (open_with_radio_button), combobox);
+  cb_toggle_set_sensi (GTK_TOGGLE_BUTTON (open_with_check_button), combobox);
 
-  /* Upload to imgur radio button */
-  imgur_radio_button =
-    gtk_radio_button_new_with_label_from_widget (GTK_RADIO_BUTTON (save_radio_button),
-                                                 _("Host on Imgur"));
-  gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (imgur_radio_button),
+  /* Upload to imgur check button */
+  imgur_check_button =
+    gtk_check_button_new_with_label (_("Host on Imgur"));
+  gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (imgur_check_button),
                                 (sd->action & UPLOAD_IMGUR));
-  gtk_widget_set_tooltip_text (imgur_radio_button,
+  gtk_widget_set_tooltip_text (imgur_check_button,
                                _("Host the screenshot on Imgur, a free online "
                                  "image hosting service"));
-  g_signal_connect (G_OBJECT (imgur_radio_button), "toggled",
+  g_signal_connect (G_OBJECT (imgur_check_button), "toggled",
                     G_CALLBACK (cb_imgur_toggled), sd);
-  gtk_grid_attach (GTK_GRID (actions_grid), imgur_radio_button, 0, 4, 1, 1);
+  gtk_grid_attach (GTK_GRID (actions_grid), imgur_check_button, 0, 4, 1, 1);
 
-  /* Upload to ipfs radio button */
-  ipfs_radio_button =
-    gtk_radio_button_new_with_label_from_widget (GTK_RADIO_BUTTON (save_radio_button),
-                                                 _("Host on IPFS"));
-  gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (ipfs_radio_button),
+  /* Upload to ipfs check button */
+  ipfs_check_button =
+    gtk_check_button_new_with_label (_("Host on IPFS"));
+  gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (ipfs_check_button),
                                 (sd->action & UPLOAD_IPFS));
-  gtk_widget_set_tooltip_text (ipfs_radio_button,
+  gtk_widget_set_tooltip_text (ipfs_check_button,
                                _("Host the screenshot on IPFS, a free online "
                                  "image hosting service"));
-  g_signal_connect (G_OBJECT (ipfs_radio_button), "toggled",
+  g_signal_connect (G_OBJECT (ipfs_check_button), "toggled",
                     G_CALLBACK (cb_ipfs_toggled), sd);
-  gtk_grid_attach (GTK_GRID (actions_grid), ipfs_radio_button, 0, 5, 1, 1);
+  gtk_grid_attach (GTK_GRID (actions_grid), ipfs_check_button, 0, 5, 1, 1);
+
+  /* Upload to S3 check button */
+  s3_check_button =
+    gtk_check_button_new_with_label (_("Store on S3"));
+  gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (s3_check_button),
+                                (sd->action & UPLOAD_S3));
+  gtk_widget_set_tooltip_text (s3_check_button,
+                               _("Store the screenshot in the S3-compatible "
+                                 "object storage set in the preferences"));
+  g_signal_connect (G_OBJECT (s3_check_button), "toggled",
+                    G_CALLBACK (cb_s3_toggled), sd);
+  gtk_grid_attach (GTK_GRID (actions_grid), s3_check_button, 0, 6, 1, 1);
 
   /* Preview box */
   preview_box = gtk_box_new (GTK_ORIENTATION_VERTICAL, 6);
@@ -1103,7 +1157,7 @@ GtkWidget *screenshooter_actions_dialog_new (ScreenshotData *sd)
   gtk_box_pack_start (GTK_BOX (preview_box), preview_label, FALSE, FALSE, 0);
 
   /* The preview image */
-  thumbnail = screenshot_get_thumbnail (sd->screenshot);
+  thumbnail = screenshot_get_thumbnail (screenshot);
   preview_ebox = gtk_event_box_new ();
   preview = gtk_image_new_from_pixbuf (thumbnail);
   g_object_unref (thumbnail);
@@ -1114,9 +1168,106 @@ GtkWidget *screenshooter_actions_dialog_new (ScreenshotData *sd)
   gtk_drag_source_set (preview_ebox, GDK_BUTTON1_MASK, NULL, 0, GDK_ACTION_COPY);
   gtk_drag_source_add_image_targets (preview_ebox);
   g_signal_connect (preview_ebox, "drag-begin", G_CALLBACK (preview_drag_begin), thumbnail);
-  g_signal_connect (preview_ebox, "drag-data-get", G_CALLBACK (preview_drag_data_get), sd->screenshot);
+  g_signal_connect (preview_ebox, "drag-data-get", G_CALLBACK (preview_drag_data_get), screenshot);
   g_signal_connect (preview_ebox, "drag-end", G_CALLBACK (preview_drag_end), dlg);
 
+  /* The dialog is not run, keep the screenshot dragged from it */
+  g_object_set_data_full (G_OBJECT (dlg), "screenshot",
+                          g_object_ref (screenshot), g_object_unref);
+
+  gtk_widget_show_all (gtk_dialog_get_content_area (GTK_DIALOG (dlg)));
+
+  return dlg;
+}
+
+
+
+/**
+ * screenshooter_burst_dialog_new:
+ * @frames: the frames of the burst.
+ * @n_frames: the number of @frames.
+ *
+ * Creates a dialog showing the thumbnails of a burst of screenshots, to
+ * keep the one selected, with %GTK_RESPONSE_OK, or all of them, with
+ * %SCREENSHOOTER_RESPONSE_KEEP_ALL.
+ *
+ * Return value: the dialog, read the frame selected with
+ * screenshooter_burst_dialog_get_selected().
+ **/
+GtkWidget
+*screenshooter_burst_dialog_new (cairo_surface_t **frames, guint n_frames)
+{
+  GtkWidget *dlg, *scrolled, *icon_view;
+  GtkListStore *liststore;
+  GtkTreePath *path;
+  guint i;
+
+  dlg = xfce_titled_dialog_new_with_buttons (_("Screenshot"),
+                                             NULL,
+                                             GTK_DIALOG_DESTROY_WITH_PARENT,
+                                             "gtk-cancel",
+                                             GTK_RESPONSE_CANCEL,
+                                             _("Keep _All"),
+                                             SCREENSHOOTER_RESPONSE_KEEP_ALL,
+                                             _("_Keep"),
+                                             GTK_RESPONSE_OK,
+                                             NULL);
+
+  xfce_titled_dialog_set_subtitle (XFCE_TITLED_DIALOG (dlg), _("Burst"));
+  gtk_window_set_position (GTK_WINDOW (dlg), GTK_WIN_POS_CENTER);
+  gtk_window_set_default_size (GTK_WINDOW (dlg), 4 * THUMB_X_SIZE, 3 * THUMB_Y_SIZE);
+  gtk_window_set_icon_name (GTK_WINDOW (dlg), "applets-screenshooter");
+  gtk_dialog_set_default_response (GTK_DIALOG (dlg), GTK_RESPONSE_OK);
+
+  /* One thumbnail per frame, with its number */
+  liststore = gtk_list_store_new (2, GDK_TYPE_PIXBUF, G_TYPE_STRING);
+
+  for (i = 0; i < n_frames; i++)
+    {
+      GdkPixbuf *frame, *thumbnail;
+      gchar *label = g_strdup_printf ("%u", i + 1);
+
+      /* One frame at a time, so that they are never all converted */
+      frame = gdk_pixbuf_get_from_surface (frames[i], 0, 0,
+                                           cairo_image_surface_get_width (frames[i]),
+                                           cairo_image_surface_get_height (frames[i]));
+      thumbnail = screenshot_get_thumbnail (frame);
+
+      gtk_list_store_insert_with_values (liststore, NULL, -1, 0, thumbnail, 1, label, -1);
+
+      g_object_unref (thumbnail);
+      g_object_unref (frame);
+      g_free (label);
+    }
+
+  icon_view = gtk_icon_view_new_with_model (GTK_TREE_MODEL (liststore));
+  g_object_unref (liststore);
+
+  gtk_icon_view_set_pixbuf_column (GTK_ICON_VIEW (icon_view), 0);
+  gtk_icon_view_set_text_column (GTK_ICON_VIEW (icon_view), 1);
+  gtk_icon_view_set_selection_mode (GTK_ICON_VIEW (icon_view), GTK_SELECTION_BROWSE);
+  gtk_icon_view_set_activate_on_single_click (GTK_ICON_VIEW (icon_view), FALSE);
+  gtk_widget_set_tooltip_text (icon_view, _("Select the screenshot to keep"));
+
+  /* Keep the first frame unless another one is selected */
+  path = gtk_tree_path_new_first ();
+  gtk_icon_view_select_path (GTK_ICON_VIEW (icon_view), path);
+  gtk_tree_path_free (path);
+
+  /* Activating a frame keeps it */
+  g_signal_connect_swapped (icon_view, "item-activated",
+                            G_CALLBACK (gtk_window_activate_default), dlg);
+
+  scrolled = gtk_scrolled_window_new (NULL, NULL);
+  gtk_scrolled_window_set_policy (GTK_SCROLLED_WINDOW (scrolled),
+                                  GTK_POLICY_NEVER, GTK_POLICY_AUTOMATIC);
+  gtk_widget_set_vexpand (scrolled, TRUE);
+  gtk_container_add (GTK_CONTAINER (scrolled), icon_view);
+  gtk_box_pack_start (GTK_BOX (gtk_dialog_get_content_area (GTK_DIALOG (dlg))),
+                      scrolled, TRUE, TRUE, 0);
+
+  g_object_set_data (G_OBJECT (dlg), "icon-view", icon_view);
+
   gtk_widget_show_all (gtk_dialog_get_content_area (GTK_DIALOG (dlg)));
 
   return dlg;
@@ -1124,6 +1275,32 @@ GtkWidget *screenshooter_actions_dialog_new (ScreenshotData *sd)
 
 
 
+/**
+ * screenshooter_burst_dialog_get_selected:
+ * @dialog: a dialog created by screenshooter_burst_dialog_new().
+ *
+ * Return value: the index of the frame selected in @dialog, -1 if there
+ * is none.
+ **/
+gint
+screenshooter_burst_dialog_get_selected (GtkWidget *dialog)
+{
+  GtkIconView *icon_view = g_object_get_data (G_OBJECT (dialog), "icon-view");
+  GList *selected;
+  gint index = -1;
+
+  selected = gtk_icon_view_get_selected_items (icon_view);
+
+  if (selected != NULL)
+    index = gtk_tree_path_get_indices (selected->data)[0];
+
+  g_list_free_full (selected, (GDestroyNotify) gtk_tree_path_free);
+
+  return index;
+}
+
+
+
 /* Saves the @screenshot in the given @directory using
  * @title and @timestamp to generate the file name.
  *
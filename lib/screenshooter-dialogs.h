@@ -35,10 +35,17 @@
 #include <libxfce4util/libxfce4util.h>
 #include <libxfce4ui/libxfce4ui.h>
 
+/* Response of the burst dialog keeping all the frames */
+#define SCREENSHOOTER_RESPONSE_KEEP_ALL 1
 
-GtkWidget *screenshooter_actions_dialog_new (ScreenshotData *sd);
+GtkWidget *screenshooter_actions_dialog_new (ScreenshotData *sd,
+                                             GdkPixbuf      *screenshot);
 GtkWidget *screenshooter_region_dialog_new  (ScreenshotData *sd,
                                              gboolean        plugin);
+GtkWidget *screenshooter_burst_dialog_new   (cairo_surface_t **frames,
+                                             guint             n_frames);
+gint       screenshooter_burst_dialog_get_selected
+                                            (GtkWidget      *dialog);
 gchar     *screenshooter_save_screenshot    (GdkPixbuf      *screenshot,
                                              const gchar    *directory,
                                              const gchar    *title,
@@ -0,0 +1,333 @@
+/*  $Id$
+ *
+ *  Copyright © 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ * */
+
+#include "screenshooter-encode.h"
+
+#include <string.h>
+#include <glib/gstdio.h>
+#include <libxfce4util/libxfce4util.h>
+
+/* The probe is the screenshot scaled down to about this many pixels */
+#define ENCODE_PROBE_PIXELS  (512 * 512)
+
+/* Predictions from the probe are trusted up to this share of the budget */
+#define ENCODE_SAFETY_MARGIN 0.9
+
+
+
+/* One set of encoder settings, in order of preference */
+typedef struct
+{
+  const gchar *format;
+  const gchar *extension;
+  const gchar *option_key;
+  const gchar *option_value;
+  gsize        predicted_size;
+  gboolean     failed;
+} EncodeCandidate;
+
+static const EncodeCandidate candidates[] =
+{
+  { "png",  "png",  "compression", "9",  0, FALSE },
+  { "webp", "webp", "quality",     "90", 0, FALSE },
+  { "webp", "webp", "quality",     "75", 0, FALSE },
+  { "webp", "webp", "quality",     "60", 0, FALSE },
+  { "jpeg", "jpg",  "quality",     "90", 0, FALSE },
+  { "jpeg", "jpg",  "quality",     "75", 0, FALSE },
+  { "jpeg", "jpg",  "quality",     "60", 0, FALSE },
+  { "jpeg", "jpg",  "quality",     "45", 0, FALSE },
+};
+
+/* Shared by the trial encodes */
+typedef struct
+{
+  GdkPixbuf *probe;
+  gdouble    scale;
+} ProbeData;
+
+
+
+/* Internals */
+
+
+
+static gboolean
+is_format_writable (const gchar *name)
+{
+  GSList *formats = gdk_pixbuf_get_formats ();
+  GSList *format;
+  gboolean writable = FALSE;
+
+  for (format = formats; format != NULL; format = format->next)
+    {
+      gchar *format_name = gdk_pixbuf_format_get_name (format->data);
+
+      if (g_strcmp0 (format_name, name) == 0)
+        writable = gdk_pixbuf_format_is_writable (format->data);
+
+      g_free (format_name);
+    }
+
+  g_slist_free (formats);
+
+  return writable;
+}
+
+
+
+/* JPEG has no alpha channel, flatten the screenshot for it */
+static GdkPixbuf *
+get_encodable_pixbuf (GdkPixbuf *pixbuf, const EncodeCandidate *candidate)
+{
+  if (g_strcmp0 (candidate->format, "jpeg") == 0 && gdk_pixbuf_get_has_alpha (pixbuf))
+    {
+      GdkPixbuf *flat = gdk_pixbuf_new (GDK_COLORSPACE_RGB, FALSE, 8,
+                                        gdk_pixbuf_get_width (pixbuf),
+                                        gdk_pixbuf_get_height (pixbuf));
+
+      gdk_pixbuf_fill (flat, 0xffffffff);
+      gdk_pixbuf_composite (pixbuf, flat, 0, 0,
+                            gdk_pixbuf_get_width (pixbuf),
+                            gdk_pixbuf_get_height (pixbuf),
+                            0, 0, 1, 1, GDK_INTERP_NEAREST, 255);
+
+      return flat;
+    }
+
+  return g_object_ref (pixbuf);
+}
+
+
+
+static gboolean
+encode (GdkPixbuf              *pixbuf,
+        const EncodeCandidate  *candidate,
+        gchar                 **buffer,
+        gsize                  *size,
+        GError                **error)
+{
+  GdkPixbuf *encodable = get_encodable_pixbuf (pixbuf, candidate);
+  gchar *keys[] = { (gchar *) candidate->option_key, NULL };
+  gchar *values[] = { (gchar *) candidate->option_value, NULL };
+  gboolean success;
+
+  success = gdk_pixbuf_save_to_bufferv (encodable, buffer, size,
+                                        candidate->format, keys, values, error);
+
+  g_object_unref (encodable);
+
+  return success;
+}
+
+
+
+/* Predicts the size of the full encode from the size of the probe encode */
+static void
+trial_encode (EncodeCandidate *candidate, ProbeData *data)
+{
+  gchar *buffer = NULL;
+  gsize size;
+
+  if (encode (data->probe, candidate, &buffer, &size, NULL))
+    candidate->predicted_size = size * data->scale;
+  else
+    candidate->failed = TRUE;
+
+  g_free (buffer);
+}
+
+
+
+/* Returns a copy of @image_path with the extension replaced */
+static gchar *
+get_output_path (const gchar *image_path, const gchar *extension)
+{
+  const gchar *dot = strrchr (image_path, '.');
+  const gchar *slash = strrchr (image_path, G_DIR_SEPARATOR);
+  gsize stem_length = strlen (image_path);
+
+  if (dot != NULL && (slash == NULL || dot > slash))
+    stem_length = dot - image_path;
+
+  return g_strdup_printf ("%.*s-upload.%s", (gint) stem_length, image_path, extension);
+}
+
+
+
+/* Public */
+
+
+
+/**
+ * screenshooter_encode_within_budget:
+ * @screenshot: the screenshot.
+ * @image_path: the screenshot saved as PNG.
+ * @max_bytes: the maximal size of the upload.
+ * @error: return location for a #GError.
+ *
+ * Finds encoder settings for @screenshot which fit in @max_bytes, to bound
+ * the transfer time of the upload. The settings are tried in order of
+ * preference: maximal PNG compression, then lossy WebP if the WebP saver
+ * of gdk-pixbuf is installed, then JPEG, both at decreasing quality.
+ *
+ * The size of every candidate is predicted by encoding a scaled down probe
+ * of the screenshot. Nothing runs beside the calling thread, so that an
+ * encode job only uses the slot it got. Only the preferred candidate
+ * predicted to fit is then encoded at full size; if it does not fit after
+ * all, the next one is tried. When none fits, the smallest one is used.
+ *
+ * Return value: the newly allocated path of a file next to @image_path
+ * holding the encoded screenshot, or a copy of @image_path if it already
+ * fits. %NULL if encoding failed.
+ **/
+gchar *
+screenshooter_encode_within_budget (GdkPixbuf    *screenshot,
+                                    const gchar  *image_path,
+                                    gsize         max_bytes,
+                                    GError      **error)
+{
+  EncodeCandidate trials[G_N_ELEMENTS (candidates)];
+  ProbeData data;
+  gint width, height, step = 1;
+  gchar *output_path = NULL;
+  gchar *smallest_buffer = NULL;
+  gsize smallest_size = G_MAXSIZE;
+  const EncodeCandidate *smallest = NULL;
+  GStatBuf st;
+  guint i;
+
+  g_return_val_if_fail (GDK_IS_PIXBUF (screenshot), NULL);
+  g_return_val_if_fail (image_path != NULL, NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  if (g_stat (image_path, &st) == 0 && (gsize) st.st_size <= max_bytes)
+    return g_strdup (image_path);
+
+  width = gdk_pixbuf_get_width (screenshot);
+  height = gdk_pixbuf_get_height (screenshot);
+
+  /* Build the probe */
+  while ((gint64) (width / step) * (height / step) > ENCODE_PROBE_PIXELS)
+    step++;
+
+  data.probe = gdk_pixbuf_scale_simple (screenshot,
+                                        MAX (1, width / step),
+                                        MAX (1, height / step),
+                                        GDK_INTERP_BILINEAR);
+  data.scale = ((gdouble) width * height) /
+               ((gdouble) gdk_pixbuf_get_width (data.probe) * gdk_pixbuf_get_height (data.probe));
+
+  TRACE ("Probe the encoders at 1/%d of the size", step);
+
+  memcpy (trials, candidates, sizeof (candidates));
+
+  /* The probe is small, the trial encodes run one after the other in the
+   * thread of the caller, i.e. within its encode slot */
+  for (i = 0; i < G_N_ELEMENTS (trials); i++)
+    {
+      trials[i].predicted_size = 0;
+      trials[i].failed = !is_format_writable (trials[i].format);
+
+      if (!trials[i].failed)
+        trial_encode (&trials[i], &data);
+    }
+
+  g_object_unref (data.probe);
+
+  for (i = 0; i < G_N_ELEMENTS (trials) && output_path == NULL; i++)
+    {
+      gchar *buffer = NULL;
+      gsize size;
+
+      if (trials[i].failed ||
+          trials[i].predicted_size > max_bytes * ENCODE_SAFETY_MARGIN)
+        continue;
+
+      TRACE ("%s %s=%s predicted to %" G_GSIZE_FORMAT " bytes",
+             trials[i].format, trials[i].option_key,
+             trials[i].option_value, trials[i].predicted_size);
+
+      if (!encode (screenshot, &trials[i], &buffer, &size, NULL))
+        continue;
+
+      if (size <= max_bytes)
+        {
+          output_path = get_output_path (image_path, trials[i].extension);
+
+          if (!g_file_set_contents (output_path, buffer, size, error))
+            {
+              g_free (output_path);
+              output_path = NULL;
+              g_free (buffer);
+              g_free (smallest_buffer);
+
+              return NULL;
+            }
+        }
+
+      if (size < smallest_size)
+        {
+          g_free (smallest_buffer);
+          smallest_buffer = buffer;
+          smallest_size = size;
+          smallest = &trials[i];
+        }
+      else
+        g_free (buffer);
+    }
+
+  if (output_path != NULL)
+    {
+      g_free (smallest_buffer);
+      return output_path;
+    }
+
+  /* Nothing fits, send the smallest encode that could be made */
+  if (smallest == NULL)
+    {
+      for (i = 0; i < G_N_ELEMENTS (trials); i++)
+        if (!trials[i].failed &&
+            (smallest == NULL || trials[i].predicted_size < smallest->predicted_size))
+          smallest = &trials[i];
+
+      if (smallest == NULL ||
+          !encode (screenshot, smallest, &smallest_buffer, &smallest_size, error))
+        {
+          if (smallest == NULL)
+            g_set_error (error, GDK_PIXBUF_ERROR, GDK_PIXBUF_ERROR_UNSUPPORTED_OPERATION,
+                         _("No image encoder is available."));
+          return NULL;
+        }
+    }
+
+  g_warning ("The screenshot takes %" G_GSIZE_FORMAT " bytes, more than the %"
+             G_GSIZE_FORMAT " bytes allowed for the upload", smallest_size, max_bytes);
+
+  output_path = get_output_path (image_path, smallest->extension);
+
+  if (!g_file_set_contents (output_path, smallest_buffer, smallest_size, error))
+    {
+      g_free (output_path);
+      output_path = NULL;
+    }
+
+  g_free (smallest_buffer);
+
+  return output_path;
+}
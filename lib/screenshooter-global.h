@@ -34,9 +34,13 @@ enum {
   CLIPBOARD = 2,
   OPEN = 4,
   UPLOAD_IMGUR = 8,
-  UPLOAD_IPFS = 16
+  UPLOAD_IPFS = 16,
+  UPLOAD_S3 = 32
 };
 
+/* The actions uploading the screenshot */
+#define UPLOAD_ACTIONS (UPLOAD_IMGUR | UPLOAD_IPFS | UPLOAD_S3)
+
 
 
 /* Struct to store the screenshot options */
@@ -50,12 +54,36 @@ typedef struct
   gboolean plugin;
   gboolean action_specified;
   gboolean timestamp;
+  gboolean trim;
   gchar *screenshot_dir;
   gchar *title;
   gchar *app;
   GAppInfo *app_info;
   gchar *last_user;
-  GdkPixbuf *screenshot;
+  gchar *ipfs_api_url;
+  gboolean ipfs_pin;
+  gint ipfs_cid_version;
+  gboolean ipfs_raw_leaves;
+  gchar *ipfs_chunker;
+  gchar *ipfs_gateways;
+  gint max_upload_bytes;
+  gint upload_rate;
+  gchar *s3_endpoint;
+  gchar *s3_bucket;
+  gchar *s3_region;
+  gchar *s3_access_key;
+  gchar *s3_secret_key;
+  gchar *s3_prefix;
+  gchar *s3_public_url;
+  gint s3_part_size;
+  gint s3_jobs;
+  gint pipeline_depth;
+  gint upload_jobs;
+  gchar *overflow_policy;
+  gboolean hotkeys;
+  gchar *hotkey_fullscreen;
+  gchar *hotkey_window;
+  gchar *hotkey_region;
 }
 ScreenshotData;
 
@@ -0,0 +1,252 @@
+/*  $Id$
+ *
+ *  Copyright © 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ * */
+
+#include "screenshooter-hotkeys.h"
+
+#include <gdk/gdkx.h>
+#include <gio/gio.h>
+#include <X11/Xlib.h>
+
+#include <libxfce4util/libxfce4util.h>
+
+/* The modifiers which take part in a hotkey, Caps Lock, Num Lock and
+ * Scroll Lock do not */
+#define HOTKEY_MASKS (ShiftMask | ControlMask | Mod1Mask | Mod3Mask | Mod4Mask)
+
+
+
+typedef struct
+{
+  guint keycode;
+  guint modifiers;
+  gint  region;
+} Hotkey;
+
+struct _ScreenshooterHotkeys
+{
+  GdkWindow               *root;
+  GArray                  *keys;
+  ScreenshooterHotkeyFunc  func;
+  gpointer                 user_data;
+};
+
+
+
+/* Internals */
+
+
+
+/* Grabs or ungrabs @keycode with @modifiers on the root window, with all
+ * the combinations of the lock modifiers */
+static void
+grab_key (ScreenshooterHotkeys *hotkeys,
+          guint                 keycode,
+          guint                 modifiers,
+          gboolean              grab)
+{
+  Display *display = GDK_WINDOW_XDISPLAY (hotkeys->root);
+  Window root = GDK_WINDOW_XID (hotkeys->root);
+  const guint locks[] = { LockMask, Mod2Mask, Mod5Mask };
+  guint i, j;
+
+  for (i = 0; i < 1 << G_N_ELEMENTS (locks); i++)
+    {
+      guint mask = modifiers;
+
+      for (j = 0; j < G_N_ELEMENTS (locks); j++)
+        if (i & (1 << j))
+          mask |= locks[j];
+
+      if (grab)
+        XGrabKey (display, keycode, mask, root, False, GrabModeAsync, GrabModeAsync);
+      else
+        XUngrabKey (display, keycode, mask, root);
+    }
+}
+
+
+
+/* Runs the function of the hotkey pressed, straight from the X event */
+static GdkFilterReturn
+filter_key_press (GdkXEvent *gdk_xevent, GdkEvent *event, ScreenshooterHotkeys *hotkeys)
+{
+  XEvent *xevent = (XEvent *) gdk_xevent;
+  guint modifiers, i;
+
+  if (xevent->type != KeyPress)
+    return GDK_FILTER_CONTINUE;
+
+  modifiers = xevent->xkey.state & HOTKEY_MASKS;
+
+  for (i = 0; i < hotkeys->keys->len; i++)
+    {
+      Hotkey *key = &g_array_index (hotkeys->keys, Hotkey, i);
+
+      if (key->keycode == xevent->xkey.keycode && key->modifiers == modifiers)
+        {
+          TRACE ("Hotkey of region %d pressed", key->region);
+
+          (*hotkeys->func) (key->region, hotkeys->user_data);
+
+          return GDK_FILTER_REMOVE;
+        }
+    }
+
+  return GDK_FILTER_CONTINUE;
+}
+
+
+
+/* Public */
+
+
+
+/**
+ * screenshooter_hotkeys_new:
+ * @func: the function called when a hotkey is pressed.
+ * @user_data: the data passed to @func.
+ *
+ * Return value: a set of global hotkeys, with none bound yet. Free it
+ * with screenshooter_hotkeys_free().
+ **/
+ScreenshooterHotkeys *
+screenshooter_hotkeys_new (ScreenshooterHotkeyFunc func, gpointer user_data)
+{
+  ScreenshooterHotkeys *hotkeys;
+
+  g_return_val_if_fail (func != NULL, NULL);
+
+  hotkeys = g_new0 (ScreenshooterHotkeys, 1);
+  hotkeys->root = gdk_get_default_root_window ();
+  hotkeys->keys = g_array_new (FALSE, FALSE, sizeof (Hotkey));
+  hotkeys->func = func;
+  hotkeys->user_data = user_data;
+
+  gdk_window_add_filter (hotkeys->root, (GdkFilterFunc) filter_key_press, hotkeys);
+
+  return hotkeys;
+}
+
+
+
+/**
+ * screenshooter_hotkeys_bind:
+ * @hotkeys: a #ScreenshooterHotkeys.
+ * @accelerator: the hotkey, in the format of gtk_accelerator_parse(), as
+ * "&lt;Shift&gt;Print".
+ * @region: the region passed to the function of @hotkeys when it is
+ * pressed.
+ * @error: return location for an error.
+ *
+ * Grabs @accelerator on the whole display. The function of @hotkeys is
+ * called from the X event filter as soon as it is pressed, without going
+ * through the keyboard shortcuts daemon and a new process.
+ *
+ * Return value: %FALSE if @accelerator is invalid or is already grabbed
+ * by another application, usually the keyboard shortcuts daemon.
+ **/
+gboolean
+screenshooter_hotkeys_bind (ScreenshooterHotkeys  *hotkeys,
+                            const gchar           *accelerator,
+                            gint                   region,
+                            GError               **error)
+{
+  GdkDisplay *display;
+  GdkModifierType modifiers;
+  Hotkey key;
+  guint keyval;
+
+  g_return_val_if_fail (hotkeys != NULL, FALSE);
+  g_return_val_if_fail (accelerator != NULL, FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  display = gdk_window_get_display (hotkeys->root);
+
+  gtk_accelerator_parse (accelerator, &keyval, &modifiers);
+
+  /* Super, Hyper and Meta to the modifiers they are mapped to */
+  gdk_keymap_map_virtual_modifiers (gdk_keymap_get_for_display (display), &modifiers);
+
+  key.keycode = keyval != 0 ? XKeysymToKeycode (GDK_DISPLAY_XDISPLAY (display), keyval) : 0;
+  key.modifiers = modifiers & HOTKEY_MASKS;
+  key.region = region;
+
+  if (key.keycode == 0)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                   _("%s is not a valid hotkey."), accelerator);
+      return FALSE;
+    }
+
+  gdk_x11_display_error_trap_push (display);
+  grab_key (hotkeys, key.keycode, key.modifiers, TRUE);
+
+  if (gdk_x11_display_error_trap_pop (display) != 0)
+    {
+      /* Release the combinations which could be grabbed */
+      gdk_x11_display_error_trap_push (display);
+      grab_key (hotkeys, key.keycode, key.modifiers, FALSE);
+      gdk_x11_display_error_trap_pop_ignored (display);
+
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_EXISTS,
+                   _("%s is already used by another application."), accelerator);
+      return FALSE;
+    }
+
+  TRACE ("Grabbed %s for region %d", accelerator, region);
+
+  g_array_append_val (hotkeys->keys, key);
+
+  return TRUE;
+}
+
+
+
+/**
+ * screenshooter_hotkeys_free:
+ * @hotkeys: a #ScreenshooterHotkeys.
+ *
+ * Releases the hotkeys bound to @hotkeys and frees it.
+ **/
+void
+screenshooter_hotkeys_free (ScreenshooterHotkeys *hotkeys)
+{
+  GdkDisplay *display;
+  guint i;
+
+  g_return_if_fail (hotkeys != NULL);
+
+  display = gdk_window_get_display (hotkeys->root);
+
+  gdk_window_remove_filter (hotkeys->root, (GdkFilterFunc) filter_key_press, hotkeys);
+
+  gdk_x11_display_error_trap_push (display);
+
+  for (i = 0; i < hotkeys->keys->len; i++)
+    {
+      Hotkey *key = &g_array_index (hotkeys->keys, Hotkey, i);
+
+      grab_key (hotkeys, key->keycode, key->modifiers, FALSE);
+    }
+
+  gdk_x11_display_error_trap_pop_ignored (display);
+
+  g_array_free (hotkeys->keys, TRUE);
+  g_free (hotkeys);
+}
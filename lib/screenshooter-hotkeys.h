@@ -0,0 +1,42 @@
+/*  $Id$
+ *
+ *  Copyright © 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ * */
+
+#ifndef __HAVE_HOTKEYS_H__
+#define __HAVE_HOTKEYS_H__
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <gtk/gtk.h>
+
+typedef void (*ScreenshooterHotkeyFunc) (gint     region,
+                                         gpointer user_data);
+
+typedef struct _ScreenshooterHotkeys ScreenshooterHotkeys;
+
+ScreenshooterHotkeys *screenshooter_hotkeys_new  (ScreenshooterHotkeyFunc  func,
+                                                  gpointer                 user_data);
+gboolean              screenshooter_hotkeys_bind (ScreenshooterHotkeys    *hotkeys,
+                                                  const gchar             *accelerator,
+                                                  gint                     region,
+                                                  GError                 **error);
+void                  screenshooter_hotkeys_free (ScreenshooterHotkeys    *hotkeys);
+
+#endif
@@ -20,6 +20,7 @@
 
 #include "screenshooter-imgur.h"
 #include "screenshooter-job-callbacks.h"
+#include "screenshooter-upload.h"
 #include <string.h>
 #include <stdlib.h>
 #include <libsoup/soup.h>
@@ -29,18 +30,30 @@ static gboolean          imgur_upload_job          (ScreenshooterJob  *job,
                                                     GArray            *param_values,
                                                     GError           **error);
 
+/* Returns the extension of the image at @link, or of @image_path if the
+ * response had no link: imgur keeps the format of the upload */
+static gchar *
+get_extension (const gchar *link, const gchar *image_path)
+{
+  const gchar *path = link != NULL ? link : image_path;
+  const gchar *dot = strrchr (path, '.');
+  const gchar *slash = strrchr (path, '/');
+
+  if (dot == NULL || (slash != NULL && dot < slash) || dot[1] == '\0')
+    return g_strdup ("png");
+
+  return g_ascii_strdown (dot + 1, -1);
+}
+
+
+
 static gboolean
 imgur_upload_job (ScreenshooterJob *job, GArray *param_values, GError **error)
 {
   const gchar *image_path, *title;
-  gchar *online_file_name = NULL;
-  const gchar* proxy_uri;
-  SoupURI *soup_proxy_uri;
-#if DEBUG > 0
-  SoupLogger *log;
-#endif
+  gchar *online_file_name = NULL, *extension;
+  xmlChar *id = NULL, *link = NULL;
   guint status;
-  SoupSession *session;
   SoupMessage *msg;
   SoupBuffer *buf;
   GMappedFile *mapping;
@@ -48,7 +61,7 @@ imgur_upload_job (ScreenshooterJob *job, GArray *param_values, GError **error)
   xmlDoc *doc;
   xmlNode *root_node, *child_node;
 
-  const gchar *upload_url = "https://api.imgur.com/3/upload.xml";
+  const gchar *upload_url = screenshooter_imgur_get_upload_url ();
 
   GError *tmp_error = NULL;
 
@@ -67,28 +80,13 @@ imgur_upload_job (ScreenshooterJob *job, GArray *param_values, GError **error)
   image_path = g_value_get_string (&g_array_index (param_values, GValue, 0));
   title = g_value_get_string (&g_array_index (param_values, GValue, 1));
 
-  session = soup_session_new ();
-#if DEBUG > 0
-  log = soup_logger_new (SOUP_LOGGER_LOG_HEADERS, -1);
-  soup_session_add_feature (session, (SoupSessionFeature *)log);
-#endif
-
-  /* Set the proxy URI if any */
-  proxy_uri = g_getenv ("http_proxy");
-
-  if (proxy_uri != NULL)
+  mapping = g_mapped_file_new (image_path, FALSE, &tmp_error);
+  if (!mapping)
     {
-      soup_proxy_uri = soup_uri_new (proxy_uri);
-      g_object_set (session, "proxy-uri", soup_proxy_uri, NULL);
-      soup_uri_free (soup_proxy_uri);
-    }
-
-  mapping = g_mapped_file_new(image_path, FALSE, NULL);
-  if (!mapping) {
-    g_object_unref (session);
+      g_propagate_error (error, tmp_error);
 
-    return FALSE;
-  }
+      return FALSE;
+    }
 
   mp = soup_multipart_new(SOUP_FORM_MIME_TYPE_MULTIPART);
   buf = soup_buffer_new_with_owner (g_mapped_file_get_contents (mapping),
@@ -98,12 +96,32 @@ imgur_upload_job (ScreenshooterJob *job, GArray *param_values, GError **error)
   soup_multipart_append_form_file (mp, "image", NULL, NULL, buf);
   soup_multipart_append_form_string (mp, "name", title);
   soup_multipart_append_form_string (mp, "title", title);
-  msg = soup_form_request_new_from_multipart (upload_url, mp);
+  msg = screenshooter_upload_message_new (SOUP_METHOD_POST, upload_url, mp);
+  soup_multipart_free (mp);
+
+  /* The address can be overridden from the environment */
+  if (G_UNLIKELY (msg == NULL))
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                   _("%s is not a valid upload address."), upload_url);
+      soup_buffer_free (buf);
+
+      return FALSE;
+    }
 
   // for v3 API - key registered *only* for xfce4-screenshooter!
   soup_message_headers_append (msg->request_headers, "Authorization", "Client-ID 66ab680b597e293");
   exo_job_info_message (EXO_JOB (job), _("Upload the screenshot..."));
-  status = soup_session_send_message (session, msg);
+  status = screenshooter_upload_send_message (job, msg);
+
+  if (status == SOUP_STATUS_CANCELLED)
+    {
+      exo_job_set_error_if_cancelled (EXO_JOB (job), error);
+      soup_buffer_free (buf);
+      g_object_unref (msg);
+
+      return FALSE;
+    }
 
   if (!SOUP_STATUS_IS_SUCCESSFUL (status))
     {
@@ -115,28 +133,42 @@ imgur_upload_job (ScreenshooterJob *job, GArray *param_values, GError **error)
                          _("An error occurred while transferring the data"
                            " to imgur."));
       g_propagate_error (error, tmp_error);
-      g_object_unref (session);
+      soup_buffer_free (buf);
       g_object_unref (msg);
 
       return FALSE;
     }
 
   TRACE("response was %s\n", msg->response_body->data);
-  /* returned XML is like <data type="array" success="1" status="200"><id>xxxxxx</id> */
+  /* returned XML is like <data type="array" success="1" status="200"><id>xxxxxx</id>
+   * <link>https://i.imgur.com/xxxxxx.jpg</link> */
   doc = xmlParseMemory(msg->response_body->data,
                                   strlen(msg->response_body->data));
 
   root_node = xmlDocGetRootElement(doc);
   for (child_node = root_node->children; child_node; child_node = child_node->next)
-    if (xmlStrEqual(child_node->name, (const xmlChar *) "id"))
-       online_file_name = xmlNodeGetContent(child_node);
-  TRACE("found picture id %s\n", online_file_name);
+    if (xmlStrEqual(child_node->name, (const xmlChar *) "id") && id == NULL)
+       id = xmlNodeGetContent(child_node);
+    else if (xmlStrEqual(child_node->name, (const xmlChar *) "link") && link == NULL)
+       link = xmlNodeGetContent(child_node);
+  TRACE("found picture id %s\n", id);
   xmlFreeDoc(doc);
+
+  /* The name of the upload is the id with the extension of the image */
+  if (id != NULL)
+    {
+      extension = get_extension ((const gchar *) link, image_path);
+      online_file_name = g_strdup_printf ("%s.%s", (const gchar *) id, extension);
+      g_free (extension);
+    }
+
+  xmlFree (id);
+  xmlFree (link);
   soup_buffer_free (buf);
-  g_object_unref (session);
   g_object_unref (msg);
 
   screenshooter_job_image_uploaded (job, online_file_name);
+  g_free (online_file_name);
 
   return TRUE;
 }
@@ -146,28 +178,93 @@ imgur_upload_job (ScreenshooterJob *job, GArray *param_values, GError **error)
 
 
 
+/**
+ * screenshooter_imgur_get_upload_url:
+ *
+ * Return value: the address the screenshots are uploaded to, owned by the
+ * library.
+ **/
+const gchar *
+screenshooter_imgur_get_upload_url (void)
+{
+  return screenshooter_upload_get_endpoint ("SCREENSHOOTER_IMGUR_URL",
+                                            "https://api.imgur.com/3/upload.xml");
+}
+
+
+
+/**
+ * screenshooter_imgur_get_image_url:
+ * @upload_name: the name of an uploaded image, as given by "image-uploaded".
+ *
+ * The name is the id of the image followed by the extension of its
+ * format, e.g. abcdefg.jpg. A bare id is taken as a PNG image.
+ *
+ * Return value: the newly allocated address of the full size image on
+ * imgur.com.
+ **/
+gchar *
+screenshooter_imgur_get_image_url (const gchar *upload_name)
+{
+  g_return_val_if_fail (upload_name != NULL, NULL);
+
+  if (strchr (upload_name, '.') != NULL)
+    return g_strdup_printf ("https://i.imgur.com/%s", upload_name);
+
+  return g_strdup_printf ("https://i.imgur.com/%s.png", upload_name);
+}
+
+
+
+
+/**
+ * screenshooter_imgur_upload_launch:
+ * @image_path: the local path of the image to upload.
+ * @title: the title of the screenshot.
+ *
+ * Starts the upload of @image_path to imgur.com, without any user interface.
+ * The job emits "image-uploaded" with the name of the uploaded image, or
+ * "error", then "finished".
+ *
+ * Return value: the running #ScreenshooterJob.
+ **/
+ScreenshooterJob *
+screenshooter_imgur_upload_launch (const gchar *image_path, const gchar *title)
+{
+  g_return_val_if_fail (image_path != NULL, NULL);
+
+  return screenshooter_simple_job_launch (imgur_upload_job, 2,
+                                          G_TYPE_STRING, image_path,
+                                          G_TYPE_STRING, title);
+}
+
+
+
 /**
  * screenshooter_upload_to_imgur:
  * @image_path: the local path of the image that should be uploaded to
  * imgur.com.
  *
- * Uploads the image whose path is @image_path
+ * Uploads the image whose path is @image_path in the background. A dialog
+ * shows the progress, then the links; this returns right away.
  *
+ * Return value: the running #ScreenshooterJob, owned by the dialog.
  **/
 
-void screenshooter_upload_to_imgur   (const gchar  *image_path,
-                                      const gchar  *title)
+ScreenshooterJob *screenshooter_upload_to_imgur   (const gchar  *image_path,
+                                                   const gchar  *title)
 {
   ScreenshooterJob *job;
   GtkWidget *dialog, *label;
 
-  g_return_if_fail (image_path != NULL);
+  g_return_val_if_fail (image_path != NULL, NULL);
+
+  /* Released by cb_finished */
+  screenshooter_hold ();
 
   dialog = create_spinner_dialog(_("Imgur"), &label);
 
-  job = screenshooter_simple_job_launch (imgur_upload_job, 2,
-                                          G_TYPE_STRING, image_path,
-                                          G_TYPE_STRING, title);
+  job = screenshooter_imgur_upload_launch (image_path, title);
 
   /* dismiss the spinner dialog after success or error */
   g_signal_connect_swapped (job, "error", G_CALLBACK (gtk_widget_hide), dialog);
@@ -175,9 +272,17 @@ void screenshooter_upload_to_imgur   (const gchar  *image_path,
 
   g_signal_connect (job, "ask", G_CALLBACK (cb_ask_for_information), NULL);
   g_signal_connect (job, "image-uploaded", G_CALLBACK (cb_image_uploaded), NULL);
-  g_signal_connect (job, "error", G_CALLBACK (cb_error), NULL);
+  g_signal_connect (job, "error", G_CALLBACK (cb_upload_error),
+                    GINT_TO_POINTER (UPLOAD_IMGUR));
   g_signal_connect (job, "finished", G_CALLBACK (cb_finished), dialog);
   g_signal_connect (job, "info-message", G_CALLBACK (cb_update_info), label);
+  g_signal_connect (job, "percent", G_CALLBACK (cb_update_percent), dialog);
+
+  /* the cancel button aborts the transfer */
+  g_signal_connect_swapped (dialog, "response", G_CALLBACK (exo_job_cancel), job);
+
+  /* The upload goes on in the background, the dialog only reports it */
+  gtk_widget_show (dialog);
 
-  gtk_dialog_run (GTK_DIALOG (dialog));
+  return job;
 }
@@ -30,7 +30,13 @@
 #include "screenshooter-utils.h"
 #include "screenshooter-simple-job.h"
 
-void screenshooter_upload_to_imgur (const gchar  *image_path,
-                                    const gchar  *title);
+const gchar      *screenshooter_imgur_get_upload_url (void);
+gchar            *screenshooter_imgur_get_image_url (const gchar  *upload_name);
+
+ScreenshooterJob *screenshooter_imgur_upload_launch (const gchar  *image_path,
+                                                     const gchar  *title);
+
+ScreenshooterJob *screenshooter_upload_to_imgur (const gchar  *image_path,
+                                                 const gchar  *title);
 
 #endif
@@ -0,0 +1,449 @@
+/*  $Id$
+ *
+ *  Copyright © 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ * */
+
+#include "screenshooter-interval.h"
+#include "screenshooter-capture.h"
+#include "screenshooter-pipeline.h"
+#include "screenshooter-utils.h"
+
+#include <signal.h>
+
+#include <glib-unix.h>
+#include <libxfce4util/libxfce4util.h>
+
+
+
+typedef struct
+{
+  GMainLoop       *loop;
+  GSource         *deadline;
+  GCancellable    *cancellable;
+  GdkWindow       *root;
+  GdkRectangle     area;
+  gchar           *directory;
+  const gchar     *title;
+  gint64           interval;
+  guint            count;
+
+  /* Deadlines are start + n * interval, on the monotonic clock */
+  gint64           start;
+  gint64           end;
+  guint64          n_deadlines;
+
+  guint            n_captured;
+  guint            n_missed;
+  guint            n_dropped;
+  gint             n_failed;
+
+  /* Free surfaces of the pool, and the frames waiting to be written; the
+   * encoder writes one while the next ones are taken, the overflow policy
+   * applies once they are all in use */
+  guint            pool_size;
+  ScreenshooterOverflowPolicy policy;
+  GAsyncQueue     *free_surfaces;
+  GAsyncQueue     *frames;
+  GThread         *encoder;
+  gboolean         success;
+} IntervalData;
+
+/* A surface of the pool on its way to the encoder, a frame without a
+ * surface ends the encoder */
+typedef struct
+{
+  cairo_surface_t *surface;
+  gchar           *path;
+} IntervalFrame;
+
+
+
+/* Internals */
+
+
+
+/* A source which is only ready at the deadline set with
+ * g_source_set_ready_time() */
+static gboolean
+deadline_dispatch (GSource *source, GSourceFunc callback, gpointer user_data)
+{
+  return (*callback) (user_data);
+}
+
+static GSourceFuncs deadline_funcs =
+{
+  NULL,
+  NULL,
+  deadline_dispatch,
+  NULL,
+};
+
+
+
+static gpointer
+encode_frames (IntervalData *data)
+{
+  IntervalFrame *frame;
+
+  while ((frame = g_async_queue_pop (data->frames))->surface != NULL)
+    {
+      cairo_status_t status = cairo_surface_write_to_png (frame->surface, frame->path);
+
+      if (status != CAIRO_STATUS_SUCCESS)
+        {
+          g_printerr ("%s\terror: %s\n", frame->path, cairo_status_to_string (status));
+          g_atomic_int_inc (&data->n_failed);
+        }
+
+      g_async_queue_push (data->free_surfaces, frame->surface);
+      g_free (frame->path);
+      g_free (frame);
+    }
+
+  g_free (frame);
+
+  return NULL;
+}
+
+
+
+/* The frames are named after the time of their capture, and numbered
+ * since several of them may be taken in the same second */
+static gchar *
+get_frame_path (IntervalData *data)
+{
+  gchar *datetime, *name, *path;
+
+  datetime = screenshooter_get_datetime ("%Y-%m-%d_%H-%M-%S");
+  name = g_strdup_printf ("%s_%s_%05u.png", data->title, datetime, data->n_captured);
+  path = g_build_filename (data->directory, name, NULL);
+
+  g_free (datetime);
+  g_free (name);
+
+  return path;
+}
+
+
+
+static void
+stop_capturing (IntervalData *data)
+{
+  IntervalFrame *end = g_new0 (IntervalFrame, 1);
+
+  if (data->deadline != NULL)
+    {
+      g_source_destroy (data->deadline);
+      g_source_unref (data->deadline);
+      data->deadline = NULL;
+    }
+
+  data->end = g_get_monotonic_time ();
+
+  g_async_queue_push (data->frames, end);
+  g_main_loop_quit (data->loop);
+}
+
+
+
+/* Returns a surface to capture into, or %NULL if the capture is dropped
+ * because all the surfaces are waiting for the encoder */
+static cairo_surface_t *
+get_free_surface (IntervalData *data)
+{
+  cairo_surface_t *surface;
+  IntervalFrame *oldest;
+
+  surface = g_async_queue_try_pop (data->free_surfaces);
+
+  if (surface != NULL || data->policy == SCREENSHOOTER_OVERFLOW_DROP_NEWEST)
+    return surface;
+
+  if (data->policy == SCREENSHOOTER_OVERFLOW_BLOCK)
+    return g_async_queue_pop (data->free_surfaces);
+
+  /* Drop the oldest frame not written yet, unless the encoder took it */
+  oldest = g_async_queue_try_pop (data->frames);
+
+  if (oldest == NULL)
+    return NULL;
+
+  surface = oldest->surface;
+  g_free (oldest->path);
+  g_free (oldest);
+
+  data->n_dropped++;
+
+  return surface;
+}
+
+
+
+static gboolean
+cb_deadline (IntervalData *data)
+{
+  cairo_surface_t *surface;
+  gint64 now, next;
+
+  surface = get_free_surface (data);
+
+  if (surface == NULL)
+    data->n_dropped++;
+  else
+    {
+      IntervalFrame *frame = g_new0 (IntervalFrame, 1);
+      cairo_t *cr = cairo_create (surface);
+
+      gdk_cairo_set_source_window (cr, data->root, -data->area.x, -data->area.y);
+      cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+      cairo_paint (cr);
+      cairo_destroy (cr);
+      cairo_surface_flush (surface);
+
+      data->n_captured++;
+
+      frame->surface = surface;
+      frame->path = get_frame_path (data);
+      g_async_queue_push (data->frames, frame);
+    }
+
+  data->n_deadlines++;
+
+  if (data->count > 0 && data->n_captured >= data->count)
+    {
+      stop_capturing (data);
+      return FALSE;
+    }
+
+  /* The next deadline is on the grid set by the first one, whatever the
+   * time this capture took; those already past are skipped */
+  now = g_get_monotonic_time ();
+  next = data->start + (gint64) data->n_deadlines * data->interval;
+
+  if (next <= now)
+    {
+      guint64 n_late = (now - next) / data->interval + 1;
+
+      data->n_missed += n_late;
+      data->n_deadlines += n_late;
+      next += (gint64) n_late * data->interval;
+    }
+
+  g_source_set_ready_time (data->deadline, next);
+
+  return TRUE;
+}
+
+
+
+static gboolean
+cb_interrupted (IntervalData *data)
+{
+  /* The window is being picked or the region selected */
+  if (data->deadline == NULL)
+    g_cancellable_cancel (data->cancellable);
+  else
+    stop_capturing (data);
+
+  return TRUE;
+}
+
+
+
+static void
+start_capturing (IntervalData *data)
+{
+  GdkRectangle screen;
+  guint i;
+
+  screen.x = 0;
+  screen.y = 0;
+  screen.width = gdk_window_get_width (data->root);
+  screen.height = gdk_window_get_height (data->root);
+
+  if (!gdk_rectangle_intersect (&data->area, &screen, &data->area))
+    {
+      g_printerr (_("The captured area is off the screen.\n"));
+      g_main_loop_quit (data->loop);
+      return;
+    }
+
+  TRACE ("Capture %dx%d+%d+%d every %" G_GINT64_FORMAT " us",
+         data->area.width, data->area.height, data->area.x, data->area.y,
+         data->interval);
+
+  /* Allocated once, the captures only paint into them */
+  for (i = 0; i < data->pool_size; i++)
+    g_async_queue_push (data->free_surfaces,
+                        cairo_image_surface_create (CAIRO_FORMAT_RGB24,
+                                                    data->area.width,
+                                                    data->area.height));
+
+  data->encoder = g_thread_new ("interval-encode", (GThreadFunc) encode_frames, data);
+  data->success = TRUE;
+
+  data->start = g_get_monotonic_time ();
+  data->deadline = g_source_new (&deadline_funcs, sizeof (GSource));
+  g_source_set_priority (data->deadline, G_PRIORITY_HIGH);
+  g_source_set_callback (data->deadline, (GSourceFunc) cb_deadline, data, NULL);
+  g_source_set_ready_time (data->deadline, data->start);
+  g_source_attach (data->deadline, NULL);
+}
+
+
+
+/* The window or the region was captured once, to learn its area */
+static void
+cb_area_captured (GObject *source, GAsyncResult *result, IntervalData *data)
+{
+  ScreenshooterCapture *capture;
+  GError *error = NULL;
+
+  capture = screenshooter_capture_finish (result, &error);
+
+  if (capture == NULL)
+    {
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        g_printerr ("%s\n", error->message);
+
+      g_error_free (error);
+      g_main_loop_quit (data->loop);
+      return;
+    }
+
+  data->area = capture->area;
+  screenshooter_capture_free (capture);
+
+  start_capturing (data);
+}
+
+
+
+/* Public */
+
+
+
+/**
+ * screenshooter_interval_capture:
+ * @sd: the #ScreenshotData holding the save directory and the title.
+ * @region: FULLSCREEN, ACTIVE_WINDOW or SELECT.
+ * @interval: the time between two screenshots, in milliseconds.
+ * @count: the number of screenshots, 0 to go on until SIGINT or SIGTERM.
+ *
+ * Takes a screenshot of @region every @interval milliseconds, in the save
+ * directory of @sd. The window is picked, or the region selected, once;
+ * its area is then captured at each deadline.
+ *
+ * The deadlines are set from the first one on the monotonic clock, so
+ * that slow captures do not delay the next ones. The screenshots are
+ * painted into a pool of pipeline_depth surfaces allocated beforehand,
+ * and written by a thread of their own. A deadline passed during a
+ * capture is missed. Once all the surfaces wait for the encoder, the
+ * overflow_policy of @sd drops the oldest screenshot not written yet,
+ * drops the new one, or waits for the encoder. The number of screenshots,
+ * the rate sustained, and the missed and dropped ones are printed at the
+ * end. The mouse pointer is not drawn.
+ *
+ * Return value: %FALSE if nothing could be captured or some screenshots
+ * could not be written.
+ **/
+gboolean
+screenshooter_interval_capture (const ScreenshotData *sd,
+                                gint                  region,
+                                guint                 interval,
+                                guint                 count)
+{
+  IntervalData data = { 0 };
+  cairo_surface_t *surface;
+  guint term_id, int_id;
+
+  g_return_val_if_fail (sd != NULL, FALSE);
+  g_return_val_if_fail (interval > 0, FALSE);
+
+  data.directory = g_filename_from_uri (sd->screenshot_dir, NULL, NULL);
+
+  if (data.directory == NULL || !g_file_test (data.directory, G_FILE_TEST_IS_DIR))
+    {
+      g_printerr (_("%s is not a valid local directory.\n"), sd->screenshot_dir);
+      g_free (data.directory);
+      return FALSE;
+    }
+
+  data.root = gdk_get_default_root_window ();
+  data.title = sd->title;
+  data.interval = (gint64) interval * 1000;
+  data.count = count;
+  data.pool_size = MAX (sd->pipeline_depth, 1);
+  data.policy = screenshooter_pipeline_parse_policy (sd->overflow_policy);
+  data.cancellable = g_cancellable_new ();
+  data.free_surfaces = g_async_queue_new ();
+  data.frames = g_async_queue_new ();
+  data.loop = g_main_loop_new (NULL, FALSE);
+
+  if (region == FULLSCREEN)
+    {
+      data.area.width = gdk_window_get_width (data.root);
+      data.area.height = gdk_window_get_height (data.root);
+
+      start_capturing (&data);
+    }
+  else
+    {
+      ScreenshooterCaptureRequest *request =
+        screenshooter_capture_request_new (region, 0, FALSE);
+
+      screenshooter_capture_async (request, data.cancellable,
+                                   (GAsyncReadyCallback) cb_area_captured, &data);
+      screenshooter_capture_request_unref (request);
+    }
+
+  term_id = g_unix_signal_add (SIGTERM, (GSourceFunc) cb_interrupted, &data);
+  int_id = g_unix_signal_add (SIGINT, (GSourceFunc) cb_interrupted, &data);
+
+  g_main_loop_run (data.loop);
+
+  g_source_remove (term_id);
+  g_source_remove (int_id);
+
+  if (data.encoder != NULL)
+    {
+      gdouble seconds = (data.end - data.start) / (gdouble) G_USEC_PER_SEC;
+
+      /* Wait for the last frames to be written */
+      g_thread_join (data.encoder);
+
+      g_print (_("%u screenshots in %.1f s, %.2f per second, %u deadlines missed,"
+                 " %u screenshots dropped while the encoder was behind\n"),
+               data.n_captured, seconds,
+               seconds > 0 ? data.n_captured / seconds : 0.0,
+               data.n_missed, data.n_dropped);
+
+      if (data.n_failed > 0)
+        data.success = FALSE;
+    }
+
+  while ((surface = g_async_queue_try_pop (data.free_surfaces)) != NULL)
+    cairo_surface_destroy (surface);
+
+  g_async_queue_unref (data.free_surfaces);
+  g_async_queue_unref (data.frames);
+  g_object_unref (data.cancellable);
+  g_main_loop_unref (data.loop);
+  g_free (data.directory);
+
+  return data.success;
+}
@@ -20,11 +20,72 @@
 
 #include "screenshooter-ipfs.h"
 #include "screenshooter-job-callbacks.h"
+#include "screenshooter-upload.h"
 #include <string.h>
 #include <stdlib.h>
 #include <libsoup/soup.h>
 #include <json-glib/json-glib.h>
 
+/* Relay used when no IPFS node is configured */
+#define IPFS_RELAY_URL "https://api.globalupload.io/transport/add"
+
+/* Path of the add command of the IPFS HTTP API */
+#define IPFS_ADD_PATH  "/api/v0/add"
+
+/* Maximal size in pixels of the thumbnails added next to the screenshot
+ * in its directory, see get_thumbnail_name() */
+#define IPFS_THUMBNAIL_SIZE       640
+#define IPFS_SMALL_THUMBNAIL_SIZE 160
+
+/* Gateways used for the links when none is set in the preferences */
+#define IPFS_DEFAULT_GATEWAYS "https://ipfs.io;https://dweb.link;https://cloudflare-ipfs.com"
+
+/* Result of the last probe, relative to the cache directory, and how
+ * long it is trusted, in seconds. A probe no gateway answered is cached
+ * too, so that the next uploads do not probe again right away */
+#define IPFS_GATEWAY_CACHE_FILE "xfce4/xfce4-screenshooter/ipfs-gateway"
+#define IPFS_GATEWAY_TTL        3600
+
+/* Time given to the gateways to serve a new screenshot, and how long
+ * the link of an upload waits for them, in microseconds */
+#define IPFS_PROBE_TIMEOUT      (10 * G_USEC_PER_SEC)
+#define IPFS_PROBE_WAIT         (3 * G_USEC_PER_SEC)
+
+
+
+/* State of the probe of the gateways for one upload */
+typedef struct
+{
+  GMutex       lock;
+  GCond        cond;
+  SoupSession *session;
+  gchar       *winner;
+  guint        n_running;
+} GatewayProbe;
+
+/* HEAD request sent to one gateway */
+typedef struct
+{
+  GatewayProbe *probe;
+  const gchar  *gateway;
+  SoupMessage  *msg;
+  GThread      *thread;
+} GatewayRequest;
+
+
+
+/* Configured gateways, and the one links are built on */
+G_LOCK_DEFINE_STATIC (gateways);
+static gchar **gateways = NULL;
+static gchar  *preferred_gateway = NULL;
+static gint64  preferred_time = 0;
+static gboolean preferred_loaded = FALSE;
+
+/* Whether a probe runs, signalled by probe_cond when it ends */
+static GMutex   probe_lock;
+static GCond    probe_cond;
+static gboolean probe_running = FALSE;
+
 
 static gboolean          ipfs_upload_job          (ScreenshooterJob  *job,
                                                     GArray            *param_values,
@@ -60,33 +121,388 @@ static char
 	return ret;
 }
 
+/* The add command answers one JSON object per line when several files
+ * are added; the wrapping directory is the one without a name */
+static gchar *
+get_directory_hash (const gchar *ndjson)
+{
+  JsonParser *parser = json_parser_new ();
+  gchar **lines = g_strsplit (ndjson, "\n", -1);
+  gchar *hash = NULL;
+  guint i;
+
+  for (i = 0; lines[i] != NULL && hash == NULL; i++)
+    {
+      JsonNode *root;
+      JsonObject *object;
+
+      if (!json_parser_load_from_data (parser, lines[i], -1, NULL))
+        continue;
+
+      root = json_parser_get_root (parser);
+
+      if (root == NULL || JSON_NODE_TYPE (root) != JSON_NODE_OBJECT)
+        continue;
+
+      object = json_node_get_object (root);
+
+      if (json_object_has_member (object, "Hash") &&
+          json_object_has_member (object, "Name") &&
+          g_strcmp0 (json_object_get_string_member (object, "Name"), "") == 0)
+        hash = g_strdup (json_object_get_string_member (object, "Hash"));
+    }
+
+  g_strfreev (lines);
+  g_object_unref (parser);
+
+  return hash;
+}
+
+
+
+/* Returns the name of the thumbnail of @size pixels of the file
+ * @file_name, which may be escaped: its stem followed by the size, so
+ * that it never takes the name of the file itself */
+static gchar *
+get_thumbnail_name (const gchar *file_name, gint size)
+{
+  const gchar *dot = strrchr (file_name, '.');
+  gsize length = dot != NULL && dot != file_name ? (gsize) (dot - file_name)
+                                                 : strlen (file_name);
+
+  return g_strdup_printf ("%.*s-%d.png", (gint) length, file_name, size);
+}
+
+
+
+/* Returns @image_path scaled down to fit in @size pixels, as PNG data */
+static SoupBuffer *
+create_thumbnail (const gchar *image_path, gint size)
+{
+  GdkPixbuf *thumbnail;
+  gchar *data;
+  gsize length;
+  gint width, height;
+
+  if (gdk_pixbuf_get_file_info (image_path, &width, &height) == NULL)
+    return NULL;
+
+  thumbnail = gdk_pixbuf_new_from_file_at_scale (image_path,
+                                                 MIN (width, size),
+                                                 MIN (height, size),
+                                                 TRUE, NULL);
+
+  if (thumbnail == NULL)
+    return NULL;
+
+  if (!gdk_pixbuf_save_to_buffer (thumbnail, &data, &length, "png", NULL, NULL))
+    {
+      g_object_unref (thumbnail);
+      return NULL;
+    }
+
+  g_object_unref (thumbnail);
+
+  return soup_buffer_new (SOUP_MEMORY_TAKE, data, length);
+}
+
+
+
+/* Loads the result of the last probe, must be called with the gateways
+ * lock held */
+static void
+load_preferred_gateway (void)
+{
+  GKeyFile *keyfile;
+  gchar *path;
+
+  if (preferred_loaded)
+    return;
+
+  preferred_loaded = TRUE;
+  path = xfce_resource_lookup (XFCE_RESOURCE_CACHE, IPFS_GATEWAY_CACHE_FILE);
+
+  if (path == NULL)
+    return;
+
+  keyfile = g_key_file_new ();
+
+  if (g_key_file_load_from_file (keyfile, path, G_KEY_FILE_NONE, NULL))
+    {
+      preferred_gateway = g_key_file_get_string (keyfile, "Gateway", "url", NULL);
+      preferred_time = g_key_file_get_int64 (keyfile, "Gateway", "time", NULL);
+    }
+
+  g_key_file_free (keyfile);
+  g_free (path);
+}
+
+
+
+/* Returns whether the last probe is recent enough to be trusted, whether
+ * it found a gateway or not. Must be called with the gateways lock held */
+static gboolean
+is_probe_fresh (void)
+{
+  load_preferred_gateway ();
+
+  if (preferred_gateway != NULL && gateways != NULL &&
+      !g_strv_contains ((const gchar * const *) gateways, preferred_gateway))
+    return FALSE;
+
+  return g_get_real_time () / G_USEC_PER_SEC - preferred_time < IPFS_GATEWAY_TTL;
+}
+
+
+
+/* Returns the gateway the links are built on */
+static gchar *
+get_gateway (void)
+{
+  gchar *gateway;
+
+  G_LOCK (gateways);
+
+  load_preferred_gateway ();
+
+  if (preferred_gateway != NULL &&
+      (gateways == NULL ||
+       g_strv_contains ((const gchar * const *) gateways, preferred_gateway)))
+    gateway = g_strdup (preferred_gateway);
+  else if (gateways != NULL && gateways[0] != NULL)
+    gateway = g_strdup (gateways[0]);
+  else
+    gateway = g_strdup ("https://ipfs.io");
+
+  G_UNLOCK (gateways);
+
+  return gateway;
+}
+
+
+
+/* Stores the result of a probe, @gateway is %NULL if no gateway served
+ * the screenshot in time: the previous one, if any, is kept */
+static void
+store_probe_result (const gchar *gateway)
+{
+  GKeyFile *keyfile = g_key_file_new ();
+  gchar *path, *data;
+  gsize length;
+
+  G_LOCK (gateways);
+
+  if (gateway != NULL)
+    {
+      g_free (preferred_gateway);
+      preferred_gateway = g_strdup (gateway);
+    }
+
+  preferred_time = g_get_real_time () / G_USEC_PER_SEC;
+
+  if (preferred_gateway != NULL)
+    g_key_file_set_string (keyfile, "Gateway", "url", preferred_gateway);
+  g_key_file_set_int64 (keyfile, "Gateway", "time", preferred_time);
+
+  G_UNLOCK (gateways);
+
+  path = xfce_resource_save_location (XFCE_RESOURCE_CACHE, IPFS_GATEWAY_CACHE_FILE, TRUE);
+  data = g_key_file_to_data (keyfile, &length, NULL);
+
+  if (path != NULL)
+    g_file_set_contents (path, data, length, NULL);
+
+  g_free (data);
+  g_free (path);
+  g_key_file_free (keyfile);
+}
+
+
+
+/* Thread function: asks one gateway whether it serves the screenshot */
+static gpointer
+send_head_request (GatewayRequest *request)
+{
+  GatewayProbe *probe = request->probe;
+  guint status;
+
+  status = soup_session_send_message (probe->session, request->msg);
+
+  g_mutex_lock (&probe->lock);
+
+  if (SOUP_STATUS_IS_SUCCESSFUL (status) && probe->winner == NULL)
+    probe->winner = g_strdup (request->gateway);
+
+  probe->n_running--;
+  g_cond_signal (&probe->cond);
+  g_mutex_unlock (&probe->lock);
+
+  return NULL;
+}
+
+
+
+/* Thread function: sends HEAD requests for @upload_name to all the
+ * gateways at once, the first one answering with the file becomes the
+ * preferred gateway. It runs in the background, the upload job only
+ * waits for it for IPFS_PROBE_WAIT. */
+static gpointer
+probe_gateways (gchar *upload_name)
+{
+  GatewayProbe probe;
+  GatewayRequest *requests;
+  gchar **candidates;
+  gint64 deadline;
+  guint i, n_candidates;
+
+  G_LOCK (gateways);
+  candidates = g_strdupv (gateways);
+  G_UNLOCK (gateways);
+
+  n_candidates = g_strv_length (candidates);
+
+  g_mutex_init (&probe.lock);
+  g_cond_init (&probe.cond);
+  probe.session = screenshooter_upload_get_session ();
+  probe.winner = NULL;
+  probe.n_running = n_candidates;
+
+  requests = g_new0 (GatewayRequest, n_candidates);
+
+  for (i = 0; i < n_candidates; i++)
+    {
+      gchar *url = g_strdup_printf ("%s/ipfs/%s", candidates[i], upload_name);
+
+      requests[i].probe = &probe;
+      requests[i].gateway = candidates[i];
+      requests[i].msg = soup_message_new (SOUP_METHOD_HEAD, url);
+      g_free (url);
+
+      if (requests[i].msg == NULL)
+        {
+          probe.n_running--;
+          continue;
+        }
+
+      requests[i].thread = g_thread_new ("gateway-probe",
+                                         (GThreadFunc) send_head_request,
+                                         &requests[i]);
+    }
+
+  /* Wait for the first gateway serving the file, all of them failing or
+   * the timeout */
+  deadline = g_get_monotonic_time () + IPFS_PROBE_TIMEOUT;
+
+  g_mutex_lock (&probe.lock);
+
+  while (probe.winner == NULL && probe.n_running > 0)
+    if (!g_cond_wait_until (&probe.cond, &probe.lock, deadline))
+      break;
+
+  g_mutex_unlock (&probe.lock);
+
+  for (i = 0; i < n_candidates; i++)
+    if (requests[i].thread != NULL)
+      {
+        soup_session_cancel_message (probe.session, requests[i].msg, SOUP_STATUS_CANCELLED);
+        g_thread_join (requests[i].thread);
+      }
+
+  TRACE ("Fastest gateway: %s", probe.winner != NULL ? probe.winner : "none");
+  store_probe_result (probe.winner);
+
+  g_mutex_lock (&probe_lock);
+  probe_running = FALSE;
+  g_cond_broadcast (&probe_cond);
+  g_mutex_unlock (&probe_lock);
+
+  for (i = 0; i < n_candidates; i++)
+    if (requests[i].msg != NULL)
+      g_object_unref (requests[i].msg);
+
+  g_free (requests);
+  g_free (probe.winner);
+  g_cond_clear (&probe.cond);
+  g_mutex_clear (&probe.lock);
+  g_strfreev (candidates);
+  g_free (upload_name);
+
+  return NULL;
+}
+
+
+
+/* Starts probe_gateways() for @upload_name, unless the last probe is fresh
+ * or another one is running. Returns whether a probe is running. */
+static gboolean
+start_gateway_probe (const gchar *upload_name)
+{
+  gboolean fresh;
+
+  G_LOCK (gateways);
+  fresh = gateways == NULL || is_probe_fresh ();
+  G_UNLOCK (gateways);
+
+  if (fresh)
+    return FALSE;
+
+  g_mutex_lock (&probe_lock);
+
+  if (!probe_running)
+    {
+      probe_running = TRUE;
+      g_thread_unref (g_thread_new ("gateway-probe", (GThreadFunc) probe_gateways,
+                                    g_strdup (upload_name)));
+    }
+
+  g_mutex_unlock (&probe_lock);
+
+  return TRUE;
+}
+
+
+
+/* Waits for the running probe to end, at most IPFS_PROBE_WAIT */
+static void
+wait_for_gateway_probe (void)
+{
+  gint64 deadline = g_get_monotonic_time () + IPFS_PROBE_WAIT;
+
+  g_mutex_lock (&probe_lock);
+
+  while (probe_running)
+    if (!g_cond_wait_until (&probe_cond, &probe_lock, deadline))
+      break;
+
+  g_mutex_unlock (&probe_lock);
+}
+
+
+
 static gboolean
 ipfs_upload_job (ScreenshooterJob *job, GArray *param_values, GError **error)
 {
 
-  const gchar *image_path, *title;
+  const gchar *image_path, *title, *add_url;
+  const gchar *upload_url;
   gchar *online_file_name = NULL;
-  const gchar* proxy_uri;
-  SoupURI *soup_proxy_uri;
-#if DEBUG > 0
-  SoupLogger *log;
-#endif
+  gchar *file_name, *wrapped_url = NULL;
+  SoupBuffer *thumbnail = NULL, *small_thumbnail = NULL;
+  gboolean local_node = FALSE;
   guint status;
-  SoupSession *session;
   SoupMessage *msg;
   SoupBuffer *buf;
   GMappedFile *mapping;
   SoupMultipart *mp;
 
-  const gchar *upload_url = "https://api.globalupload.io/transport/add";
-
   GError *tmp_error = NULL;
 
   g_return_val_if_fail (SCREENSHOOTER_IS_JOB (job), FALSE);
   g_return_val_if_fail (param_values != NULL, FALSE);
-  g_return_val_if_fail (param_values->len == 2, FALSE);
+  g_return_val_if_fail (param_values->len == 3, FALSE);
   g_return_val_if_fail ((G_VALUE_HOLDS_STRING (&g_array_index(param_values, GValue, 0))), FALSE);
   g_return_val_if_fail ((G_VALUE_HOLDS_STRING (&g_array_index(param_values, GValue, 1))), FALSE);
+  g_return_val_if_fail ((G_VALUE_HOLDS_STRING (&g_array_index(param_values, GValue, 2))), FALSE);
   g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
   g_object_set_data (G_OBJECT (job), "jobtype", "ipfs");
@@ -96,44 +512,95 @@ ipfs_upload_job (ScreenshooterJob *job, GArray *param_values, GError **error)
 
   image_path = g_value_get_string (&g_array_index (param_values, GValue, 0));
   title = g_value_get_string (&g_array_index (param_values, GValue, 1));
+  add_url = g_value_get_string (&g_array_index (param_values, GValue, 2));
 
-  session = soup_session_new ();
-#if DEBUG > 0
-  log = soup_logger_new (SOUP_LOGGER_LOG_HEADERS, -1);
-  soup_session_add_feature (session, (SoupSessionFeature *)log);
-#endif
+  upload_url = screenshooter_ipfs_get_upload_url (add_url);
+  local_node = add_url != NULL;
 
-  /* Set the proxy URI if any */
-  proxy_uri = g_getenv ("http_proxy");
+  TRACE ("Add the screenshot with %s", upload_url);
 
-  if (proxy_uri != NULL)
+  mapping = g_mapped_file_new (image_path, FALSE, &tmp_error);
+  if (!mapping)
     {
-      soup_proxy_uri = soup_uri_new (proxy_uri);
-      g_object_set (session, "proxy-uri", soup_proxy_uri, NULL);
-      soup_uri_free (soup_proxy_uri);
-    }
-
-  mapping = g_mapped_file_new(image_path, FALSE, NULL);
-  if (!mapping) {
-    g_object_unref (session);
+      g_propagate_error (error, tmp_error);
 
-    return FALSE;
-  }
+      return FALSE;
+    }
 
   mp = soup_multipart_new(SOUP_FORM_MIME_TYPE_MULTIPART);
   buf = soup_buffer_new_with_owner (g_mapped_file_get_contents (mapping),
                                     g_mapped_file_get_length (mapping),
                                     mapping, (GDestroyNotify)g_mapped_file_unref);
 
+  /* Every part is added as a file by an IPFS node, only the relay wants
+   * the form fields */
+  if (!local_node)
+    {
+      soup_multipart_append_form_string (mp, "name", "keyphrase");
+      soup_multipart_append_form_string (mp, "name", "user");
+    }
+
+  file_name = g_path_get_basename (image_path);
+  soup_multipart_append_form_file (mp, "file", file_name, NULL, buf);
+
+  /* A node adds the screenshot and its thumbnails in a directory, so the
+   * embedded previews do not download the full size image */
+  if (local_node)
+    {
+      thumbnail = create_thumbnail (image_path, IPFS_THUMBNAIL_SIZE);
+      small_thumbnail = create_thumbnail (image_path, IPFS_SMALL_THUMBNAIL_SIZE);
+    }
+
+  if (thumbnail != NULL && small_thumbnail != NULL)
+    {
+      gchar *thumbnail_name = get_thumbnail_name (file_name, IPFS_THUMBNAIL_SIZE);
+      gchar *small_thumbnail_name = get_thumbnail_name (file_name, IPFS_SMALL_THUMBNAIL_SIZE);
 
-  soup_multipart_append_form_string (mp, "name", "keyphrase");
-  soup_multipart_append_form_string (mp, "name", "user");
-  soup_multipart_append_form_file (mp, "file", image_path, NULL, buf);
+      soup_multipart_append_form_file (mp, "file", thumbnail_name,
+                                       "image/png", thumbnail);
+      soup_multipart_append_form_file (mp, "file", small_thumbnail_name,
+                                       "image/png", small_thumbnail);
 
-  msg = soup_form_request_new_from_multipart (upload_url, mp);
+      g_free (thumbnail_name);
+      g_free (small_thumbnail_name);
+
+      wrapped_url = g_strconcat (upload_url, "&wrap-with-directory=true", NULL);
+      upload_url = wrapped_url;
+    }
+
+  if (thumbnail != NULL)
+    soup_buffer_free (thumbnail);
+  if (small_thumbnail != NULL)
+    soup_buffer_free (small_thumbnail);
+
+  msg = screenshooter_upload_message_new (SOUP_METHOD_POST, upload_url, mp);
+  soup_multipart_free (mp);
+
+  /* The address of the node comes from the preferences */
+  if (G_UNLIKELY (msg == NULL))
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                   _("%s is not a valid upload address."), upload_url);
+      soup_buffer_free (buf);
+      g_free (file_name);
+      g_free (wrapped_url);
+
+      return FALSE;
+    }
 
   exo_job_info_message (EXO_JOB (job), _("Upload the screenshot..."));
-  status = soup_session_send_message (session, msg);
+  status = screenshooter_upload_send_message (job, msg);
+
+  if (status == SOUP_STATUS_CANCELLED)
+    {
+      exo_job_set_error_if_cancelled (EXO_JOB (job), error);
+      soup_buffer_free (buf);
+      g_object_unref (msg);
+      g_free (file_name);
+      g_free (wrapped_url);
+
+      return FALSE;
+    }
 
   if (!SOUP_STATUS_IS_SUCCESSFUL (status))
     {
@@ -145,17 +612,44 @@ ipfs_upload_job (ScreenshooterJob *job, GArray *param_values, GError **error)
                          _("An error occurred while transferring the data"
                            " to ipfs."));
       g_propagate_error (error, tmp_error);
-      g_object_unref (session);
+      soup_buffer_free (buf);
       g_object_unref (msg);
+      g_free (file_name);
+      g_free (wrapped_url);
 
       return FALSE;
     }
-  online_file_name = get_image_url (msg->response_body->data);
-  /* returned XML is like <data type="array" success="1" status="200"><id>xxxxxx</id> */
+
+  if (wrapped_url != NULL)
+    {
+      gchar *hash = get_directory_hash (msg->response_body->data);
+
+      /* The name is the path of the screenshot in its directory */
+      if (hash != NULL)
+        {
+          gchar *escaped_name = g_uri_escape_string (file_name, NULL, FALSE);
+
+          online_file_name = g_strdup_printf ("%s/%s", hash, escaped_name);
+          g_free (escaped_name);
+          g_free (hash);
+        }
+    }
+  else
+    online_file_name = get_image_url (msg->response_body->data);
 
   soup_buffer_free (buf);
-  g_object_unref (session);
   g_object_unref (msg);
+  g_free (file_name);
+  g_free (wrapped_url);
+
+  /* Unless a recent probe found one, the link is built on the first
+   * gateway serving the screenshot; on the preferred or the first one if
+   * none does in time, the probe then goes on for the next links */
+  if (online_file_name != NULL && start_gateway_probe (online_file_name))
+    {
+      exo_job_info_message (EXO_JOB (job), _("Find a gateway serving the screenshot..."));
+      wait_for_gateway_probe ();
+    }
 
   screenshooter_job_image_uploaded (job, online_file_name);
 
@@ -168,37 +662,260 @@ ipfs_upload_job (ScreenshooterJob *job, GArray *param_values, GError **error)
 
 
 /**
- * screenshooter_upload_to_imgur:
+ * screenshooter_ipfs_get_image_url:
+ * @upload_name: the name of an uploaded image, as given by "image-uploaded".
+ *
+ * Return value: the newly allocated address of the full size image on
+ * the preferred IPFS gateway.
+ **/
+gchar *
+screenshooter_ipfs_get_image_url (const gchar *upload_name)
+{
+  gchar *gateway, *url;
+
+  g_return_val_if_fail (upload_name != NULL, NULL);
+
+  gateway = get_gateway ();
+  url = g_strdup_printf ("%s/ipfs/%s", gateway, upload_name);
+  g_free (gateway);
+
+  return url;
+}
+
+
+
+/**
+ * screenshooter_ipfs_get_upload_url:
+ * @add_url: (allow-none): the add URL of an IPFS node, see
+ *           screenshooter_ipfs_get_add_url(), or %NULL.
+ *
+ * Return value: the address the screenshots are uploaded to: @add_url,
+ * or the relay if it is %NULL.
+ **/
+const gchar *
+screenshooter_ipfs_get_upload_url (const gchar *add_url)
+{
+  if (add_url != NULL)
+    return add_url;
+
+  return screenshooter_upload_get_endpoint ("SCREENSHOOTER_IPFS_URL", IPFS_RELAY_URL);
+}
+
+
+
+/**
+ * screenshooter_ipfs_set_gateways:
+ * @list: (allow-none): the addresses of the IPFS gateways, separated by
+ *        semicolons, or %NULL for the default ones.
+ *
+ * Sets the gateways the links are built on. After an upload, they are all
+ * asked for the new file at once in the background, and the first one
+ * serving it is used for the link of that upload and of the next hour.
+ * The link waits for them a few seconds at most, it is built on the
+ * gateway already known, or the first one, if none answers in time.
+ **/
+void
+screenshooter_ipfs_set_gateways (const gchar *list)
+{
+  gchar **items;
+  GPtrArray *array;
+  guint i;
+
+  if (list == NULL || *list == '\0')
+    list = IPFS_DEFAULT_GATEWAYS;
+
+  items = g_strsplit (list, ";", -1);
+  array = g_ptr_array_new ();
+
+  for (i = 0; items[i] != NULL; i++)
+    {
+      gchar *item = g_strstrip (items[i]);
+      gsize length = strlen (item);
+
+      while (length > 0 && item[length - 1] == '/')
+        item[--length] = '\0';
+
+      if (length > 0)
+        g_ptr_array_add (array, g_strdup (item));
+    }
+
+  g_ptr_array_add (array, NULL);
+  g_strfreev (items);
+
+  G_LOCK (gateways);
+  g_strfreev (gateways);
+  gateways = (gchar **) g_ptr_array_free (array, FALSE);
+  G_UNLOCK (gateways);
+}
+
+
+
+/**
+ * screenshooter_ipfs_get_thumbnail_url:
+ * @upload_name: the name of an uploaded image, as given by "image-uploaded".
+ * @small: whether the small thumbnail is wanted rather than the large one.
+ *
+ * When the image was added to an IPFS node, @upload_name is its path in a
+ * directory which also holds its thumbnails, named after its stem and
+ * their size, e.g. screenshot-640.png. The relay only takes single files,
+ * the full size image is used as thumbnail then.
+ *
+ * Return value: the newly allocated address of a thumbnail of the image
+ * on an IPFS gateway.
+ **/
+gchar *
+screenshooter_ipfs_get_thumbnail_url (const gchar *upload_name, gboolean small)
+{
+  const gchar *slash;
+  gchar *gateway, *name, *url;
+
+  g_return_val_if_fail (upload_name != NULL, NULL);
+
+  slash = strrchr (upload_name, '/');
+
+  if (slash == NULL)
+    return screenshooter_ipfs_get_image_url (upload_name);
+
+  /* The file name is already escaped */
+  name = get_thumbnail_name (slash + 1, small ? IPFS_SMALL_THUMBNAIL_SIZE
+                                              : IPFS_THUMBNAIL_SIZE);
+
+  gateway = get_gateway ();
+  url = g_strdup_printf ("%s/ipfs/%.*s/%s", gateway,
+                         (gint) (slash - upload_name), upload_name, name);
+  g_free (gateway);
+  g_free (name);
+
+  return url;
+}
+
+
+
+
+/**
+ * screenshooter_ipfs_get_add_url:
+ * @sd: a #ScreenshotData.
+ *
+ * Builds the URL of the add command of the IPFS HTTP API set in the
+ * preferences, e.g. a kubo node on http://127.0.0.1:5001, with the pin,
+ * cid-version, raw-leaves and chunker parameters of the preferences.
+ * ipfs_api_url may be the address of the API or the full add endpoint.
+ *
+ * Return value: a newly allocated URL, or %NULL if no IPFS node is set
+ * and the relay should be used.
+ **/
+gchar *
+screenshooter_ipfs_get_add_url (const ScreenshotData *sd)
+{
+  GString *url;
+
+  g_return_val_if_fail (sd != NULL, NULL);
+
+  if (sd->ipfs_api_url == NULL || *sd->ipfs_api_url == '\0')
+    return NULL;
+
+  url = g_string_new (sd->ipfs_api_url);
+
+  while (url->len > 0 && url->str[url->len - 1] == '/')
+    g_string_truncate (url, url->len - 1);
+
+  if (!g_str_has_suffix (url->str, IPFS_ADD_PATH))
+    g_string_append (url, IPFS_ADD_PATH);
+
+  g_string_append_printf (url, "?pin=%s&cid-version=%d&raw-leaves=%s",
+                          sd->ipfs_pin ? "true" : "false",
+                          sd->ipfs_cid_version,
+                          sd->ipfs_raw_leaves ? "true" : "false");
+
+  if (sd->ipfs_chunker != NULL && *sd->ipfs_chunker != '\0')
+    {
+      g_string_append (url, "&chunker=");
+      g_string_append_uri_escaped (url, sd->ipfs_chunker, NULL, FALSE);
+    }
+
+  return g_string_free (url, FALSE);
+}
+
+
+
+
+/**
+ * screenshooter_ipfs_upload_launch:
+ * @image_path: the local path of the image to upload.
+ * @title: the title of the screenshot.
+ * @add_url: (allow-none): the add URL of an IPFS node, see
+ *           screenshooter_ipfs_get_add_url(), or %NULL to use the relay.
+ *
+ * Starts the upload of @image_path to IPFS, without any user interface.
+ * The job emits "image-uploaded" with the name of the uploaded image, or
+ * "error", then "finished".
+ *
+ * Return value: the running #ScreenshooterJob.
+ **/
+ScreenshooterJob *
+screenshooter_ipfs_upload_launch (const gchar *image_path,
+                                  const gchar *title,
+                                  const gchar *add_url)
+{
+  g_return_val_if_fail (image_path != NULL, NULL);
+
+  return screenshooter_simple_job_launch (ipfs_upload_job, 3,
+                                          G_TYPE_STRING, image_path,
+                                          G_TYPE_STRING, title,
+                                          G_TYPE_STRING, add_url);
+}
+
+
+
+/**
+ * screenshooter_upload_to_ipfs:
  * @image_path: the local path of the image that should be uploaded to
- * imgur.com.
+ * IPFS.
+ * @title: the title of the screenshot.
+ * @add_url: (allow-none): the add URL of an IPFS node, or %NULL.
+ * @copy_link: whether the link is copied to the clipboard.
  *
- * Uploads the image whose path is @image_path
+ * Uploads the image whose path is @image_path in the background. A dialog
+ * shows the progress, then the links; this returns right away.
  *
+ * Return value: the running #ScreenshooterJob, owned by the dialog.
  **/
 
-void screenshooter_upload_to_ipfs   (const gchar  *image_path,
-                                      const gchar  *title)
+ScreenshooterJob *screenshooter_upload_to_ipfs   (const gchar  *image_path,
+                                                  const gchar  *title,
+                                                  const gchar  *add_url,
+                                                  gboolean      copy_link)
 {
   ScreenshooterJob *job;
   GtkWidget *dialog, *label;
 
-  g_return_if_fail (image_path != NULL);
+  g_return_val_if_fail (image_path != NULL, NULL);
+
+  /* Released by cb_finished */
+  screenshooter_hold ();
 
   dialog = create_spinner_dialog(_("IPFS"), &label);
 
-  job = screenshooter_simple_job_launch (ipfs_upload_job, 2,
-                                          G_TYPE_STRING, image_path,
-                                          G_TYPE_STRING, title);
+  job = screenshooter_ipfs_upload_launch (image_path, title, add_url);
 
   /* dismiss the spinner dialog after success or error */
   g_signal_connect_swapped (job, "error", G_CALLBACK (gtk_widget_hide), dialog);
   g_signal_connect_swapped (job, "image-uploaded", G_CALLBACK (gtk_widget_hide), dialog);
 
   g_signal_connect (job, "ask", G_CALLBACK (cb_ask_for_information), NULL);
-  g_signal_connect (job, "image-uploaded", G_CALLBACK (cb_image_ipfs_uploaded), NULL);
-  g_signal_connect (job, "error", G_CALLBACK (cb_error), NULL);
+  g_signal_connect (job, "image-uploaded", G_CALLBACK (cb_image_ipfs_uploaded),
+                    GINT_TO_POINTER (copy_link));
+  g_signal_connect (job, "error", G_CALLBACK (cb_upload_error),
+                    GINT_TO_POINTER (UPLOAD_IPFS));
   g_signal_connect (job, "finished", G_CALLBACK (cb_finished), dialog);
   g_signal_connect (job, "info-message", G_CALLBACK (cb_update_info), label);
+  g_signal_connect (job, "percent", G_CALLBACK (cb_update_percent), dialog);
+
+  /* the cancel button aborts the transfer */
+  g_signal_connect_swapped (dialog, "response", G_CALLBACK (exo_job_cancel), job);
+
+  /* The upload goes on in the background, the dialog only reports it */
+  gtk_widget_show (dialog);
 
-  gtk_dialog_run (GTK_DIALOG (dialog));
+  return job;
 }
@@ -30,7 +30,20 @@
 #include "screenshooter-utils.h"
 #include "screenshooter-simple-job.h"
 
-void screenshooter_upload_to_ipfs (const gchar  *image_path,
-                                    const gchar  *title);
+gchar            *screenshooter_ipfs_get_add_url   (const ScreenshotData *sd);
+const gchar      *screenshooter_ipfs_get_upload_url (const gchar  *add_url);
+gchar            *screenshooter_ipfs_get_image_url (const gchar  *upload_name);
+gchar            *screenshooter_ipfs_get_thumbnail_url (const gchar  *upload_name,
+                                                        gboolean      small);
+void              screenshooter_ipfs_set_gateways  (const gchar  *list);
+
+ScreenshooterJob *screenshooter_ipfs_upload_launch (const gchar  *image_path,
+                                                    const gchar  *title,
+                                                    const gchar  *add_url);
+
+ScreenshooterJob *screenshooter_upload_to_ipfs (const gchar  *image_path,
+                                                const gchar  *title,
+                                                const gchar  *add_url,
+                                                gboolean      copy_link);
 
 #endif
@@ -18,9 +18,30 @@
  */
 
 #include "screenshooter-job-callbacks.h"
+#include "screenshooter-imgur.h"
+#include "screenshooter-ipfs.h"
+#include "screenshooter-spool.h"
+#include "screenshooter-upload.h"
+
+/* Shows the result @dialog without waiting for it to be closed, the
+ * application keeps running until it is */
+static void
+show_result_dialog (GtkWidget *dialog)
+{
+  screenshooter_hold ();
+
+  g_signal_connect_swapped (dialog, "response", G_CALLBACK (gtk_widget_destroy), dialog);
+  g_signal_connect (dialog, "destroy", G_CALLBACK (screenshooter_release), NULL);
+
+  gtk_widget_show_all (gtk_dialog_get_content_area (GTK_DIALOG (dialog)));
+  gtk_window_present (GTK_WINDOW (dialog));
+}
+
+
 
 /* Create and return a dialog with a spinner and a translated title
- * will be used during upload jobs
+ * will be used during upload jobs. It has a progress bar, updated by
+ * cb_update_percent, and a cancel button emitting GTK_RESPONSE_CANCEL.
  */
 
 GtkWidget *
@@ -29,12 +50,13 @@ create_spinner_dialog             (const gchar        *title,
 {
   GtkWidget *dialog;
   GtkWidget *status_label;
-  GtkWidget *hbox, *spinner;
+  GtkWidget *hbox, *spinner, *progress_bar;
   GtkWidget *main_box, *main_alignment;
 
   dialog = gtk_dialog_new_with_buttons (title, NULL,
                                         GTK_DIALOG_DESTROY_WITH_PARENT,
-                                        NULL, NULL);
+                                        "gtk-cancel", GTK_RESPONSE_CANCEL,
+                                        NULL);
 
   gtk_window_set_position (GTK_WINDOW (dialog), GTK_WIN_POS_CENTER);
   gtk_box_set_spacing (GTK_BOX (gtk_dialog_get_content_area (GTK_DIALOG (dialog))), 0);
@@ -79,6 +101,11 @@ create_spinner_dialog             (const gchar        *title,
   *label = gtk_label_new ("");
   gtk_container_add (GTK_CONTAINER (main_box), *label);
 
+  /* Progress of the transfer */
+  progress_bar = gtk_progress_bar_new ();
+  gtk_container_add (GTK_CONTAINER (main_box), progress_bar);
+  g_object_set_data (G_OBJECT (dialog), "progress-bar", progress_bar);
+
   gtk_widget_show_all (gtk_dialog_get_content_area (GTK_DIALOG (dialog)));
   return dialog;
 }
@@ -92,6 +119,64 @@ void cb_error (ExoJob *job, GError *error, gpointer unused)
 
 
 
+/* Queues the upload made by @job to the service of @action if it failed
+ * with @error for a reason which may go away, after its retries. The
+ * upload jobs take the path and the title of the screenshot as their
+ * first parameters, the IPFS one the add URL as its third. */
+gboolean
+spool_failed_upload (ExoJob *job, const GError *error, gint action)
+{
+  GArray *param_values;
+  const gchar *image_path, *title, *add_url = NULL;
+  GError *spool_error = NULL;
+
+  g_return_val_if_fail (error != NULL, FALSE);
+
+  if (error->domain != SOUP_HTTP_ERROR ||
+      !screenshooter_upload_is_transient_failure (error->code) ||
+      !SCREENSHOOTER_IS_SIMPLE_JOB (job))
+    return FALSE;
+
+  param_values = screenshooter_simple_job_get_param_values (SCREENSHOOTER_SIMPLE_JOB (job));
+  image_path = g_value_get_string (&g_array_index (param_values, GValue, 0));
+  title = g_value_get_string (&g_array_index (param_values, GValue, 1));
+
+  if ((action & UPLOAD_IPFS) && param_values->len > 2)
+    add_url = g_value_get_string (&g_array_index (param_values, GValue, 2));
+
+  if (!screenshooter_spool_add (image_path, title, action, add_url, &spool_error))
+    {
+      g_warning ("%s", spool_error->message);
+      g_error_free (spool_error);
+
+      return FALSE;
+    }
+
+  TRACE ("Queued %s after: %s", image_path, error->message);
+
+  return TRUE;
+}
+
+
+
+/* Error of an upload to the service of @action: it is queued if it may
+ * succeed later, reported otherwise */
+void cb_upload_error (ExoJob *job, GError *error, gpointer action)
+{
+  g_return_if_fail (error != NULL);
+
+  if (spool_failed_upload (job, error, GPOINTER_TO_INT (action)))
+    xfce_dialog_show_info (NULL,
+                           _("The links will be added to the uploaded-links"
+                             " file in the data directory."),
+                           _("The upload failed, the screenshot will be"
+                             " uploaded again in the background."));
+  else
+    screenshooter_error ("%s", error->message);
+}
+
+
+
 void cb_finished (ExoJob *job, GtkWidget *dialog)
 {
   g_return_if_fail (EXO_IS_JOB (job));
@@ -109,6 +194,12 @@ void cb_finished (ExoJob *job, GtkWidget *dialog)
                                         cb_error,
                                         NULL);
 
+  g_signal_handlers_disconnect_matched (job,
+                                        G_SIGNAL_MATCH_FUNC,
+                                        0, 0, NULL,
+                                        cb_upload_error,
+                                        NULL);
+
   g_signal_handlers_disconnect_matched (job,
                                         G_SIGNAL_MATCH_FUNC,
                                         0, 0, NULL,
@@ -121,6 +212,17 @@ void cb_finished (ExoJob *job, GtkWidget *dialog)
                                         cb_update_info,
                                         NULL);
 
+  g_signal_handlers_disconnect_matched (job,
+                                        G_SIGNAL_MATCH_FUNC,
+                                        0, 0, NULL,
+                                        cb_update_percent,
+                                        NULL);
+
+  g_signal_handlers_disconnect_matched (dialog,
+                                        G_SIGNAL_MATCH_DATA,
+                                        0, 0, NULL, NULL,
+                                        job);
+
   g_signal_handlers_disconnect_matched (job,
                                         G_SIGNAL_MATCH_FUNC,
                                         0, 0, NULL,
@@ -129,6 +231,9 @@ void cb_finished (ExoJob *job, GtkWidget *dialog)
 
   g_object_unref (G_OBJECT (job));
   gtk_widget_destroy (dialog);
+
+  /* Held by the function which launched the upload */
+  screenshooter_release ();
 }
 
 
@@ -141,6 +246,22 @@ void cb_update_info (ExoJob *job, gchar *message, GtkWidget *label)
   gtk_label_set_text (GTK_LABEL (label), message);
 }
 
+
+
+void cb_update_percent (ExoJob *job, gdouble percent, GtkWidget *dialog)
+{
+  GtkWidget *progress_bar;
+
+  g_return_if_fail (EXO_IS_JOB (job));
+  g_return_if_fail (GTK_IS_DIALOG (dialog));
+
+  progress_bar = g_object_get_data (G_OBJECT (dialog), "progress-bar");
+
+  if (progress_bar != NULL)
+    gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (progress_bar),
+                                   CLAMP (percent / 100.0, 0.0, 1.0));
+}
+
 void
 cb_ask_for_information (ScreenshooterJob *job,
                         GtkListStore     *liststore,
@@ -369,17 +490,31 @@ void cb_image_uploaded (ScreenshooterJob  *job,
   const gchar *image_url, *thumbnail_url, *small_thumbnail_url;
   const gchar *image_markup, *thumbnail_markup, *small_thumbnail_markup;
   const gchar *html_code, *bb_code;
+  const gchar *dot, *extension = "png";
   gchar *title;
   gchar *last_user_temp;
+  gchar *id;
 
   g_return_if_fail (upload_name != NULL);
 
+  /* The thumbnails are named after the id, in the format of the image */
+  dot = strrchr (upload_name, '.');
+
+  if (dot != NULL)
+    {
+      id = g_strndup (upload_name, dot - upload_name);
+      extension = dot + 1;
+    }
+  else
+    id = g_strdup (upload_name);
+
   title = _("My screenshot on Imgur");
-  image_url = g_strdup_printf ("https://i.imgur.com/%s.png", upload_name);
+  image_url = screenshooter_imgur_get_image_url (upload_name);
   thumbnail_url =
-    g_strdup_printf ("https://imgur.com/%sl.png", upload_name);
+    g_strdup_printf ("https://imgur.com/%sl.%s", id, extension);
   small_thumbnail_url =
-    g_strdup_printf ("https://imgur.com/%ss.png", upload_name);
+    g_strdup_printf ("https://imgur.com/%ss.%s", id, extension);
+  g_free (id);
 
   image_markup =
     g_markup_printf_escaped (_("<a href=\"%s\">Full size image</a>"), image_url);
@@ -541,10 +676,8 @@ void cb_image_uploaded (ScreenshooterJob  *job,
                                GTK_WRAP_CHAR);
   gtk_container_add (GTK_CONTAINER (bb_frame), bb_code_view);
 
-  /* Show the dialog and run it */
-  gtk_widget_show_all (gtk_dialog_get_content_area (GTK_DIALOG (dialog)));
-  gtk_dialog_run (GTK_DIALOG (dialog));
-  gtk_widget_destroy (dialog);
+  /* Show the dialog, it is closed independently of the other screenshots */
+  show_result_dialog (dialog);
 
   g_object_unref (html_buffer);
   g_object_unref (bb_buffer);
@@ -553,7 +686,7 @@ void cb_image_uploaded (ScreenshooterJob  *job,
 
 void cb_image_ipfs_uploaded (ScreenshooterJob  *job,
                         gchar             *upload_name,
-                        gchar            **last_user)
+                        gpointer           copy_link)
 {
   GtkWidget *dialog;
   GtkWidget *main_alignment, *vbox;
@@ -576,11 +709,14 @@ void cb_image_ipfs_uploaded (ScreenshooterJob  *job,
   g_return_if_fail (upload_name != NULL);
 
   title = _("My screenshot on IPFS");
-  image_url = g_strdup_printf ("https://ipfs.io/ipfs/%s", upload_name);
-  thumbnail_url =
-    g_strdup_printf ("https://ipfs.io/ipfs/%s", upload_name);
-  small_thumbnail_url =
-    g_strdup_printf ("https://ipfs.io/ipfs/%s", upload_name);
+  image_url = screenshooter_ipfs_get_image_url (upload_name);
+  thumbnail_url = screenshooter_ipfs_get_thumbnail_url (upload_name, FALSE);
+  small_thumbnail_url = screenshooter_ipfs_get_thumbnail_url (upload_name, TRUE);
+
+  /* The link is on the gateway found serving the file, ready to paste,
+   * unless the clipboard holds the screenshot itself */
+  if (GPOINTER_TO_INT (copy_link))
+    gtk_clipboard_set_text (gtk_clipboard_get (GDK_SELECTION_CLIPBOARD), image_url, -1);
 
   image_markup =
     g_markup_printf_escaped (_("<a href=\"%s\">Full size image</a>"), image_url);
@@ -742,12 +878,93 @@ void cb_image_ipfs_uploaded (ScreenshooterJob  *job,
                                GTK_WRAP_CHAR);
   gtk_container_add (GTK_CONTAINER (bb_frame), bb_code_view);
 
-  /* Show the dialog and run it */
-  gtk_widget_show_all (gtk_dialog_get_content_area (GTK_DIALOG (dialog)));
-  gtk_dialog_run (GTK_DIALOG (dialog));
-  gtk_widget_destroy (dialog);
+  /* Show the dialog, it is closed independently of the other screenshots */
+  show_result_dialog (dialog);
 
   g_object_unref (html_buffer);
   g_object_unref (bb_buffer);
 }
 
+
+
+/* Show the links of a screenshot uploaded to several services, or why the
+ * upload failed for each service where it did */
+void
+show_upload_results_dialog (const UploadResult *results, guint n_results)
+{
+  GtkWidget *dialog;
+  GtkWidget *main_alignment, *vbox;
+  guint i;
+
+  g_return_if_fail (results != NULL);
+
+  dialog =
+    xfce_titled_dialog_new_with_buttons (_("My screenshot online"),
+                                         NULL,
+                                         GTK_DIALOG_DESTROY_WITH_PARENT,
+                                         "gtk-close",
+                                         GTK_RESPONSE_CLOSE,
+                                         NULL);
+
+  gtk_window_set_position (GTK_WINDOW (dialog), GTK_WIN_POS_CENTER);
+  gtk_container_set_border_width (GTK_CONTAINER (gtk_dialog_get_content_area (GTK_DIALOG (dialog))), 0);
+  gtk_box_set_spacing (GTK_BOX (gtk_dialog_get_content_area (GTK_DIALOG (dialog))), 12);
+  gtk_window_set_icon_name (GTK_WINDOW (dialog), "applications-internet");
+
+  /* Create the main alignment for the dialog */
+  main_alignment = gtk_box_new (GTK_ORIENTATION_VERTICAL, 1);
+  gtk_widget_set_hexpand (main_alignment, TRUE);
+  gtk_widget_set_vexpand (main_alignment, TRUE);
+  gtk_widget_set_margin_top (main_alignment, 6);
+  gtk_widget_set_margin_bottom (main_alignment, 0);
+  gtk_widget_set_margin_start (main_alignment, 10);
+  gtk_widget_set_margin_end (main_alignment, 10);
+  gtk_box_pack_start (GTK_BOX (gtk_dialog_get_content_area (GTK_DIALOG (dialog))), main_alignment, TRUE, TRUE, 0);
+
+  /* Create the main box for the dialog */
+  vbox = gtk_box_new (GTK_ORIENTATION_VERTICAL, 10);
+  gtk_container_set_border_width (GTK_CONTAINER (vbox), 12);
+  gtk_container_add (GTK_CONTAINER (main_alignment), vbox);
+
+  for (i = 0; i < n_results; i++)
+    {
+      GtkWidget *service_label, *result_label;
+      gchar *markup;
+
+      /* Service bold label */
+      service_label = gtk_label_new ("");
+      markup =
+        g_markup_printf_escaped ("<span weight=\"bold\" stretch=\"semiexpanded\">"
+                                 "%s</span>", results[i].service);
+      gtk_label_set_markup (GTK_LABEL (service_label), markup);
+      gtk_widget_set_halign (service_label, GTK_ALIGN_START);
+      gtk_container_add (GTK_CONTAINER (vbox), service_label);
+      g_free (markup);
+
+      /* Link to the image, or the error */
+      result_label = gtk_label_new (NULL);
+
+      if (results[i].url != NULL)
+        {
+          markup =
+            g_markup_printf_escaped (_("<a href=\"%s\">Full size image</a>"),
+                                     results[i].url);
+          gtk_label_set_markup (GTK_LABEL (result_label), markup);
+          gtk_widget_set_tooltip_text (result_label, results[i].url);
+          g_free (markup);
+        }
+      else
+        {
+          gtk_label_set_text (GTK_LABEL (result_label),
+                              results[i].error != NULL ?
+                              results[i].error : _("The upload was cancelled."));
+          gtk_label_set_line_wrap (GTK_LABEL (result_label), TRUE);
+        }
+
+      gtk_widget_set_halign (result_label, GTK_ALIGN_START);
+      gtk_widget_set_margin_start (result_label, 12);
+      gtk_container_add (GTK_CONTAINER (vbox), result_label);
+    }
+
+  show_result_dialog (dialog);
+}
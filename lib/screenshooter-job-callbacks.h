@@ -33,6 +33,14 @@ typedef enum
   COMMENT,
 } AskInformation;
 
+/* Outcome of one upload of a screenshot sent to several services */
+typedef struct
+{
+  const gchar *service;
+  gchar       *url;
+  gchar       *error;
+} UploadResult;
+
 
 GtkWidget *
 create_spinner_dialog              (const gchar        *title,
@@ -42,6 +50,14 @@ void
 cb_error                           (ExoJob            *job,
                                     GError            *error,
                                     gpointer           unused);
+gboolean
+spool_failed_upload                (ExoJob            *job,
+                                    const GError      *error,
+                                    gint               action);
+void
+cb_upload_error                    (ExoJob            *job,
+                                    GError            *error,
+                                    gpointer           action);
 void
 cb_finished                        (ExoJob            *job,
                                     GtkWidget         *dialog);
@@ -50,6 +66,10 @@ cb_update_info                     (ExoJob            *job,
                                     gchar             *message,
                                     GtkWidget         *label);
 void
+cb_update_percent                  (ExoJob            *job,
+                                    gdouble            percent,
+                                    GtkWidget         *dialog);
+void
 cb_image_uploaded                  (ScreenshooterJob  *job,
                                     gchar             *upload_name,
                                     gchar            **last_user);
@@ -57,7 +77,10 @@ cb_image_uploaded                  (ScreenshooterJob  *job,
 void
 cb_image_ipfs_uploaded                  (ScreenshooterJob  *job,
                                     gchar             *upload_name,
-                                    gchar            **last_user);
+                                    gpointer           copy_link);
+void
+show_upload_results_dialog         (const UploadResult *results,
+                                    guint               n_results);
 void
 cb_ask_for_information             (ScreenshooterJob  *job,
                                     GtkListStore      *liststore,
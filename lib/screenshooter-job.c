@@ -23,6 +23,13 @@
 
 #define SCREENSHOOTER_JOB_GET_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE ((obj), SCREENSHOOTER_TYPE_JOB, ScreenshooterJobPrivate))
 
+/* Interval at which the jobs waiting for a slot check their cancellation */
+#define SCHEDULER_POLL_INTERVAL (G_USEC_PER_SEC / 10)
+
+/* Uploads running at the same time unless set otherwise, they wait for
+ * the network rather than the processors */
+#define SCHEDULER_UPLOAD_SLOTS  4
+
 
 
 /* Signal identifiers */
@@ -47,6 +54,32 @@ static void  screenshooter_job_finalize   (GObject               *object);
 static ExoJobClass *screenshooter_job_parent_class;
 static guint        job_signals[LAST_SIGNAL];
 
+/* Pools of slots: the encodes take one of the processor slots, one per
+ * core, the uploads one of the upload slots */
+enum
+{
+  SCHEDULER_POOL_CPU,
+  SCHEDULER_POOL_UPLOAD,
+  SCHEDULER_N_POOLS,
+};
+
+/* The jobs run their function in at most scheduler_slots at a time per
+ * pool, and wait for a slot in order of priority then of arrival */
+static GMutex  scheduler_lock;
+static GCond   scheduler_cond;
+static guint   scheduler_slots[SCHEDULER_N_POOLS] = { 0, SCHEDULER_UPLOAD_SLOTS };
+static guint   scheduler_running[SCHEDULER_N_POOLS] = { 0, 0 };
+static GList  *scheduler_waiting = NULL;
+
+/* Jobs of a cancellation group which are not done yet, with a reference */
+static GList  *scheduler_grouped = NULL;
+
+/* Scheduling statistics of the process, reported by --stats */
+static guint   stats_jobs = 0;
+static guint   stats_max_depth = 0;
+static gint64  stats_wait = 0;
+static gint64  stats_max_wait = 0;
+
 
 
 GType
@@ -131,7 +164,10 @@ screenshooter_job_class_init (ScreenshooterJobClass *klass)
 static void
 screenshooter_job_init (ScreenshooterJob *job)
 {
-
+  job->priority = SCREENSHOOTER_JOB_PRIORITY_UPLOAD;
+  job->group = NULL;
+  job->done = FALSE;
+  job->pool = SCHEDULER_POOL_UPLOAD;
 }
 
 
@@ -139,11 +175,81 @@ screenshooter_job_init (ScreenshooterJob *job)
 static void
 screenshooter_job_finalize (GObject *object)
 {
+  g_free (SCREENSHOOTER_JOB (object)->group);
+
   (*G_OBJECT_CLASS (screenshooter_job_parent_class)->finalize) (object);
 }
 
 
 
+/* Sizes the CPU pool to the cores on first use, called with the
+ * scheduler lock held */
+static void
+init_cpu_slots (void)
+{
+  if (G_UNLIKELY (scheduler_slots[SCHEDULER_POOL_CPU] == 0))
+    scheduler_slots[SCHEDULER_POOL_CPU] = MAX (1, g_get_num_processors ());
+}
+
+
+
+/* Returns the pool of slots the jobs of @priority run in */
+static guint
+get_pool (ScreenshooterJobPriority priority)
+{
+  if (priority == SCREENSHOOTER_JOB_PRIORITY_INTERACTIVE ||
+      priority == SCREENSHOOTER_JOB_PRIORITY_RECOMPRESS)
+    return SCHEDULER_POOL_CPU;
+
+  return SCHEDULER_POOL_UPLOAD;
+}
+
+
+
+/* Whether @job is the first waiting job of the highest priority of its
+ * pool, called with the scheduler lock held */
+static gboolean
+is_next_job (ScreenshooterJob *job)
+{
+  ScreenshooterJob *next = NULL;
+  GList *l;
+
+  for (l = scheduler_waiting; l != NULL; l = l->next)
+    {
+      ScreenshooterJob *waiting = l->data;
+
+      if (get_pool (waiting->priority) != get_pool (job->priority))
+        continue;
+
+      if (next == NULL || waiting->priority < next->priority)
+        next = waiting;
+    }
+
+  return next == job;
+}
+
+
+
+/* Marks @job as done and drops it from its group, called with the
+ * scheduler lock held */
+static void
+unschedule_job (ScreenshooterJob *job)
+{
+  GList *link;
+
+  job->done = TRUE;
+
+  link = g_list_find (scheduler_grouped, job);
+
+  if (link != NULL)
+    {
+      scheduler_grouped = g_list_delete_link (scheduler_grouped, link);
+      g_object_unref (job);
+    }
+}
+
+
+
 /*static void
 screenshooter_job_real_ask (ScreenshooterJob *job,
                             GtkListStore     *liststore,
@@ -195,3 +301,246 @@ screenshooter_job_image_uploaded (ScreenshooterJob *job, const gchar *file_name)
   TRACE ("Emit image-uploaded signal.");
   exo_job_emit (EXO_JOB (job), job_signals[IMAGE_UPLOADED], 0, file_name);
 }
+
+
+
+/**
+ * screenshooter_job_set_priority:
+ * @job: a #ScreenshooterJob.
+ * @priority: the class of @job.
+ *
+ * Sets the class of @job, which decides the pool of slots @job runs in
+ * and which of the jobs waiting for a slot of that pool runs first. It
+ * can be set right after launching @job between classes of the same
+ * pool: it is only looked at while @job waits. Jobs are in the upload
+ * class by default, see screenshooter_simple_job_launch_with_priority()
+ * for the others.
+ **/
+void
+screenshooter_job_set_priority (ScreenshooterJob         *job,
+                                ScreenshooterJobPriority  priority)
+{
+  g_return_if_fail (SCREENSHOOTER_IS_JOB (job));
+
+  g_mutex_lock (&scheduler_lock);
+  job->priority = priority;
+  g_cond_broadcast (&scheduler_cond);
+  g_mutex_unlock (&scheduler_lock);
+}
+
+
+
+/**
+ * screenshooter_job_set_group:
+ * @job: a #ScreenshooterJob.
+ * @group: the name of a cancellation group.
+ *
+ * Adds @job to @group, so that it is cancelled along with the other jobs
+ * of @group by screenshooter_job_cancel_group() until it is done.
+ **/
+void
+screenshooter_job_set_group (ScreenshooterJob *job, const gchar *group)
+{
+  g_return_if_fail (SCREENSHOOTER_IS_JOB (job));
+  g_return_if_fail (group != NULL);
+
+  g_mutex_lock (&scheduler_lock);
+
+  g_free (job->group);
+  job->group = g_strdup (group);
+
+  if (!job->done && g_list_find (scheduler_grouped, job) == NULL)
+    scheduler_grouped = g_list_prepend (scheduler_grouped, g_object_ref (job));
+
+  g_mutex_unlock (&scheduler_lock);
+}
+
+
+
+/**
+ * screenshooter_job_cancel_group:
+ * @group: the name of a cancellation group.
+ *
+ * Cancels the jobs of @group which are waiting for a slot or running.
+ *
+ * Return value: the number of cancelled jobs.
+ **/
+guint
+screenshooter_job_cancel_group (const gchar *group)
+{
+  GList *jobs = NULL, *l;
+  guint n_cancelled;
+
+  g_return_val_if_fail (group != NULL, 0);
+
+  g_mutex_lock (&scheduler_lock);
+
+  for (l = scheduler_grouped; l != NULL; l = l->next)
+    if (g_strcmp0 (SCREENSHOOTER_JOB (l->data)->group, group) == 0)
+      jobs = g_list_prepend (jobs, g_object_ref (l->data));
+
+  g_mutex_unlock (&scheduler_lock);
+
+  n_cancelled = g_list_length (jobs);
+
+  TRACE ("Cancel %u jobs of %s", n_cancelled, group);
+
+  for (l = jobs; l != NULL; l = l->next)
+    exo_job_cancel (EXO_JOB (l->data));
+
+  g_list_free_full (jobs, g_object_unref);
+
+  return n_cancelled;
+}
+
+
+
+/**
+ * screenshooter_job_acquire_slot:
+ * @job: a #ScreenshooterJob.
+ *
+ * Waits, in the thread running @job, until one of the slots of its pool
+ * is free and no job of a higher class or launched earlier in the same
+ * class waits for one. The encodes share one slot per core, the uploads
+ * the number of slots set with screenshooter_job_set_upload_slots(), so
+ * that bursts of uploads and encodes do not all run at once, and the
+ * uploads waiting for the network do not hold back the encodes.
+ *
+ * Return value: %TRUE if @job got a slot, to be given back with
+ * screenshooter_job_release_slot(); %FALSE if it was cancelled first.
+ **/
+gboolean
+screenshooter_job_acquire_slot (ScreenshooterJob *job)
+{
+  gint64 start, wait;
+  guint depth;
+
+  g_return_val_if_fail (SCREENSHOOTER_IS_JOB (job), FALSE);
+
+  start = g_get_monotonic_time ();
+
+  g_mutex_lock (&scheduler_lock);
+
+  init_cpu_slots ();
+
+  scheduler_waiting = g_list_append (scheduler_waiting, job);
+
+  depth = g_list_length (scheduler_waiting);
+  stats_max_depth = MAX (stats_max_depth, depth);
+
+  while (!exo_job_is_cancelled (EXO_JOB (job)) &&
+         (scheduler_running[get_pool (job->priority)] >=
+            scheduler_slots[get_pool (job->priority)] ||
+          !is_next_job (job)))
+    {
+      /* Wake up regularly to notice the cancellation */
+      g_cond_wait_until (&scheduler_cond, &scheduler_lock,
+                         g_get_monotonic_time () + SCHEDULER_POLL_INTERVAL);
+    }
+
+  scheduler_waiting = g_list_remove (scheduler_waiting, job);
+
+  if (exo_job_is_cancelled (EXO_JOB (job)))
+    {
+      unschedule_job (job);
+
+      /* The next job may be allowed to run now */
+      g_cond_broadcast (&scheduler_cond);
+      g_mutex_unlock (&scheduler_lock);
+
+      return FALSE;
+    }
+
+  job->pool = get_pool (job->priority);
+  scheduler_running[job->pool]++;
+
+  /* The job behind it in line may take a slot left, without waiting for
+   * the next poll */
+  g_cond_broadcast (&scheduler_cond);
+
+  wait = g_get_monotonic_time () - start;
+  stats_jobs++;
+  stats_wait += wait;
+  stats_max_wait = MAX (stats_max_wait, wait);
+
+  g_mutex_unlock (&scheduler_lock);
+
+  TRACE ("Job got a slot after %.3f s, %u jobs were waiting",
+         (gdouble) wait / G_USEC_PER_SEC, depth);
+
+  return TRUE;
+}
+
+
+
+/**
+ * screenshooter_job_release_slot:
+ * @job: a #ScreenshooterJob.
+ *
+ * Gives back the slot taken by screenshooter_job_acquire_slot() when @job
+ * is done, and drops @job from its cancellation group.
+ **/
+void
+screenshooter_job_release_slot (ScreenshooterJob *job)
+{
+  g_return_if_fail (SCREENSHOOTER_IS_JOB (job));
+
+  g_mutex_lock (&scheduler_lock);
+
+  g_warn_if_fail (scheduler_running[job->pool] > 0);
+  scheduler_running[job->pool]--;
+
+  unschedule_job (job);
+
+  g_cond_broadcast (&scheduler_cond);
+  g_mutex_unlock (&scheduler_lock);
+}
+
+
+
+/**
+ * screenshooter_job_set_upload_slots:
+ * @n_slots: the number of uploads running at the same time.
+ *
+ * Sets the number of upload slots, SCHEDULER_UPLOAD_SLOTS by default.
+ * The uploads beyond it wait, whatever the number of cores.
+ **/
+void
+screenshooter_job_set_upload_slots (guint n_slots)
+{
+  g_mutex_lock (&scheduler_lock);
+  scheduler_slots[SCHEDULER_POOL_UPLOAD] = MAX (n_slots, 1);
+  g_cond_broadcast (&scheduler_cond);
+  g_mutex_unlock (&scheduler_lock);
+}
+
+
+
+/**
+ * screenshooter_job_get_stats:
+ *
+ * Summarizes the scheduling of the jobs done by the process so far.
+ *
+ * Return value: a newly allocated string, free it with g_free().
+ **/
+gchar *
+screenshooter_job_get_stats (void)
+{
+  gchar *result;
+
+  g_mutex_lock (&scheduler_lock);
+
+  init_cpu_slots ();
+
+  result = g_strdup_printf (_("Jobs: %u (%u encode slots, %u upload slots,"
+                              " queue depth up to %u)\n"
+                              "Job wait: %.3f s mean, %.3f s max\n"),
+                            stats_jobs, scheduler_slots[SCHEDULER_POOL_CPU],
+                            scheduler_slots[SCHEDULER_POOL_UPLOAD], stats_max_depth,
+                            stats_jobs > 0 ? (gdouble) stats_wait / stats_jobs / G_USEC_PER_SEC : 0.0,
+                            (gdouble) stats_max_wait / G_USEC_PER_SEC);
+
+  g_mutex_unlock (&scheduler_lock);
+
+  return result;
+}
@@ -36,6 +36,17 @@ G_BEGIN_DECLS
 typedef struct _ScreenshooterJobClass   ScreenshooterJobClass;
 typedef struct _ScreenshooterJob        ScreenshooterJob;
 
+/* Classes of jobs. The encodes run in the processor slots, the uploads
+ * in the upload slots; in each of them, the first classes get the free
+ * slots first */
+typedef enum
+{
+  SCREENSHOOTER_JOB_PRIORITY_INTERACTIVE,
+  SCREENSHOOTER_JOB_PRIORITY_UPLOAD,
+  SCREENSHOOTER_JOB_PRIORITY_BACKGROUND,
+  SCREENSHOOTER_JOB_PRIORITY_RECOMPRESS,
+} ScreenshooterJobPriority;
+
 #define SCREENSHOOTER_TYPE_JOB            (screenshooter_job_get_type ())
 #define SCREENSHOOTER_JOB(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), SCREENSHOOTER_TYPE_JOB, ScreenshooterJob))
 #define SCREENSHOOTER_JOB_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), SCREENSHOOTER_TYPE_JOB, ScreenshooterJobClass))
@@ -58,6 +69,11 @@ struct _ScreenshooterJob
 {
   /*< private >*/
   ExoJob __parent__;
+
+  ScreenshooterJobPriority  priority;
+  gchar                    *group;
+  gboolean                  done;
+  guint                     pool;
 };
 
 GType screenshooter_job_get_type       (void) G_GNUC_CONST;
@@ -71,6 +87,19 @@ void  screenshooter_job_ask_info       (ScreenshooterJob *job,
 void  screenshooter_job_image_uploaded (ScreenshooterJob *job,
                                         const gchar      *file_name);
 
+void  screenshooter_job_set_priority   (ScreenshooterJob         *job,
+                                        ScreenshooterJobPriority  priority);
+void  screenshooter_job_set_group      (ScreenshooterJob         *job,
+                                        const gchar              *group);
+guint screenshooter_job_cancel_group   (const gchar              *group);
+
+gboolean screenshooter_job_acquire_slot (ScreenshooterJob *job);
+void     screenshooter_job_release_slot (ScreenshooterJob *job);
+
+void     screenshooter_job_set_upload_slots (guint n_slots);
+
+gchar *screenshooter_job_get_stats     (void);
+
 G_END_DECLS
 
 #endif /* !__SCREENSHOOTER_JOB_H__ */
@@ -0,0 +1,741 @@
+/*  $Id$
+ *
+ *  Copyright © 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ * */
+
+#include "screenshooter-pipeline.h"
+#include "screenshooter-encode.h"
+#include "screenshooter-redact.h"
+#include "screenshooter-simple-job.h"
+#include "screenshooter-trim.h"
+
+#include <libxfce4util/libxfce4util.h>
+
+/* Interval at which a throttled capture delivers the frames done */
+#define PIPELINE_THROTTLE_INTERVAL (G_USEC_PER_SEC / 20)
+
+
+
+/* Bounded queue between two stages */
+typedef struct
+{
+  GMutex                       lock;
+  GCond                        cond;
+  GQueue                       frames;
+  guint                        depth;
+  ScreenshooterOverflowPolicy  policy;
+  gboolean                     closed;
+  guint                        n_dropped;
+} FrameQueue;
+
+typedef struct
+{
+  ScreenshooterFrameSink sink;
+  gpointer               user_data;
+} PipelineSink;
+
+struct _ScreenshooterPipeline
+{
+  ScreenshooterTransform       transforms;
+  gchar                       *directory;
+  gchar                       *title;
+  gboolean                     timestamp;
+  gsize                        max_upload_bytes;
+  ScreenshooterOverflowPolicy  policy;
+
+  /* Capture (the caller, in the main loop) -> transform -> encode ->
+   * delivery (the sinks, in the main loop) */
+  FrameQueue                   transform_queue;
+  FrameQueue                   encode_queue;
+  FrameQueue                   deliver_queue;
+  GThread                     *transform_thread;
+  GThread                     *encode_thread;
+
+  /* Frames handed back by the encode jobs to the encode stage */
+  GAsyncQueue                 *encoded;
+
+  GSList                      *sinks;
+  guint                        sequence;
+
+  /* Delivery source, protected by the lock of deliver_queue */
+  guint                        deliver_id;
+
+  /* Only used from the main loop */
+  gboolean                     delivering;
+  gboolean                     redeliver;
+  GSourceFunc                  drained;
+  gpointer                     drained_data;
+};
+
+
+
+/* Internals */
+
+
+
+static void
+frame_free (ScreenshooterFrame *frame)
+{
+  g_object_unref (frame->screenshot);
+  g_free (frame->path);
+  g_free (frame->upload_path);
+
+  if (frame->error != NULL)
+    g_error_free (frame->error);
+
+  g_free (frame);
+}
+
+
+
+static void
+frame_queue_init (FrameQueue                  *queue,
+                  guint                        depth,
+                  ScreenshooterOverflowPolicy  policy)
+{
+  g_mutex_init (&queue->lock);
+  g_cond_init (&queue->cond);
+  g_queue_init (&queue->frames);
+  queue->depth = MAX (depth, 1);
+  queue->policy = policy;
+  queue->closed = FALSE;
+  queue->n_dropped = 0;
+}
+
+
+
+static void
+frame_queue_clear (FrameQueue *queue)
+{
+  g_queue_foreach (&queue->frames, (GFunc) frame_free, NULL);
+  g_queue_clear (&queue->frames);
+  g_cond_clear (&queue->cond);
+  g_mutex_clear (&queue->lock);
+}
+
+
+
+/* Adds @frame to @queue, applying the overflow policy if it is full.
+ * Returns FALSE if @frame was dropped. */
+static gboolean
+frame_queue_push (FrameQueue *queue, ScreenshooterFrame *frame)
+{
+  ScreenshooterFrame *dropped = NULL;
+
+  g_mutex_lock (&queue->lock);
+
+  while (queue->policy == SCREENSHOOTER_OVERFLOW_BLOCK &&
+         g_queue_get_length (&queue->frames) >= queue->depth)
+    g_cond_wait (&queue->cond, &queue->lock);
+
+  if (g_queue_get_length (&queue->frames) >= queue->depth)
+    {
+      if (queue->policy == SCREENSHOOTER_OVERFLOW_DROP_OLDEST)
+        {
+          dropped = g_queue_pop_head (&queue->frames);
+          g_queue_push_tail (&queue->frames, frame);
+        }
+      else
+        dropped = frame;
+
+      queue->n_dropped++;
+    }
+  else
+    g_queue_push_tail (&queue->frames, frame);
+
+  g_cond_broadcast (&queue->cond);
+  g_mutex_unlock (&queue->lock);
+
+  if (dropped == NULL)
+    return TRUE;
+
+  TRACE ("Drop frame %u", dropped->sequence);
+  frame_free (dropped);
+
+  return dropped != frame;
+}
+
+
+
+/* Waits for a frame of @queue. Returns NULL once @queue is closed and
+ * empty. */
+static ScreenshooterFrame *
+frame_queue_pop (FrameQueue *queue)
+{
+  ScreenshooterFrame *frame;
+
+  g_mutex_lock (&queue->lock);
+
+  while (g_queue_is_empty (&queue->frames) && !queue->closed)
+    g_cond_wait (&queue->cond, &queue->lock);
+
+  frame = g_queue_pop_head (&queue->frames);
+
+  g_cond_broadcast (&queue->cond);
+  g_mutex_unlock (&queue->lock);
+
+  return frame;
+}
+
+
+
+static ScreenshooterFrame *
+frame_queue_try_pop (FrameQueue *queue)
+{
+  ScreenshooterFrame *frame;
+
+  g_mutex_lock (&queue->lock);
+
+  frame = g_queue_pop_head (&queue->frames);
+
+  if (frame != NULL)
+    g_cond_broadcast (&queue->cond);
+
+  g_mutex_unlock (&queue->lock);
+
+  return frame;
+}
+
+
+
+static void
+frame_queue_close (FrameQueue *queue)
+{
+  g_mutex_lock (&queue->lock);
+  queue->closed = TRUE;
+  g_cond_broadcast (&queue->cond);
+  g_mutex_unlock (&queue->lock);
+}
+
+
+
+/* Waits until there is room in @queue or until @timeout microseconds
+ * elapsed. Returns whether there is room. */
+static gboolean
+frame_queue_wait_for_room (FrameQueue *queue, gint64 timeout)
+{
+  gint64 deadline = g_get_monotonic_time () + timeout;
+  gboolean room;
+
+  g_mutex_lock (&queue->lock);
+
+  if (g_queue_get_length (&queue->frames) >= queue->depth)
+    g_cond_wait_until (&queue->cond, &queue->lock, deadline);
+
+  room = g_queue_get_length (&queue->frames) < queue->depth;
+
+  g_mutex_unlock (&queue->lock);
+
+  return room;
+}
+
+
+
+static gboolean cb_deliver (ScreenshooterPipeline *pipeline);
+
+
+
+/* Makes the main loop deliver the frames done, called from any thread */
+static void
+schedule_delivery (ScreenshooterPipeline *pipeline)
+{
+  g_mutex_lock (&pipeline->deliver_queue.lock);
+
+  if (pipeline->deliver_id == 0)
+    pipeline->deliver_id = g_idle_add ((GSourceFunc) cb_deliver, pipeline);
+
+  g_mutex_unlock (&pipeline->deliver_queue.lock);
+}
+
+
+
+/* Transform stage thread: crops the margins and blanks out the windows
+ * to redact */
+static gpointer
+transform_frames (ScreenshooterPipeline *pipeline)
+{
+  ScreenshooterFrame *frame;
+
+  while ((frame = frame_queue_pop (&pipeline->transform_queue)) != NULL)
+    {
+      if (pipeline->transforms & SCREENSHOOTER_TRANSFORM_TRIM)
+        {
+          GdkRectangle area;
+          GdkPixbuf *trimmed =
+            screenshooter_trim_uniform_border (frame->screenshot, &area);
+
+          screenshooter_redact_transfer (frame->screenshot, trimmed, -area.x, -area.y);
+          g_object_unref (frame->screenshot);
+          frame->screenshot = trimmed;
+        }
+
+      /* The pixels may be shared with the caller, e.g. with the clipboard
+       * or the preview of the dialog: a copy is redacted */
+      if (pipeline->transforms & SCREENSHOOTER_TRANSFORM_REDACT)
+        {
+          GdkPixbuf *redacted = gdk_pixbuf_copy (frame->screenshot);
+
+          screenshooter_redact_transfer (frame->screenshot, redacted, 0, 0);
+
+          if (screenshooter_redact_apply (redacted))
+            {
+              g_object_unref (frame->screenshot);
+              frame->screenshot = redacted;
+            }
+          else
+            g_object_unref (redacted);
+        }
+
+      frame_queue_push (&pipeline->encode_queue, frame);
+    }
+
+  frame_queue_close (&pipeline->encode_queue);
+
+  return NULL;
+}
+
+
+
+/* Returns a path in the directory of @pipeline which is not taken yet,
+ * named after the title and the capture time of @frame */
+static gchar *
+get_frame_path (ScreenshooterPipeline *pipeline, ScreenshooterFrame *frame)
+{
+  GDateTime *time;
+  gchar *stem, *path;
+  guint i;
+
+  time = g_date_time_new_from_unix_local (frame->capture_time / G_USEC_PER_SEC);
+
+  if (pipeline->timestamp)
+    {
+      gchar *datetime = g_date_time_format (time, "%Y-%m-%d_%H-%M-%S");
+
+      stem = g_strconcat (pipeline->title, "_", datetime, NULL);
+      g_free (datetime);
+    }
+  else
+    stem = g_strdup (pipeline->title);
+
+  g_date_time_unref (time);
+
+  path = g_strconcat (pipeline->directory, G_DIR_SEPARATOR_S, stem, ".png", NULL);
+
+  for (i = 1; g_file_test (path, G_FILE_TEST_EXISTS); i++)
+    {
+      g_free (path);
+      path = g_strdup_printf ("%s" G_DIR_SEPARATOR_S "%s-%u.png",
+                              pipeline->directory, stem, i);
+    }
+
+  g_free (stem);
+
+  return path;
+}
+
+
+
+/* Job saving a frame as PNG, in one of the processor slots */
+static gboolean
+save_frame_job (ScreenshooterJob *job, GArray *param_values, GError **error)
+{
+  ScreenshooterPipeline *pipeline = g_value_get_pointer (&g_array_index (param_values, GValue, 0));
+  ScreenshooterFrame *frame = g_value_get_pointer (&g_array_index (param_values, GValue, 1));
+
+  frame->path = get_frame_path (pipeline, frame);
+
+  TRACE ("Encode frame %u to %s", frame->sequence, frame->path);
+
+  if (!gdk_pixbuf_save (frame->screenshot, frame->path, "png", &frame->error, NULL))
+    {
+      g_free (frame->path);
+      frame->path = NULL;
+    }
+
+  /* The error is delivered with the frame */
+  g_async_queue_push (pipeline->encoded, frame);
+
+  return TRUE;
+}
+
+
+
+/* Job encoding a frame within the upload budget, after the PNG files of
+ * the other screenshots */
+static gboolean
+recompress_frame_job (ScreenshooterJob *job, GArray *param_values, GError **error)
+{
+  ScreenshooterPipeline *pipeline = g_value_get_pointer (&g_array_index (param_values, GValue, 0));
+  ScreenshooterFrame *frame = g_value_get_pointer (&g_array_index (param_values, GValue, 1));
+
+  frame->upload_path =
+    screenshooter_encode_within_budget (frame->screenshot, frame->path,
+                                        pipeline->max_upload_bytes,
+                                        &frame->error);
+
+  g_async_queue_push (pipeline->encoded, frame);
+
+  return TRUE;
+}
+
+
+
+/* Runs @func on @frame as a job of the class @priority, and waits for it */
+static void
+run_encode_job (ScreenshooterPipeline      *pipeline,
+                ScreenshooterFrame         *frame,
+                ScreenshooterJobPriority    priority,
+                ScreenshooterSimpleJobFunc  func)
+{
+  ScreenshooterJob *job;
+
+  job = screenshooter_simple_job_launch_with_priority (priority, func, 2,
+                                                       G_TYPE_POINTER, pipeline,
+                                                       G_TYPE_POINTER, frame);
+
+  g_async_queue_pop (pipeline->encoded);
+  g_object_unref (job);
+}
+
+
+
+/* Encode stage thread: saves the frames as PNG, then within the upload
+ * budget if there is one. The encoding itself runs in jobs, so that it
+ * takes turns with the other encodes of the process. */
+static gpointer
+encode_frames (ScreenshooterPipeline *pipeline)
+{
+  ScreenshooterFrame *frame;
+
+  while ((frame = frame_queue_pop (&pipeline->encode_queue)) != NULL)
+    {
+      if (pipeline->directory != NULL)
+        {
+          run_encode_job (pipeline, frame, SCREENSHOOTER_JOB_PRIORITY_INTERACTIVE,
+                          save_frame_job);
+
+          if (frame->path != NULL && pipeline->max_upload_bytes > 0)
+            run_encode_job (pipeline, frame, SCREENSHOOTER_JOB_PRIORITY_RECOMPRESS,
+                            recompress_frame_job);
+        }
+
+      /* Never drops, see screenshooter_pipeline_new () */
+      frame_queue_push (&pipeline->deliver_queue, frame);
+      schedule_delivery (pipeline);
+    }
+
+  frame_queue_close (&pipeline->deliver_queue);
+  schedule_delivery (pipeline);
+
+  return NULL;
+}
+
+
+
+/* Delivery stage: hands the frames done to the sinks, in the main loop.
+ * Returns TRUE once the last frame was delivered. */
+static gboolean
+deliver_frames (ScreenshooterPipeline *pipeline)
+{
+  ScreenshooterFrame *frame;
+  gboolean drained;
+
+  /* A sink running a dialog also runs the main loop */
+  if (pipeline->delivering)
+    {
+      pipeline->redeliver = TRUE;
+      return FALSE;
+    }
+
+  pipeline->delivering = TRUE;
+
+  while ((frame = frame_queue_try_pop (&pipeline->deliver_queue)) != NULL)
+    {
+      GSList *l;
+
+      for (l = pipeline->sinks; l != NULL; l = l->next)
+        {
+          PipelineSink *sink = l->data;
+
+          (*sink->sink) (frame, sink->user_data);
+        }
+
+      frame_free (frame);
+    }
+
+  pipeline->delivering = FALSE;
+
+  if (pipeline->redeliver)
+    {
+      pipeline->redeliver = FALSE;
+      schedule_delivery (pipeline);
+    }
+
+  g_mutex_lock (&pipeline->deliver_queue.lock);
+  drained = pipeline->deliver_queue.closed && g_queue_is_empty (&pipeline->deliver_queue.frames);
+  g_mutex_unlock (&pipeline->deliver_queue.lock);
+
+  return drained;
+}
+
+
+
+static void
+pipeline_free (ScreenshooterPipeline *pipeline)
+{
+  guint n_dropped;
+
+  g_mutex_lock (&pipeline->deliver_queue.lock);
+
+  if (pipeline->deliver_id != 0)
+    g_source_remove (pipeline->deliver_id);
+  pipeline->deliver_id = 0;
+
+  g_mutex_unlock (&pipeline->deliver_queue.lock);
+
+  g_thread_join (pipeline->transform_thread);
+  g_thread_join (pipeline->encode_thread);
+
+  n_dropped = pipeline->transform_queue.n_dropped +
+              pipeline->encode_queue.n_dropped;
+
+  if (n_dropped > 0)
+    g_warning ("%u of the %u screenshots were dropped because the encoding "
+               "or the delivery could not keep up", n_dropped, pipeline->sequence);
+
+  frame_queue_clear (&pipeline->transform_queue);
+  frame_queue_clear (&pipeline->encode_queue);
+  frame_queue_clear (&pipeline->deliver_queue);
+  g_async_queue_unref (pipeline->encoded);
+
+  g_slist_free_full (pipeline->sinks, g_free);
+  g_free (pipeline->directory);
+  g_free (pipeline->title);
+  g_free (pipeline);
+}
+
+
+
+static gboolean
+cb_deliver (ScreenshooterPipeline *pipeline)
+{
+  g_mutex_lock (&pipeline->deliver_queue.lock);
+  pipeline->deliver_id = 0;
+  g_mutex_unlock (&pipeline->deliver_queue.lock);
+
+  if (deliver_frames (pipeline))
+    {
+      GSourceFunc drained = pipeline->drained;
+      gpointer drained_data = pipeline->drained_data;
+
+      TRACE ("Pipeline drained");
+
+      pipeline_free (pipeline);
+
+      if (drained != NULL)
+        (*drained) (drained_data);
+    }
+
+  return FALSE;
+}
+
+
+
+/* Public */
+
+
+
+/**
+ * screenshooter_pipeline_parse_policy:
+ * @name: "drop-oldest", "drop-newest" or "block".
+ *
+ * Return value: the overflow policy named @name, dropping the oldest
+ * frames if @name is not known.
+ **/
+ScreenshooterOverflowPolicy
+screenshooter_pipeline_parse_policy (const gchar *name)
+{
+  if (g_strcmp0 (name, "drop-newest") == 0)
+    return SCREENSHOOTER_OVERFLOW_DROP_NEWEST;
+  else if (g_strcmp0 (name, "block") == 0)
+    return SCREENSHOOTER_OVERFLOW_BLOCK;
+
+  return SCREENSHOOTER_OVERFLOW_DROP_OLDEST;
+}
+
+
+
+/**
+ * screenshooter_pipeline_new:
+ * @transforms: the transformations applied to the screenshots.
+ * @directory: the local directory the screenshots are encoded to, or
+ * %NULL to deliver them without encoding them.
+ * @title: the name of the encoded files, followed by the capture time if
+ * @timestamp is %TRUE.
+ * @timestamp: whether the capture time is part of the file names.
+ * @max_upload_bytes: if not 0, the screenshots are also encoded within
+ * this size for the uploads, see screenshooter_encode_within_budget().
+ * @depth: the number of screenshots each stage may hold.
+ * @policy: what happens to a screenshot when the next stage is full.
+ *
+ * Creates a pipeline for the screenshots taken by the caller. Each of the
+ * transform and encode stages runs in its own thread, so that a capture
+ * never waits for the encoding of the previous ones; the sinks get the
+ * screenshots in the main loop, in the order in which they were taken.
+ * The encodes run as jobs of the interactive class, the encodes within
+ * the upload budget as jobs of the recompress class.
+ *
+ * The stages are connected by queues of @depth screenshots, which bound
+ * the memory used. When a queue is full, the oldest or the newest
+ * screenshot is dropped, or the capture is throttled with
+ * %SCREENSHOOTER_OVERFLOW_BLOCK. Only the screenshots not encoded yet
+ * are dropped, the encode stage waits for the delivery instead.
+ *
+ * Return value: the pipeline, which frees itself once it is drained after
+ * screenshooter_pipeline_finish().
+ **/
+ScreenshooterPipeline *
+screenshooter_pipeline_new (ScreenshooterTransform       transforms,
+                            const gchar                 *directory,
+                            const gchar                 *title,
+                            gboolean                     timestamp,
+                            gsize                        max_upload_bytes,
+                            guint                        depth,
+                            ScreenshooterOverflowPolicy  policy)
+{
+  ScreenshooterPipeline *pipeline;
+
+  g_return_val_if_fail (directory == NULL || title != NULL, NULL);
+
+  pipeline = g_new0 (ScreenshooterPipeline, 1);
+  pipeline->transforms = transforms;
+  pipeline->directory = g_strdup (directory);
+  pipeline->title = g_strdup (title);
+  pipeline->timestamp = timestamp;
+  pipeline->max_upload_bytes = max_upload_bytes;
+  pipeline->policy = policy;
+
+  frame_queue_init (&pipeline->transform_queue, depth, policy);
+  frame_queue_init (&pipeline->encode_queue, depth, policy);
+  /* An encoded frame already has its files on disk, so it is held back
+   * rather than dropped: the encode queue then fills up and applies the
+   * policy to frames not encoded yet */
+  frame_queue_init (&pipeline->deliver_queue, depth, SCREENSHOOTER_OVERFLOW_BLOCK);
+  pipeline->encoded = g_async_queue_new ();
+
+  pipeline->transform_thread = g_thread_new ("pipeline-transform",
+                                             (GThreadFunc) transform_frames,
+                                             pipeline);
+  pipeline->encode_thread = g_thread_new ("pipeline-encode",
+                                          (GThreadFunc) encode_frames,
+                                          pipeline);
+
+  return pipeline;
+}
+
+
+
+/**
+ * screenshooter_pipeline_add_sink:
+ * @pipeline: a #ScreenshooterPipeline.
+ * @sink: the function delivering a screenshot.
+ * @user_data: the data passed to @sink.
+ *
+ * Adds @sink to the delivery stage of @pipeline. The sinks are called in
+ * the order in which they were added, in the main loop. The path of the
+ * frame is %NULL if it could not be encoded, its error is then set.
+ **/
+void
+screenshooter_pipeline_add_sink (ScreenshooterPipeline  *pipeline,
+                                 ScreenshooterFrameSink  sink,
+                                 gpointer                user_data)
+{
+  PipelineSink *entry;
+
+  g_return_if_fail (pipeline != NULL);
+  g_return_if_fail (sink != NULL);
+
+  entry = g_new (PipelineSink, 1);
+  entry->sink = sink;
+  entry->user_data = user_data;
+
+  pipeline->sinks = g_slist_append (pipeline->sinks, entry);
+}
+
+
+
+/**
+ * screenshooter_pipeline_push:
+ * @pipeline: a #ScreenshooterPipeline.
+ * @screenshot: the screenshot just taken.
+ *
+ * Hands @screenshot over to the transform stage of @pipeline, from the
+ * main loop. With %SCREENSHOOTER_OVERFLOW_BLOCK, this waits until the
+ * transform stage has room, delivering the frames done meanwhile. The
+ * pixels of @screenshot are never modified.
+ *
+ * Return value: %FALSE if @screenshot was dropped.
+ **/
+gboolean
+screenshooter_pipeline_push (ScreenshooterPipeline *pipeline,
+                             GdkPixbuf             *screenshot)
+{
+  ScreenshooterFrame *frame;
+
+  g_return_val_if_fail (pipeline != NULL, FALSE);
+  g_return_val_if_fail (GDK_IS_PIXBUF (screenshot), FALSE);
+  g_return_val_if_fail (!pipeline->transform_queue.closed, FALSE);
+
+  frame = g_new0 (ScreenshooterFrame, 1);
+  frame->screenshot = g_object_ref (screenshot);
+  frame->sequence = ++pipeline->sequence;
+  frame->capture_time = g_get_real_time ();
+
+  /* The later stages may wait for the delivery, which runs in the main
+   * loop this is called from */
+  if (pipeline->policy == SCREENSHOOTER_OVERFLOW_BLOCK)
+    while (!frame_queue_wait_for_room (&pipeline->transform_queue,
+                                       PIPELINE_THROTTLE_INTERVAL))
+      deliver_frames (pipeline);
+
+  return frame_queue_push (&pipeline->transform_queue, frame);
+}
+
+
+
+/**
+ * screenshooter_pipeline_finish:
+ * @pipeline: a #ScreenshooterPipeline.
+ * @drained: the function called once the last screenshot is delivered.
+ * @user_data: the data passed to @drained.
+ *
+ * Tells @pipeline that no more screenshots will be pushed. @pipeline is
+ * freed once the screenshots pushed so far are delivered, right before
+ * @drained is called in the main loop.
+ **/
+void
+screenshooter_pipeline_finish (ScreenshooterPipeline *pipeline,
+                               GSourceFunc            drained,
+                               gpointer               user_data)
+{
+  g_return_if_fail (pipeline != NULL);
+
+  pipeline->drained = drained;
+  pipeline->drained_data = user_data;
+
+  frame_queue_close (&pipeline->transform_queue);
+}
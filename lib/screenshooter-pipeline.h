@@ -0,0 +1,79 @@
+/*  $Id$
+ *
+ *  Copyright © 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ * */
+
+#ifndef __HAVE_PIPELINE_H__
+#define __HAVE_PIPELINE_H__
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+/* What happens to a frame when the next stage is full */
+typedef enum
+{
+  SCREENSHOOTER_OVERFLOW_DROP_OLDEST,
+  SCREENSHOOTER_OVERFLOW_DROP_NEWEST,
+  SCREENSHOOTER_OVERFLOW_BLOCK,
+} ScreenshooterOverflowPolicy;
+
+/* Transformations of the transform stage */
+typedef enum
+{
+  SCREENSHOOTER_TRANSFORM_NONE   = 0,
+  SCREENSHOOTER_TRANSFORM_TRIM   = 1 << 0,
+  SCREENSHOOTER_TRANSFORM_REDACT = 1 << 1,
+} ScreenshooterTransform;
+
+/* A screenshot going through the pipeline */
+typedef struct
+{
+  GdkPixbuf *screenshot;
+  guint      sequence;
+  gint64     capture_time;
+  gchar     *path;
+  gchar     *upload_path;
+  GError    *error;
+} ScreenshooterFrame;
+
+typedef void (*ScreenshooterFrameSink) (ScreenshooterFrame *frame,
+                                        gpointer            user_data);
+
+typedef struct _ScreenshooterPipeline ScreenshooterPipeline;
+
+ScreenshooterOverflowPolicy  screenshooter_pipeline_parse_policy (const gchar                 *name);
+
+ScreenshooterPipeline       *screenshooter_pipeline_new          (ScreenshooterTransform       transforms,
+                                                                  const gchar                 *directory,
+                                                                  const gchar                 *title,
+                                                                  gboolean                     timestamp,
+                                                                  gsize                        max_upload_bytes,
+                                                                  guint                        depth,
+                                                                  ScreenshooterOverflowPolicy  policy);
+void                         screenshooter_pipeline_add_sink     (ScreenshooterPipeline       *pipeline,
+                                                                  ScreenshooterFrameSink       sink,
+                                                                  gpointer                     user_data);
+gboolean                     screenshooter_pipeline_push         (ScreenshooterPipeline       *pipeline,
+                                                                  GdkPixbuf                   *screenshot);
+void                         screenshooter_pipeline_finish       (ScreenshooterPipeline       *pipeline,
+                                                                  GSourceFunc                  drained,
+                                                                  gpointer                     user_data);
+
+#endif
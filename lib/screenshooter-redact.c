@@ -0,0 +1,433 @@
+/*  $Id$
+ *
+ *  Copyright © 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ * */
+
+#include "screenshooter-redact.h"
+
+#include <string.h>
+#include <gdk/gdkx.h>
+#include <X11/Xatom.h>
+#include <X11/Xutil.h>
+#include <libxfce4util/libxfce4util.h>
+
+/* Side of the pixelation blocks, in pixels */
+#define REDACT_BLOCK_SIZE 16
+
+/* Key of the region to redact, stored on the screenshot pixbuf */
+#define REDACT_REGION_KEY "screenshooter-redact-region"
+
+/* Rule file, one WM_CLASS glob pattern per line */
+#define REDACT_RULES_FILE "xfce4/xfce4-screenshooter-redact"
+
+
+
+/* Internals */
+
+
+
+/* Reads the redaction rules. Returns NULL if there is no rule file or if it
+ * does not contain any pattern. */
+static GPtrArray *
+read_rules (void)
+{
+  GPtrArray *rules = NULL;
+  gchar *file, *contents = NULL;
+  gchar **lines;
+  gint i;
+
+  file = xfce_resource_lookup (XFCE_RESOURCE_CONFIG, REDACT_RULES_FILE);
+
+  if (G_LIKELY (file == NULL))
+    return NULL;
+
+  if (!g_file_get_contents (file, &contents, NULL, NULL))
+    {
+      g_free (file);
+      return NULL;
+    }
+
+  lines = g_strsplit (contents, "\n", -1);
+
+  for (i = 0; lines[i] != NULL; i++)
+    {
+      gchar *pattern = g_strstrip (lines[i]);
+      gchar *lower;
+
+      /* Skip empty lines and comments */
+      if (*pattern == '\0' || *pattern == '#')
+        continue;
+
+      if (rules == NULL)
+        rules = g_ptr_array_new_with_free_func ((GDestroyNotify) g_pattern_spec_free);
+
+      lower = g_ascii_strdown (pattern, -1);
+      g_ptr_array_add (rules, g_pattern_spec_new (lower));
+      g_free (lower);
+    }
+
+  TRACE ("Read %d redaction rules from %s", rules ? rules->len : 0, file);
+
+  g_strfreev (lines);
+  g_free (contents);
+  g_free (file);
+
+  return rules;
+}
+
+
+
+/* Whether the instance or the class name of @xid matches one of @rules */
+static gboolean
+window_matches (Display *display, Window xid, GPtrArray *rules)
+{
+  XClassHint hint = { NULL, NULL };
+  gchar *name, *klass;
+  gboolean result = FALSE;
+  guint i;
+
+  if (!XGetClassHint (display, xid, &hint))
+    return FALSE;
+
+  name = g_ascii_strdown (hint.res_name ? hint.res_name : "", -1);
+  klass = g_ascii_strdown (hint.res_class ? hint.res_class : "", -1);
+
+  for (i = 0; i < rules->len && !result; i++)
+    {
+      GPatternSpec *spec = g_ptr_array_index (rules, i);
+
+      result = g_pattern_match_string (spec, name) ||
+               g_pattern_match_string (spec, klass);
+    }
+
+  if (result)
+    TRACE ("Window %lx (%s, %s) will be redacted", xid, name, klass);
+
+  g_free (name);
+  g_free (klass);
+
+  if (hint.res_name)
+    XFree (hint.res_name);
+  if (hint.res_class)
+    XFree (hint.res_class);
+
+  return result;
+}
+
+
+
+/* Gets the rectangle of the viewable client @xid in root coordinates,
+ * including its decorations since titles can be as sensitive as contents. */
+static gboolean
+get_frame_rectangle (Display *display, Window root, Window xid,
+                     cairo_rectangle_int_t *rect)
+{
+  XWindowAttributes attributes;
+  Window child;
+  Atom type;
+  int x, y, format;
+  unsigned long n_items, bytes_after;
+  guchar *data = NULL;
+
+  if (!XGetWindowAttributes (display, xid, &attributes) ||
+      attributes.map_state != IsViewable)
+    return FALSE;
+
+  if (!XTranslateCoordinates (display, xid, root, 0, 0, &x, &y, &child))
+    return FALSE;
+
+  rect->x = x;
+  rect->y = y;
+  rect->width = attributes.width;
+  rect->height = attributes.height;
+
+  /* _NET_FRAME_EXTENTS is left, right, top, bottom */
+  if (XGetWindowProperty (display, xid,
+                          XInternAtom (display, "_NET_FRAME_EXTENTS", False),
+                          0, 4, False, XA_CARDINAL, &type, &format,
+                          &n_items, &bytes_after, &data) == Success &&
+      data != NULL && type == XA_CARDINAL && n_items == 4)
+    {
+      long *extents = (long *) data;
+
+      rect->x -= extents[0];
+      rect->y -= extents[2];
+      rect->width += extents[0] + extents[1];
+      rect->height += extents[2] + extents[3];
+    }
+
+  if (data != NULL)
+    XFree (data);
+
+  return TRUE;
+}
+
+
+
+/* Replaces every REDACT_BLOCK_SIZE square of @rect by its average color.
+ *
+ * The image is processed one band of blocks at a time: the columns of the
+ * band are first summed into a row of accumulators, which is a straight
+ * loop over contiguous bytes the compiler vectorizes, then each block is
+ * reduced from those sums. The averaged row is written once and copied on
+ * every row of the band, so each pixel is read once and written once. */
+static void
+pixelate_rectangle (guchar                      *pixels,
+                    gint                         rowstride,
+                    gint                         n_channels,
+                    const cairo_rectangle_int_t *rect)
+{
+  gsize row_len = (gsize) rect->width * n_channels;
+  guint32 *sums = g_new (guint32, row_len);
+  guchar *averages = g_malloc (row_len);
+  gint band;
+
+  for (band = rect->y; band < rect->y + rect->height; band += REDACT_BLOCK_SIZE)
+    {
+      gint rows = MIN (REDACT_BLOCK_SIZE, rect->y + rect->height - band);
+      gint x, y;
+      gsize i;
+
+      memset (sums, 0, row_len * sizeof (guint32));
+
+      for (y = band; y < band + rows; y++)
+        {
+          const guchar *src = pixels + (gsize) y * rowstride
+                                     + (gsize) rect->x * n_channels;
+
+          for (i = 0; i < row_len; i++)
+            sums[i] += src[i];
+        }
+
+      for (x = 0; x < rect->width; x += REDACT_BLOCK_SIZE)
+        {
+          gint cols = MIN (REDACT_BLOCK_SIZE, rect->width - x);
+          guint32 count = (guint32) rows * cols;
+          guint32 total[4] = { 0, 0, 0, 0 };
+          guchar *block = averages + (gsize) x * n_channels;
+          gint c, k;
+
+          for (k = 0; k < cols; k++)
+            for (c = 0; c < n_channels; c++)
+              total[c] += sums[(gsize) (x + k) * n_channels + c];
+
+          for (c = 0; c < n_channels; c++)
+            block[c] = (total[c] + count / 2) / count;
+
+          for (k = 1; k < cols; k++)
+            memcpy (block + (gsize) k * n_channels, block, n_channels);
+        }
+
+      for (y = band; y < band + rows; y++)
+        memcpy (pixels + (gsize) y * rowstride + (gsize) rect->x * n_channels,
+                averages, row_len);
+    }
+
+  g_free (averages);
+  g_free (sums);
+}
+
+
+
+/* Public */
+
+
+
+/**
+ * screenshooter_redact_collect:
+ * @screenshot: a freshly captured #GdkPixbuf.
+ * @x_orig: the root x coordinate of the top left corner of @screenshot.
+ * @y_orig: the root y coordinate of the top left corner of @screenshot.
+ *
+ * Walks the window stacking list and records on @screenshot the visible
+ * parts of the windows whose WM_CLASS matches one of the patterns of the
+ * redaction rule file. Nothing is done if there is no rule file.
+ *
+ * This has to be called at capture time, while the windows are still
+ * where they were when the screenshot was taken. The pixels themselves
+ * are only touched by screenshooter_redact_apply().
+ **/
+void
+screenshooter_redact_collect (GdkPixbuf *screenshot, gint x_orig, gint y_orig)
+{
+  GdkDisplay *gdk_display;
+  GPtrArray *rules;
+  Display *display;
+  Window root;
+  Window *stack;
+  Atom type;
+  int format;
+  unsigned long n_items, bytes_after, i;
+  guchar *data = NULL;
+  cairo_region_t *region;
+  cairo_rectangle_int_t bounds;
+
+  g_return_if_fail (GDK_IS_PIXBUF (screenshot));
+
+  rules = read_rules ();
+
+  if (G_LIKELY (rules == NULL))
+    return;
+
+  TRACE ("Look for windows to redact");
+
+  gdk_display = gdk_display_get_default ();
+  display = GDK_DISPLAY_XDISPLAY (gdk_display);
+  root = gdk_x11_get_default_root_xwindow ();
+
+  /* Windows may vanish while we look at them */
+  gdk_x11_display_error_trap_push (gdk_display);
+
+  if (XGetWindowProperty (display, root,
+                          XInternAtom (display, "_NET_CLIENT_LIST_STACKING", False),
+                          0, G_MAXLONG, False, XA_WINDOW, &type, &format,
+                          &n_items, &bytes_after, &data) != Success ||
+      data == NULL || type != XA_WINDOW)
+    {
+      g_warning ("Could not read the window stacking list, nothing will be redacted");
+
+      if (data != NULL)
+        XFree (data);
+
+      gdk_x11_display_error_trap_pop_ignored (gdk_display);
+      g_ptr_array_unref (rules);
+      return;
+    }
+
+  stack = (Window *) data;
+  region = cairo_region_create ();
+
+  /* The list goes from bottom to top: a window hides the part of the
+   * windows below it, so only what was really visible gets redacted */
+  for (i = 0; i < n_items; i++)
+    {
+      cairo_rectangle_int_t rect;
+
+      if (!get_frame_rectangle (display, root, stack[i], &rect))
+        continue;
+
+      if (window_matches (display, stack[i], rules))
+        cairo_region_union_rectangle (region, &rect);
+      else
+        cairo_region_subtract_rectangle (region, &rect);
+    }
+
+  XFree (data);
+  gdk_x11_display_error_trap_pop_ignored (gdk_display);
+  g_ptr_array_unref (rules);
+
+  /* Move the region to the screenshot coordinates */
+  bounds.x = bounds.y = 0;
+  bounds.width = gdk_pixbuf_get_width (screenshot);
+  bounds.height = gdk_pixbuf_get_height (screenshot);
+
+  cairo_region_translate (region, -x_orig, -y_orig);
+  cairo_region_intersect_rectangle (region, &bounds);
+
+  if (cairo_region_is_empty (region))
+    {
+      cairo_region_destroy (region);
+      return;
+    }
+
+  g_object_set_data_full (G_OBJECT (screenshot), REDACT_REGION_KEY, region,
+                          (GDestroyNotify) cairo_region_destroy);
+}
+
+
+
+/**
+ * screenshooter_redact_transfer:
+ * @from: a #GdkPixbuf on which screenshooter_redact_collect() was called.
+ * @to: a #GdkPixbuf derived from @from, e.g. a sub-pixbuf.
+ * @dx: the horizontal offset from @from to @to coordinates.
+ * @dy: the vertical offset from @from to @to coordinates.
+ *
+ * Carries the region to redact over to @to, when @from was cropped.
+ **/
+void
+screenshooter_redact_transfer (GdkPixbuf *from, GdkPixbuf *to, gint dx, gint dy)
+{
+  cairo_region_t *region;
+  cairo_rectangle_int_t bounds;
+
+  g_return_if_fail (GDK_IS_PIXBUF (from));
+  g_return_if_fail (GDK_IS_PIXBUF (to));
+
+  region = g_object_get_data (G_OBJECT (from), REDACT_REGION_KEY);
+
+  if (region == NULL || from == to)
+    return;
+
+  bounds.x = bounds.y = 0;
+  bounds.width = gdk_pixbuf_get_width (to);
+  bounds.height = gdk_pixbuf_get_height (to);
+
+  region = cairo_region_copy (region);
+  cairo_region_translate (region, dx, dy);
+  cairo_region_intersect_rectangle (region, &bounds);
+
+  g_object_set_data_full (G_OBJECT (to), REDACT_REGION_KEY, region,
+                          (GDestroyNotify) cairo_region_destroy);
+}
+
+
+
+/**
+ * screenshooter_redact_apply:
+ * @screenshot: a #GdkPixbuf.
+ *
+ * Pixelates in place the region recorded by screenshooter_redact_collect().
+ * It must be called before the screenshot is encoded for any destination
+ * outside of this machine.
+ *
+ * Return value: %TRUE if something was redacted.
+ **/
+gboolean
+screenshooter_redact_apply (GdkPixbuf *screenshot)
+{
+  cairo_region_t *region;
+  guchar *pixels;
+  gint rowstride, n_channels, n_rects, i;
+
+  g_return_val_if_fail (GDK_IS_PIXBUF (screenshot), FALSE);
+
+  region = g_object_get_data (G_OBJECT (screenshot), REDACT_REGION_KEY);
+
+  if (region == NULL)
+    return FALSE;
+
+  TRACE ("Redact the screenshot");
+
+  pixels = gdk_pixbuf_get_pixels (screenshot);
+  rowstride = gdk_pixbuf_get_rowstride (screenshot);
+  n_channels = gdk_pixbuf_get_n_channels (screenshot);
+  n_rects = cairo_region_num_rectangles (region);
+
+  for (i = 0; i < n_rects; i++)
+    {
+      cairo_rectangle_int_t rect;
+
+      cairo_region_get_rectangle (region, i, &rect);
+      pixelate_rectangle (pixels, rowstride, n_channels, &rect);
+    }
+
+  /* Never pixelate twice */
+  g_object_set_data (G_OBJECT (screenshot), REDACT_REGION_KEY, NULL);
+
+  return TRUE;
+}
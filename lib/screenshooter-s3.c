@@ -0,0 +1,809 @@
+/*  $Id$
+ *
+ *  Copyright © 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ * */
+
+#include "screenshooter-s3.h"
+#include "screenshooter-upload.h"
+
+#include <string.h>
+
+#include <gio/gio.h>
+#include <libsoup/soup.h>
+#include <libxml/parser.h>
+#include <libxfce4util/libxfce4util.h>
+
+/* Bounds of the part size, in bytes: S3 refuses parts below 5 MiB but the
+ * last one, and uploads of more than 10000 parts */
+#define S3_MIN_PART_SIZE     (5 * 1024 * 1024)
+#define S3_DEFAULT_PART_SIZE (8 * 1024 * 1024)
+#define S3_MAX_PARTS         10000
+
+/* Bounds of the number of parts sent at the same time, the shared session
+ * has UPLOAD_MAX_CONNS_PER_HOST connections to the endpoint */
+#define S3_MIN_JOBS          1
+#define S3_MAX_JOBS          8
+
+#define S3_DEFAULT_REGION    "us-east-1"
+
+/* The body is not hashed, the transfer is protected by TLS */
+#define S3_UNSIGNED_PAYLOAD  "UNSIGNED-PAYLOAD"
+#define S3_SIGNED_HEADERS    "host;x-amz-content-sha256;x-amz-date"
+
+
+
+/* Storage set in the preferences */
+typedef struct
+{
+  gchar *endpoint;
+  gchar *bucket;
+  gchar *region;
+  gchar *access_key;
+  gchar *secret_key;
+  gchar *prefix;
+  gchar *public_url;
+  gsize  part_size;
+  guint  n_jobs;
+} S3Config;
+
+/* A multipart upload, shared by the threads sending its parts */
+typedef struct
+{
+  ScreenshooterJob *job;
+  const S3Config   *config;
+  const gchar      *key;
+  const gchar      *upload_id;
+  SoupBuffer       *buffer;
+  UploadGroup       group;
+  gint              failed_status;
+} S3Upload;
+
+/* One part of a multipart upload */
+typedef struct
+{
+  guint   number;
+  goffset offset;
+  gsize   length;
+  gchar  *etag;
+} S3Part;
+
+
+
+G_LOCK_DEFINE_STATIC (config);
+static S3Config *config = NULL;
+
+
+
+/* Internals */
+
+
+
+static void
+s3_config_free (S3Config *s3_config)
+{
+  if (s3_config == NULL)
+    return;
+
+  g_free (s3_config->endpoint);
+  g_free (s3_config->bucket);
+  g_free (s3_config->region);
+  g_free (s3_config->access_key);
+  g_free (s3_config->secret_key);
+  g_free (s3_config->prefix);
+  g_free (s3_config->public_url);
+  g_free (s3_config);
+}
+
+
+
+/* Returns a copy of the configuration, %NULL if the storage is not set */
+static S3Config *
+get_config (void)
+{
+  S3Config *copy = NULL;
+
+  G_LOCK (config);
+
+  if (config != NULL)
+    {
+      copy = g_new0 (S3Config, 1);
+      copy->endpoint = g_strdup (config->endpoint);
+      copy->bucket = g_strdup (config->bucket);
+      copy->region = g_strdup (config->region);
+      copy->access_key = g_strdup (config->access_key);
+      copy->secret_key = g_strdup (config->secret_key);
+      copy->prefix = g_strdup (config->prefix);
+      copy->public_url = g_strdup (config->public_url);
+      copy->part_size = config->part_size;
+      copy->n_jobs = config->n_jobs;
+    }
+
+  G_UNLOCK (config);
+
+  return copy;
+}
+
+
+
+/* Returns the preference @value, or the environment @variable if it is
+ * empty */
+static gchar *
+dup_setting (const gchar *value, const gchar *variable)
+{
+  if ((value == NULL || *value == '\0') && variable != NULL)
+    value = g_getenv (variable);
+
+  if (value == NULL || *value == '\0')
+    return NULL;
+
+  return g_strdup (value);
+}
+
+
+
+/* Removes the trailing slashes of @url in place */
+static gchar *
+strip_slashes (gchar *url)
+{
+  gsize length;
+
+  if (url == NULL)
+    return NULL;
+
+  length = strlen (url);
+
+  while (length > 0 && url[length - 1] == '/')
+    url[--length] = '\0';
+
+  return url;
+}
+
+
+
+static void
+hmac_sha256 (const guchar *key, gsize key_length, const gchar *data, guint8 digest[32])
+{
+  GHmac *hmac = g_hmac_new (G_CHECKSUM_SHA256, key, key_length);
+  gsize length = 32;
+
+  g_hmac_update (hmac, (const guchar *) data, -1);
+  g_hmac_get_digest (hmac, digest, &length);
+  g_hmac_unref (hmac);
+}
+
+
+
+/* Adds the AWS Signature Version 4 headers to @msg */
+static void
+sign_request (SoupMessage *msg, const S3Config *s3_config)
+{
+  SoupURI *uri = soup_message_get_uri (msg);
+  GDateTime *now = g_date_time_new_now_utc ();
+  gchar *amz_date, *date, *host, *scope, *secret;
+  gchar *canonical_request, *canonical_hash, *string_to_sign;
+  gchar *signature, *authorization;
+  guint8 key[32];
+
+  amz_date = g_date_time_format (now, "%Y%m%dT%H%M%SZ");
+  date = g_date_time_format (now, "%Y%m%d");
+  g_date_time_unref (now);
+
+  if (soup_uri_uses_default_port (uri))
+    host = g_strdup (uri->host);
+  else
+    host = g_strdup_printf ("%s:%u", uri->host, uri->port);
+
+  canonical_request =
+    g_strdup_printf ("%s\n%s\n%s\nhost:%s\nx-amz-content-sha256:%s\nx-amz-date:%s\n\n%s\n%s",
+                     msg->method, uri->path, uri->query != NULL ? uri->query : "",
+                     host, S3_UNSIGNED_PAYLOAD, amz_date,
+                     S3_SIGNED_HEADERS, S3_UNSIGNED_PAYLOAD);
+  canonical_hash = g_compute_checksum_for_string (G_CHECKSUM_SHA256, canonical_request, -1);
+
+  scope = g_strdup_printf ("%s/%s/s3/aws4_request", date, s3_config->region);
+  string_to_sign = g_strdup_printf ("AWS4-HMAC-SHA256\n%s\n%s\n%s",
+                                    amz_date, scope, canonical_hash);
+
+  /* The signing key is derived from the secret for the day, the region
+   * and the service */
+  secret = g_strconcat ("AWS4", s3_config->secret_key, NULL);
+  hmac_sha256 ((const guchar *) secret, strlen (secret), date, key);
+  hmac_sha256 (key, sizeof (key), s3_config->region, key);
+  hmac_sha256 (key, sizeof (key), "s3", key);
+  hmac_sha256 (key, sizeof (key), "aws4_request", key);
+
+  signature = g_compute_hmac_for_string (G_CHECKSUM_SHA256, key, sizeof (key),
+                                         string_to_sign, -1);
+  authorization =
+    g_strdup_printf ("AWS4-HMAC-SHA256 Credential=%s/%s, SignedHeaders=%s, Signature=%s",
+                     s3_config->access_key, scope, S3_SIGNED_HEADERS, signature);
+
+  soup_message_headers_replace (msg->request_headers, "x-amz-date", amz_date);
+  soup_message_headers_replace (msg->request_headers, "x-amz-content-sha256",
+                                S3_UNSIGNED_PAYLOAD);
+  soup_message_headers_replace (msg->request_headers, "Authorization", authorization);
+
+  memset (secret, 0, strlen (secret));
+  memset (key, 0, sizeof (key));
+
+  g_free (amz_date);
+  g_free (date);
+  g_free (host);
+  g_free (scope);
+  g_free (secret);
+  g_free (canonical_request);
+  g_free (canonical_hash);
+  g_free (string_to_sign);
+  g_free (signature);
+  g_free (authorization);
+}
+
+
+
+/* Returns a signed request for the object @key, @query must be in the
+ * canonical order and escaped */
+static SoupMessage *
+new_request (const S3Config *s3_config,
+             const gchar    *method,
+             const gchar    *key,
+             const gchar    *query)
+{
+  SoupMessage *msg;
+  gchar *escaped_key, *url;
+
+  escaped_key = g_uri_escape_string (key, "/", FALSE);
+  url = g_strdup_printf ("%s/%s/%s%s%s", s3_config->endpoint, s3_config->bucket,
+                         escaped_key, query != NULL ? "?" : "",
+                         query != NULL ? query : "");
+
+  msg = soup_message_new (method, url);
+
+  if (msg != NULL)
+    sign_request (msg, s3_config);
+
+  g_free (escaped_key);
+  g_free (url);
+
+  return msg;
+}
+
+
+
+/* Returns the contents of the @name element below the root of the XML
+ * response of @msg, %NULL if there is none or S3 answered an error */
+static gchar *
+get_response_element (SoupMessage *msg, const gchar *name)
+{
+  xmlDoc *doc;
+  xmlNode *root_node, *child_node;
+  gchar *value = NULL;
+
+  if (msg->response_body->length == 0)
+    return NULL;
+
+  doc = xmlParseMemory (msg->response_body->data, msg->response_body->length);
+
+  if (doc == NULL)
+    return NULL;
+
+  root_node = xmlDocGetRootElement (doc);
+
+  if (root_node != NULL && !xmlStrEqual (root_node->name, (const xmlChar *) "Error"))
+    for (child_node = root_node->children;
+         child_node != NULL && value == NULL;
+         child_node = child_node->next)
+      if (xmlStrEqual (child_node->name, (const xmlChar *) name))
+        {
+          xmlChar *content = xmlNodeGetContent (child_node);
+
+          value = g_strdup ((const gchar *) content);
+          xmlFree (content);
+        }
+
+  xmlFreeDoc (doc);
+
+  return value;
+}
+
+
+
+static void
+set_transfer_error (GError **error, guint status)
+{
+  g_set_error (error, SOUP_HTTP_ERROR, status,
+               _("An error occurred while transferring the data"
+                 " to the S3 storage."));
+}
+
+
+
+/* new_request() could not parse the address of the object */
+static void
+set_address_error (GError **error)
+{
+  g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+               _("The S3 endpoint and bucket do not make a valid address."));
+}
+
+
+
+/* Thread pool function: sends one part of @upload */
+static void
+upload_part (S3Part *part, S3Upload *upload)
+{
+  SoupBuffer *body;
+  SoupMessage *msg;
+  gchar *query, *upload_id;
+  guint status;
+
+  /* Give up on the remaining parts once one has failed */
+  if (g_atomic_int_get (&upload->failed_status) != 0 ||
+      exo_job_is_cancelled (EXO_JOB (upload->job)))
+    return;
+
+  upload_id = g_uri_escape_string (upload->upload_id, NULL, FALSE);
+  query = g_strdup_printf ("partNumber=%u&uploadId=%s", part->number, upload_id);
+  msg = new_request (upload->config, SOUP_METHOD_PUT, upload->key, query);
+  g_free (upload_id);
+  g_free (query);
+
+  if (G_UNLIKELY (msg == NULL))
+    {
+      g_atomic_int_compare_and_exchange (&upload->failed_status, 0, SOUP_STATUS_MALFORMED);
+      return;
+    }
+
+  /* The part is a sub-buffer of the mapped file, nothing is copied */
+  body = soup_buffer_new_subbuffer (upload->buffer, part->offset, part->length);
+  screenshooter_upload_message_set_body (msg, body);
+  soup_buffer_free (body);
+
+  status = screenshooter_upload_send_part (upload->job, msg, &upload->group);
+
+  if (SOUP_STATUS_IS_SUCCESSFUL (status))
+    part->etag = g_strdup (soup_message_headers_get_one (msg->response_headers, "ETag"));
+
+  if (part->etag == NULL)
+    {
+      TRACE ("Part %u failed with status %u", part->number, status);
+      g_atomic_int_compare_and_exchange (&upload->failed_status, 0,
+                                         SOUP_STATUS_IS_SUCCESSFUL (status) ?
+                                         SOUP_STATUS_MALFORMED : (gint) status);
+    }
+
+  g_object_unref (msg);
+}
+
+
+
+/* Sends @buffer as the object @key in parts, in parallel */
+static gboolean
+upload_multipart (ScreenshooterJob *job,
+                  const S3Config   *s3_config,
+                  const gchar      *key,
+                  const gchar      *content_type,
+                  SoupBuffer       *buffer,
+                  GError          **error)
+{
+  S3Upload upload;
+  S3Part *parts;
+  GThreadPool *pool;
+  GString *completion;
+  SoupMessage *msg;
+  gchar *upload_id, *escaped_id, *query, *etag;
+  gsize part_size = s3_config->part_size;
+  guint status, n_parts, i;
+
+  /* Start the upload */
+  msg = new_request (s3_config, SOUP_METHOD_POST, key, "uploads=");
+
+  if (G_UNLIKELY (msg == NULL))
+    {
+      set_address_error (error);
+      return FALSE;
+    }
+
+  soup_message_headers_replace (msg->request_headers, "Content-Type", content_type);
+  status = screenshooter_upload_send_message (job, msg);
+  upload_id = get_response_element (msg, "UploadId");
+  g_object_unref (msg);
+
+  if (upload_id == NULL)
+    {
+      TRACE ("Could not start the multipart upload: %u", status);
+
+      if (!exo_job_set_error_if_cancelled (EXO_JOB (job), error))
+        set_transfer_error (error, status);
+
+      return FALSE;
+    }
+
+  /* Grow the parts if there would be too many */
+  if (buffer->length / part_size >= S3_MAX_PARTS)
+    part_size = buffer->length / S3_MAX_PARTS + 1;
+
+  n_parts = (buffer->length + part_size - 1) / part_size;
+  parts = g_new0 (S3Part, n_parts);
+
+  upload.job = job;
+  upload.config = s3_config;
+  upload.key = key;
+  upload.upload_id = upload_id;
+  upload.buffer = buffer;
+  upload.failed_status = 0;
+  g_mutex_init (&upload.group.lock);
+  upload.group.total = buffer->length;
+  upload.group.sent = 0;
+  upload.group.start_time = g_get_monotonic_time ();
+
+  TRACE ("Send %u parts of %" G_GSIZE_FORMAT " bytes with %u threads",
+         n_parts, part_size, s3_config->n_jobs);
+
+  pool = g_thread_pool_new ((GFunc) upload_part, &upload, s3_config->n_jobs, FALSE, NULL);
+
+  for (i = 0; i < n_parts; i++)
+    {
+      parts[i].number = i + 1;
+      parts[i].offset = (goffset) i * part_size;
+      parts[i].length = MIN (part_size, buffer->length - parts[i].offset);
+
+      g_thread_pool_push (pool, &parts[i], NULL);
+    }
+
+  /* Wait for all the parts */
+  g_thread_pool_free (pool, FALSE, TRUE);
+  g_mutex_clear (&upload.group.lock);
+
+  escaped_id = g_uri_escape_string (upload_id, NULL, FALSE);
+  query = g_strdup_printf ("uploadId=%s", escaped_id);
+  g_free (escaped_id);
+
+  if (upload.failed_status != 0 || exo_job_is_cancelled (EXO_JOB (job)))
+    {
+      /* Do not leave the sent parts stored, even if the job was
+       * cancelled, so not through screenshooter_upload_send_message() */
+      msg = new_request (s3_config, SOUP_METHOD_DELETE, key, query);
+
+      if (msg != NULL)
+        {
+          soup_session_send_message (screenshooter_upload_get_session (), msg);
+          g_object_unref (msg);
+        }
+
+      if (!exo_job_set_error_if_cancelled (EXO_JOB (job), error))
+        set_transfer_error (error, upload.failed_status);
+
+      for (i = 0; i < n_parts; i++)
+        g_free (parts[i].etag);
+
+      g_free (parts);
+      g_free (query);
+      g_free (upload_id);
+
+      return FALSE;
+    }
+
+  /* Assemble the parts */
+  completion = g_string_new ("<CompleteMultipartUpload>");
+
+  for (i = 0; i < n_parts; i++)
+    {
+      gchar *escaped_etag = g_markup_escape_text (parts[i].etag, -1);
+
+      g_string_append_printf (completion,
+                              "<Part><PartNumber>%u</PartNumber><ETag>%s</ETag></Part>",
+                              parts[i].number, escaped_etag);
+      g_free (escaped_etag);
+      g_free (parts[i].etag);
+    }
+
+  g_string_append (completion, "</CompleteMultipartUpload>");
+  g_free (parts);
+
+  exo_job_info_message (EXO_JOB (job), _("Assemble the uploaded parts..."));
+
+  msg = new_request (s3_config, SOUP_METHOD_POST, key, query);
+
+  if (G_UNLIKELY (msg == NULL))
+    {
+      set_address_error (error);
+      g_string_free (completion, TRUE);
+      g_free (query);
+      g_free (upload_id);
+
+      return FALSE;
+    }
+
+  soup_message_set_request (msg, "application/xml", SOUP_MEMORY_TAKE,
+                            completion->str, completion->len);
+  g_string_free (completion, FALSE);
+
+  status = screenshooter_upload_send_message (job, msg);
+
+  /* S3 may answer an error with a success status once the assembly began */
+  etag = SOUP_STATUS_IS_SUCCESSFUL (status) ? get_response_element (msg, "ETag") : NULL;
+  g_object_unref (msg);
+  g_free (query);
+  g_free (upload_id);
+
+  if (etag == NULL)
+    {
+      if (!exo_job_set_error_if_cancelled (EXO_JOB (job), error))
+        set_transfer_error (error, SOUP_STATUS_IS_SUCCESSFUL (status) ?
+                                   SOUP_STATUS_MALFORMED : status);
+      return FALSE;
+    }
+
+  g_free (etag);
+
+  return TRUE;
+}
+
+
+
+static gboolean
+s3_upload_job (ScreenshooterJob *job, GArray *param_values, GError **error)
+{
+  const gchar *image_path;
+  S3Config *s3_config;
+  GMappedFile *mapping;
+  SoupBuffer *buffer;
+  gchar *base_name, *key, *content_type, *mime_type;
+  gboolean success = TRUE;
+  GError *tmp_error = NULL;
+
+  g_return_val_if_fail (SCREENSHOOTER_IS_JOB (job), FALSE);
+  g_return_val_if_fail (param_values != NULL, FALSE);
+  g_return_val_if_fail (param_values->len == 2, FALSE);
+  g_return_val_if_fail ((G_VALUE_HOLDS_STRING (&g_array_index(param_values, GValue, 0))), FALSE);
+  g_return_val_if_fail ((G_VALUE_HOLDS_STRING (&g_array_index(param_values, GValue, 1))), FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  g_object_set_data (G_OBJECT (job), "jobtype", "s3");
+  if (exo_job_set_error_if_cancelled (EXO_JOB (job), error))
+    return FALSE;
+
+  s3_config = get_config ();
+
+  if (s3_config == NULL)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_INITIALIZED,
+                   _("The S3 endpoint, bucket and credentials must be set"
+                     " in the preferences."));
+      return FALSE;
+    }
+
+  image_path = g_value_get_string (&g_array_index (param_values, GValue, 0));
+
+  mapping = g_mapped_file_new (image_path, FALSE, &tmp_error);
+  if (!mapping)
+    {
+      g_propagate_error (error, tmp_error);
+      s3_config_free (s3_config);
+
+      return FALSE;
+    }
+
+  buffer = soup_buffer_new_with_owner (g_mapped_file_get_contents (mapping),
+                                       g_mapped_file_get_length (mapping),
+                                       mapping, (GDestroyNotify) g_mapped_file_unref);
+
+  base_name = g_path_get_basename (image_path);
+  key = g_strconcat (s3_config->prefix != NULL ? s3_config->prefix : "", base_name, NULL);
+  content_type = g_content_type_guess (image_path, NULL, 0, NULL);
+  mime_type = g_content_type_get_mime_type (content_type);
+
+  exo_job_info_message (EXO_JOB (job), _("Upload the screenshot..."));
+
+  if (buffer->length > s3_config->part_size)
+    success = upload_multipart (job, s3_config, key,
+                                mime_type != NULL ? mime_type : "application/octet-stream",
+                                buffer, error);
+  else
+    {
+      SoupMessage *msg = new_request (s3_config, SOUP_METHOD_PUT, key, NULL);
+      guint status;
+
+      if (G_UNLIKELY (msg == NULL))
+        {
+          set_address_error (error);
+          success = FALSE;
+          goto out;
+        }
+
+      soup_message_headers_replace (msg->request_headers, "Content-Type",
+                                    mime_type != NULL ? mime_type : "application/octet-stream");
+      screenshooter_upload_message_set_body (msg, buffer);
+
+      status = screenshooter_upload_send_message (job, msg);
+
+      if (status == SOUP_STATUS_CANCELLED)
+        {
+          exo_job_set_error_if_cancelled (EXO_JOB (job), error);
+          success = FALSE;
+        }
+      else if (!SOUP_STATUS_IS_SUCCESSFUL (status))
+        {
+          TRACE ("Error during the PUT exchange: %d %s\n",
+                 status, msg->reason_phrase);
+
+          set_transfer_error (error, status);
+          success = FALSE;
+        }
+
+      g_object_unref (msg);
+    }
+
+out:
+  soup_buffer_free (buffer);
+  g_free (base_name);
+  g_free (content_type);
+  g_free (mime_type);
+  s3_config_free (s3_config);
+
+  if (success)
+    screenshooter_job_image_uploaded (job, key);
+
+  g_free (key);
+
+  return success;
+}
+
+
+
+/* Public */
+
+
+
+/**
+ * screenshooter_s3_set_config:
+ * @sd: the #ScreenshotData holding the preferences of the storage.
+ *
+ * Sets the S3-compatible storage the screenshots are uploaded to. An
+ * empty access key is read from AWS_ACCESS_KEY_ID, an empty region from
+ * AWS_REGION. The secret key is not kept in the rc file, it is read from
+ * AWS_SECRET_ACCESS_KEY. The storage is left unset if the
+ * endpoint, the bucket or the credentials are missing, or if the endpoint
+ * is not an http or https address.
+ **/
+void
+screenshooter_s3_set_config (const ScreenshotData *sd)
+{
+  S3Config *new_config = g_new0 (S3Config, 1);
+
+  g_return_if_fail (sd != NULL);
+
+  new_config->endpoint = strip_slashes (dup_setting (sd->s3_endpoint, NULL));
+  new_config->bucket = dup_setting (sd->s3_bucket, NULL);
+  new_config->region = dup_setting (sd->s3_region, "AWS_REGION");
+  new_config->access_key = dup_setting (sd->s3_access_key, "AWS_ACCESS_KEY_ID");
+  new_config->secret_key = dup_setting (sd->s3_secret_key, "AWS_SECRET_ACCESS_KEY");
+  new_config->prefix = dup_setting (sd->s3_prefix, NULL);
+  new_config->public_url = strip_slashes (dup_setting (sd->s3_public_url, NULL));
+
+  if (new_config->region == NULL)
+    new_config->region = g_strdup (S3_DEFAULT_REGION);
+
+  new_config->part_size = sd->s3_part_size > 0 ?
+    MAX ((gsize) sd->s3_part_size * 1024 * 1024, S3_MIN_PART_SIZE) : S3_DEFAULT_PART_SIZE;
+  new_config->n_jobs = CLAMP (sd->s3_jobs, S3_MIN_JOBS, S3_MAX_JOBS);
+
+  /* soup_message_new() needs the scheme, s3.amazonaws.com would not do */
+  if (new_config->endpoint != NULL &&
+      !g_str_has_prefix (new_config->endpoint, "http://") &&
+      !g_str_has_prefix (new_config->endpoint, "https://"))
+    {
+      g_warning ("The S3 endpoint %s must start with http:// or https://",
+                 new_config->endpoint);
+      g_free (new_config->endpoint);
+      new_config->endpoint = NULL;
+    }
+
+  if (new_config->endpoint == NULL || new_config->bucket == NULL ||
+      new_config->access_key == NULL || new_config->secret_key == NULL)
+    {
+      s3_config_free (new_config);
+      new_config = NULL;
+    }
+
+  G_LOCK (config);
+  s3_config_free (config);
+  config = new_config;
+  G_UNLOCK (config);
+}
+
+
+
+/**
+ * screenshooter_s3_get_upload_url:
+ *
+ * Return value: the newly allocated address of the bucket the screenshots
+ * are uploaded to, or %NULL if no storage is set.
+ **/
+gchar *
+screenshooter_s3_get_upload_url (void)
+{
+  gchar *url = NULL;
+
+  G_LOCK (config);
+
+  if (config != NULL)
+    url = g_strdup_printf ("%s/%s/", config->endpoint, config->bucket);
+
+  G_UNLOCK (config);
+
+  return url;
+}
+
+
+
+/**
+ * screenshooter_s3_get_image_url:
+ * @upload_name: the key of an uploaded image, as given by "image-uploaded".
+ *
+ * Return value: the newly allocated address of the image, below the public
+ * address set in the preferences if any, else in the bucket.
+ **/
+gchar *
+screenshooter_s3_get_image_url (const gchar *upload_name)
+{
+  gchar *escaped_name, *url;
+
+  g_return_val_if_fail (upload_name != NULL, NULL);
+
+  escaped_name = g_uri_escape_string (upload_name, "/", FALSE);
+
+  G_LOCK (config);
+
+  if (config == NULL)
+    url = g_strdup (escaped_name);
+  else if (config->public_url != NULL)
+    url = g_strdup_printf ("%s/%s", config->public_url, escaped_name);
+  else
+    url = g_strdup_printf ("%s/%s/%s", config->endpoint, config->bucket, escaped_name);
+
+  G_UNLOCK (config);
+
+  g_free (escaped_name);
+
+  return url;
+}
+
+
+
+/**
+ * screenshooter_s3_upload_launch:
+ * @image_path: the local path of the image to upload.
+ * @title: the title of the screenshot.
+ *
+ * Starts the upload of @image_path to the S3-compatible storage, without
+ * any user interface. Images larger than the part size are sent with a
+ * multipart upload, several parts at a time, straight from the mapped
+ * file. The job emits "image-uploaded" with the key of the object, or
+ * "error", then "finished".
+ *
+ * Return value: the running #ScreenshooterJob.
+ **/
+ScreenshooterJob *
+screenshooter_s3_upload_launch (const gchar *image_path, const gchar *title)
+{
+  g_return_val_if_fail (image_path != NULL, NULL);
+
+  return screenshooter_simple_job_launch (s3_upload_job, 2,
+                                          G_TYPE_STRING, image_path,
+                                          G_TYPE_STRING, title);
+}
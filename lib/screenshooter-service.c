@@ -0,0 +1,566 @@
+/*  $Id$
+ *
+ *  Copyright © 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ * */
+
+#include "screenshooter-service.h"
+#include "screenshooter-capture.h"
+#include "screenshooter-pipeline.h"
+#include "screenshooter-trim.h"
+#include "screenshooter-utils.h"
+
+#include <signal.h>
+
+#include <glib-unix.h>
+#include <libxfce4util/libxfce4util.h>
+
+static const gchar introspection_xml[] =
+  "<node>"
+  "  <interface name='" SCREENSHOOTER_SERVICE_INTERFACE "'>"
+  "    <method name='Capture'>"
+  "      <arg type='s' name='region' direction='in'/>"
+  "      <arg type='a{sv}' name='options' direction='in'/>"
+  "      <arg type='s' name='path' direction='out'/>"
+  "    </method>"
+  "  </interface>"
+  "</node>";
+
+
+
+typedef struct
+{
+  ScreenshotData  *sd;
+  GDBusNodeInfo   *introspection;
+  GDBusConnection *connection;
+  guint            registration_id;
+  gboolean         acquired;
+
+  /* Where the screenshots are saved when the caller gives no directory */
+  gchar           *directory;
+
+  /* Directory -> ServicePipeline, kept until the service stops so that
+   * their encoder threads are ready for the next capture */
+  GHashTable      *pipelines;
+} Service;
+
+typedef struct
+{
+  ScreenshooterPipeline *pipeline;
+
+  /* Frame sequence -> GDBusMethodInvocation waiting for the path */
+  GHashTable            *pending;
+  guint                  n_pushed;
+} ServicePipeline;
+
+/* One Capture call, from the request to the push to the pipeline */
+typedef struct
+{
+  Service               *service;
+  GDBusMethodInvocation *invocation;
+  gchar                 *directory;
+  gboolean               trim;
+  gboolean               clipboard;
+} ServiceCall;
+
+
+
+/* Internals */
+
+
+
+static gboolean
+cb_pipeline_drained (ServicePipeline *sp)
+{
+  g_hash_table_destroy (sp->pending);
+  g_free (sp);
+
+  return FALSE;
+}
+
+
+
+/* The pipeline and @sp are freed once the frames in flight are delivered */
+static void
+service_pipeline_free (ServicePipeline *sp)
+{
+  screenshooter_pipeline_finish (sp->pipeline, (GSourceFunc) cb_pipeline_drained, sp);
+}
+
+
+
+static void
+service_call_free (ServiceCall *call)
+{
+  g_free (call->directory);
+  g_free (call);
+}
+
+
+
+/* Returns the local path of the directory @location, a path or an URI, or
+ * %NULL if it is not an existing local directory */
+static gchar *
+resolve_directory (const gchar *location)
+{
+  GFile *file;
+  gchar *path;
+
+  file = g_file_new_for_commandline_arg (location);
+  path = g_file_get_path (file);
+  g_object_unref (file);
+
+  if (path != NULL && !g_file_test (path, G_FILE_TEST_IS_DIR))
+    {
+      g_free (path);
+      path = NULL;
+    }
+
+  return path;
+}
+
+
+
+static gint
+parse_region (const gchar *name)
+{
+  if (g_strcmp0 (name, "fullscreen") == 0)
+    return FULLSCREEN;
+  else if (g_strcmp0 (name, "window") == 0)
+    return ACTIVE_WINDOW;
+  else if (g_strcmp0 (name, "region") == 0)
+    return SELECT;
+
+  return -1;
+}
+
+
+
+/* Sink of the pipelines: answers the call which requested the frame */
+static void
+deliver_capture (ScreenshooterFrame *frame, ServicePipeline *sp)
+{
+  GDBusMethodInvocation *invocation;
+  gpointer key = GUINT_TO_POINTER (frame->sequence);
+
+  invocation = g_hash_table_lookup (sp->pending, key);
+
+  g_return_if_fail (invocation != NULL);
+
+  g_hash_table_remove (sp->pending, key);
+
+  if (frame->path != NULL)
+    g_dbus_method_invocation_return_value (invocation,
+                                           g_variant_new ("(s)", frame->path));
+  else if (frame->error != NULL)
+    g_dbus_method_invocation_return_gerror (invocation, frame->error);
+  else
+    g_dbus_method_invocation_return_error (invocation, G_IO_ERROR, G_IO_ERROR_FAILED,
+                                           _("The screenshot could not be saved."));
+}
+
+
+
+static ServicePipeline *
+get_pipeline (Service *service, const gchar *directory)
+{
+  ServicePipeline *sp = g_hash_table_lookup (service->pipelines, directory);
+
+  if (sp != NULL)
+    return sp;
+
+  TRACE ("Start a pipeline for %s", directory);
+
+  /* Every call waits for its file, no screenshot may be dropped */
+  sp = g_new0 (ServicePipeline, 1);
+  sp->pending = g_hash_table_new (NULL, NULL);
+  sp->pipeline =
+    screenshooter_pipeline_new (SCREENSHOOTER_TRANSFORM_NONE, directory,
+                                service->sd->title, service->sd->timestamp, 0,
+                                service->sd->pipeline_depth,
+                                SCREENSHOOTER_OVERFLOW_BLOCK);
+
+  screenshooter_pipeline_add_sink (sp->pipeline,
+                                   (ScreenshooterFrameSink) deliver_capture, sp);
+
+  g_hash_table_insert (service->pipelines, g_strdup (directory), sp);
+
+  return sp;
+}
+
+
+
+static void
+cb_captured (GObject *source, GAsyncResult *result, ServiceCall *call)
+{
+  ScreenshooterCapture *capture;
+  ServicePipeline *sp;
+  GdkPixbuf *screenshot;
+  GError *error = NULL;
+
+  capture = screenshooter_capture_finish (result, &error);
+
+  if (capture == NULL)
+    {
+      g_dbus_method_invocation_take_error (call->invocation, error);
+      service_call_free (call);
+      return;
+    }
+
+  screenshot = g_object_ref (capture->screenshot);
+
+  /* Crop the uniform margins around windows and selected regions */
+  if (call->trim && capture->region != FULLSCREEN)
+    {
+      GdkRectangle area;
+      GdkPixbuf *trimmed = screenshooter_trim_uniform_border (screenshot, &area);
+
+      g_object_unref (screenshot);
+      screenshot = trimmed;
+    }
+
+  if (call->clipboard)
+    screenshooter_copy_to_clipboard (screenshot);
+
+  if (call->directory == NULL)
+    g_dbus_method_invocation_return_value (call->invocation, g_variant_new ("(s)", ""));
+  else
+    {
+      /* The call is answered by the sink once the file is written */
+      sp = get_pipeline (call->service, call->directory);
+      g_hash_table_insert (sp->pending, GUINT_TO_POINTER (++sp->n_pushed),
+                           call->invocation);
+      screenshooter_pipeline_push (sp->pipeline, screenshot);
+    }
+
+  g_object_unref (screenshot);
+  screenshooter_capture_free (capture);
+  service_call_free (call);
+}
+
+
+
+static void
+handle_method_call (GDBusConnection       *connection,
+                    const gchar           *sender,
+                    const gchar           *object_path,
+                    const gchar           *interface_name,
+                    const gchar           *method_name,
+                    GVariant              *parameters,
+                    GDBusMethodInvocation *invocation,
+                    Service               *service)
+{
+  ScreenshooterCaptureRequest *request;
+  ServiceCall *call;
+  GVariant *options;
+  const gchar *region_name, *directory = NULL;
+  gint region, delay = 0;
+  gboolean show_mouse = service->sd->show_mouse;
+  gboolean save = TRUE;
+
+  g_variant_get (parameters, "(&s@a{sv})", &region_name, &options);
+
+  TRACE ("Capture %s for %s", region_name, sender);
+
+  call = g_new0 (ServiceCall, 1);
+  call->service = service;
+  call->invocation = invocation;
+  call->trim = service->sd->trim;
+
+  g_variant_lookup (options, "delay", "i", &delay);
+  g_variant_lookup (options, "show-mouse", "b", &show_mouse);
+  g_variant_lookup (options, "trim", "b", &call->trim);
+  g_variant_lookup (options, "clipboard", "b", &call->clipboard);
+  g_variant_lookup (options, "save", "b", &save);
+  g_variant_lookup (options, "directory", "&s", &directory);
+
+  region = parse_region (region_name);
+
+  if (region < 0)
+    {
+      g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+                                             _("Unknown region %s, use fullscreen, window or region."),
+                                             region_name);
+      goto out;
+    }
+
+  if (!save && !call->clipboard)
+    {
+      g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+                                             _("The screenshot would be neither saved nor copied to the clipboard."));
+      goto out;
+    }
+
+  if (save)
+    {
+      call->directory = directory != NULL ? resolve_directory (directory)
+                                          : g_strdup (service->directory);
+
+      if (call->directory == NULL)
+        {
+          g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+                                                 _("%s is not a valid directory."), directory);
+          goto out;
+        }
+    }
+
+  request = screenshooter_capture_request_new (region, delay, show_mouse);
+  screenshooter_capture_async (request, NULL, (GAsyncReadyCallback) cb_captured, call);
+  screenshooter_capture_request_unref (request);
+
+  g_variant_unref (options);
+
+  return;
+
+out:
+  g_variant_unref (options);
+  service_call_free (call);
+}
+
+
+
+static const GDBusInterfaceVTable interface_vtable =
+{
+  (GDBusInterfaceMethodCallFunc) handle_method_call,
+  NULL,
+  NULL,
+};
+
+
+
+static void
+cb_bus_acquired (GDBusConnection *connection, const gchar *name, Service *service)
+{
+  GError *error = NULL;
+
+  service->connection = g_object_ref (connection);
+  service->registration_id =
+    g_dbus_connection_register_object (connection,
+                                       SCREENSHOOTER_SERVICE_PATH,
+                                       service->introspection->interfaces[0],
+                                       &interface_vtable,
+                                       service, NULL, &error);
+
+  if (service->registration_id == 0)
+    {
+      g_warning ("Failed to register the capture service: %s", error->message);
+      g_error_free (error);
+    }
+}
+
+
+
+static void
+cb_name_acquired (GDBusConnection *connection, const gchar *name, Service *service)
+{
+  TRACE ("Own %s", name);
+
+  service->acquired = TRUE;
+}
+
+
+
+/* Another instance owns the name, or the bus went away */
+static void
+cb_name_lost (GDBusConnection *connection, const gchar *name, Service *service)
+{
+  TRACE ("Lost %s", name);
+
+  gtk_main_quit ();
+}
+
+
+
+static gboolean
+cb_terminated (gpointer user_data)
+{
+  gtk_main_quit ();
+
+  return TRUE;
+}
+
+
+
+/* Public */
+
+
+
+/**
+ * screenshooter_service_run:
+ * @sd: the #ScreenshotData holding the preferences.
+ *
+ * Runs the capture service: owns %SCREENSHOOTER_SERVICE_NAME on the
+ * session bus and serves its Capture(region, options) method until the
+ * name is lost or the process gets SIGINT or SIGTERM.
+ *
+ * The region is "fullscreen", "window" or "region". The options are
+ * "delay" (i, in seconds), "show-mouse" (b), "trim" (b), "clipboard" (b),
+ * "save" (b, %TRUE by default) and "directory" (s, a path or an URI,
+ * the save directory of the preferences by default). The reply is the
+ * path of the saved screenshot, or an empty string if it was not saved.
+ *
+ * The display connection and the encoder threads of the pipelines stay
+ * up between the captures, so that each of them only costs the capture
+ * and the encoding.
+ *
+ * Return value: %FALSE if the name could not be owned.
+ **/
+gboolean
+screenshooter_service_run (ScreenshotData *sd)
+{
+  Service service = { 0 };
+  guint owner_id, term_id, int_id;
+
+  g_return_val_if_fail (sd != NULL, FALSE);
+
+  service.sd = sd;
+  service.introspection = g_dbus_node_info_new_for_xml (introspection_xml, NULL);
+  service.pipelines = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                             (GDestroyNotify) service_pipeline_free);
+
+  if (sd->screenshot_dir != NULL)
+    service.directory = resolve_directory (sd->screenshot_dir);
+
+  if (service.directory == NULL)
+    {
+      gchar *uri = screenshooter_get_xdg_image_dir_uri ();
+
+      service.directory = resolve_directory (uri);
+      g_free (uri);
+    }
+
+  if (service.directory == NULL)
+    service.directory = g_strdup (g_get_home_dir ());
+
+  owner_id = g_bus_own_name (G_BUS_TYPE_SESSION,
+                             SCREENSHOOTER_SERVICE_NAME,
+                             G_BUS_NAME_OWNER_FLAGS_NONE,
+                             (GBusAcquiredCallback) cb_bus_acquired,
+                             (GBusNameAcquiredCallback) cb_name_acquired,
+                             (GBusNameLostCallback) cb_name_lost,
+                             &service, NULL);
+
+  term_id = g_unix_signal_add (SIGTERM, cb_terminated, NULL);
+  int_id = g_unix_signal_add (SIGINT, cb_terminated, NULL);
+
+  gtk_main ();
+
+  g_source_remove (term_id);
+  g_source_remove (int_id);
+
+  if (service.registration_id != 0)
+    g_dbus_connection_unregister_object (service.connection, service.registration_id);
+
+  g_bus_unown_name (owner_id);
+
+  if (service.connection != NULL)
+    g_object_unref (service.connection);
+
+  g_hash_table_destroy (service.pipelines);
+  g_dbus_node_info_unref (service.introspection);
+  g_free (service.directory);
+
+  return service.acquired;
+}
+
+
+
+/**
+ * screenshooter_service_capture:
+ * @region: "fullscreen", "window" or "region".
+ * @delay: the delay before the capture, in seconds.
+ * @show_mouse: whether the pointer is drawn on the screenshot.
+ * @trim: whether the uniform borders of a window or region are cropped,
+ * %FALSE to leave it to the preferences of the service.
+ * @clipboard: whether the screenshot is copied to the clipboard.
+ * @save: whether the screenshot is saved.
+ * @directory: the directory where the screenshot is saved, a path
+ * relative to the current directory or an URI, or %NULL for the save
+ * directory of the preferences of the service.
+ * @error: return location for an error.
+ *
+ * Asks the running capture service to take a screenshot and waits for
+ * it to be done. The service is not started if it does not run, the call
+ * then fails with %G_DBUS_ERROR_SERVICE_UNKNOWN or
+ * %G_DBUS_ERROR_NAME_HAS_NO_OWNER.
+ *
+ * Return value: the path of the saved screenshot, empty if @save is
+ * %FALSE, or %NULL on error. Free it with g_free().
+ **/
+gchar *
+screenshooter_service_capture (const gchar  *region,
+                               gint          delay,
+                               gboolean      show_mouse,
+                               gboolean      trim,
+                               gboolean      clipboard,
+                               gboolean      save,
+                               const gchar  *directory,
+                               GError      **error)
+{
+  GDBusConnection *connection;
+  GVariantBuilder options;
+  GVariant *reply;
+  gchar *path;
+
+  g_return_val_if_fail (region != NULL, NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  connection = g_bus_get_sync (G_BUS_TYPE_SESSION, NULL, error);
+
+  if (connection == NULL)
+    return NULL;
+
+  g_variant_builder_init (&options, G_VARIANT_TYPE_VARDICT);
+  g_variant_builder_add (&options, "{sv}", "delay", g_variant_new_int32 (delay));
+  g_variant_builder_add (&options, "{sv}", "show-mouse", g_variant_new_boolean (show_mouse));
+  g_variant_builder_add (&options, "{sv}", "clipboard", g_variant_new_boolean (clipboard));
+  g_variant_builder_add (&options, "{sv}", "save", g_variant_new_boolean (save));
+
+  /* Otherwise the service crops as set in its preferences */
+  if (trim)
+    g_variant_builder_add (&options, "{sv}", "trim", g_variant_new_boolean (TRUE));
+
+  /* The service does not share our current directory */
+  if (save && directory != NULL)
+    {
+      GFile *file = g_file_new_for_commandline_arg (directory);
+      gchar *uri = g_file_get_uri (file);
+
+      g_variant_builder_add (&options, "{sv}", "directory", g_variant_new_take_string (uri));
+      g_object_unref (file);
+    }
+
+  /* No timeout, the user may take a while to select the region */
+  reply = g_dbus_connection_call_sync (connection,
+                                       SCREENSHOOTER_SERVICE_NAME,
+                                       SCREENSHOOTER_SERVICE_PATH,
+                                       SCREENSHOOTER_SERVICE_INTERFACE,
+                                       "Capture",
+                                       g_variant_new ("(sa{sv})", region, &options),
+                                       G_VARIANT_TYPE ("(s)"),
+                                       G_DBUS_CALL_FLAGS_NO_AUTO_START,
+                                       G_MAXINT, NULL, error);
+
+  g_object_unref (connection);
+
+  if (reply == NULL)
+    return NULL;
+
+  g_variant_get (reply, "(s)", &path);
+  g_variant_unref (reply);
+
+  return path;
+}
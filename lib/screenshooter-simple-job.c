@@ -107,8 +107,16 @@ screenshooter_simple_job_execute (ExoJob  *job,
   g_return_val_if_fail (SCREENSHOOTER_IS_SIMPLE_JOB (job), FALSE);
   g_return_val_if_fail (simple_job->func != NULL, FALSE);
 
-  /* try to execute the job using the supplied function */
-  success = (*simple_job->func) (SCREENSHOOTER_JOB (job), simple_job->param_values, &err);
+  /* wait for a free slot of the scheduler, unless cancelled meanwhile */
+  if (screenshooter_job_acquire_slot (SCREENSHOOTER_JOB (job)))
+    {
+      /* try to execute the job using the supplied function */
+      success = (*simple_job->func) (SCREENSHOOTER_JOB (job), simple_job->param_values, &err);
+
+      screenshooter_job_release_slot (SCREENSHOOTER_JOB (job));
+    }
+  else
+    success = FALSE;
 
   if (!success)
     {
@@ -134,28 +142,14 @@ screenshooter_simple_job_execute (ExoJob  *job,
 
 
 
-/**
- * screenshooter_simple_job_launch:
- * @func           : the #ScreenshooterSimpleJobFunc to execute the job.
- * @n_param_values : the number of parameters to pass to the @func.
- * @...            : a list of #GType and parameter pairs (exactly
- *                   @n_param_values pairs) that are passed to @func.
- *
- * Allocates a new #ScreenshooterSimpleJob, which executes the specified
- * @func with the specified parameters.
- *
- * The caller is responsible to release the returned object using
- * screenshooter_job_unref() when no longer needed.
- *
- * Return value: the launched #ScreenshooterJob.
- **/
-ScreenshooterJob *
-screenshooter_simple_job_launch (ScreenshooterSimpleJobFunc func,
-                                 guint                      n_param_values,
-                                 ...)
+/* Allocates a #ScreenshooterSimpleJob for screenshooter_simple_job_launch()
+ * and screenshooter_simple_job_launch_with_priority(), without launching it */
+static ScreenshooterSimpleJob *
+simple_job_new_valist (ScreenshooterSimpleJobFunc func,
+                       guint                      n_param_values,
+                       va_list                    var_args)
 {
   ScreenshooterSimpleJob *simple_job;
-  va_list var_args;
   gchar *error_message;
   guint n;
 
@@ -166,7 +160,6 @@ screenshooter_simple_job_launch (ScreenshooterSimpleJobFunc func,
   g_array_set_clear_func (simple_job->param_values, (GDestroyNotify) g_value_unset);
 
   /* collect the parameters */
-  va_start (var_args, n_param_values);
   for (n = 0; n < n_param_values; ++n)
     {
       GValue value = { 0 };
@@ -186,6 +179,37 @@ screenshooter_simple_job_launch (ScreenshooterSimpleJobFunc func,
 
       g_array_append_val(simple_job->param_values, value);
     }
+
+  return simple_job;
+}
+
+
+
+/**
+ * screenshooter_simple_job_launch:
+ * @func           : the #ScreenshooterSimpleJobFunc to execute the job.
+ * @n_param_values : the number of parameters to pass to the @func.
+ * @...            : a list of #GType and parameter pairs (exactly
+ *                   @n_param_values pairs) that are passed to @func.
+ *
+ * Allocates a new #ScreenshooterSimpleJob, which executes the specified
+ * @func with the specified parameters.
+ *
+ * The caller is responsible to release the returned object using
+ * screenshooter_job_unref() when no longer needed.
+ *
+ * Return value: the launched #ScreenshooterJob.
+ **/
+ScreenshooterJob *
+screenshooter_simple_job_launch (ScreenshooterSimpleJobFunc func,
+                                 guint                      n_param_values,
+                                 ...)
+{
+  ScreenshooterSimpleJob *simple_job;
+  va_list var_args;
+
+  va_start (var_args, n_param_values);
+  simple_job = simple_job_new_valist (func, n_param_values, var_args);
   va_end (var_args);
 
   /* launch the job */
@@ -194,6 +218,41 @@ screenshooter_simple_job_launch (ScreenshooterSimpleJobFunc func,
 
 
 
+/**
+ * screenshooter_simple_job_launch_with_priority:
+ * @priority       : the class of the job.
+ * @func           : the #ScreenshooterSimpleJobFunc to execute the job.
+ * @n_param_values : the number of parameters to pass to the @func.
+ * @...            : a list of #GType and parameter pairs (exactly
+ *                   @n_param_values pairs) that are passed to @func.
+ *
+ * Same as screenshooter_simple_job_launch(), for a job of the class
+ * @priority, which is set before the job asks for a slot, so that it
+ * waits in the right pool from the start.
+ *
+ * Return value: the launched #ScreenshooterJob.
+ **/
+ScreenshooterJob *
+screenshooter_simple_job_launch_with_priority (ScreenshooterJobPriority   priority,
+                                               ScreenshooterSimpleJobFunc func,
+                                               guint                      n_param_values,
+                                               ...)
+{
+  ScreenshooterSimpleJob *simple_job;
+  va_list var_args;
+
+  va_start (var_args, n_param_values);
+  simple_job = simple_job_new_valist (func, n_param_values, var_args);
+  va_end (var_args);
+
+  SCREENSHOOTER_JOB (simple_job)->priority = priority;
+
+  /* launch the job */
+  return SCREENSHOOTER_JOB (exo_job_launch (EXO_JOB (simple_job)));
+}
+
+
+
 GArray *
 screenshooter_simple_job_get_param_values (ScreenshooterSimpleJob *job)
 {
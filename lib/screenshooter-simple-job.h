@@ -63,6 +63,11 @@ GType             screenshooter_simple_job_get_type         (void) G_GNUC_CONST;
 ScreenshooterJob *screenshooter_simple_job_launch           (ScreenshooterSimpleJobFunc  func,
                                                              guint                       n_param_values,
                                                              ...) G_GNUC_MALLOC G_GNUC_WARN_UNUSED_RESULT;
+ScreenshooterJob *screenshooter_simple_job_launch_with_priority
+                                                            (ScreenshooterJobPriority    priority,
+                                                             ScreenshooterSimpleJobFunc  func,
+                                                             guint                       n_param_values,
+                                                             ...) G_GNUC_MALLOC G_GNUC_WARN_UNUSED_RESULT;
 GArray           *screenshooter_simple_job_get_param_values (ScreenshooterSimpleJob     *job);
 
 G_END_DECLS
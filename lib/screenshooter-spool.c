@@ -0,0 +1,780 @@
+/*  $Id$
+ *
+ *  Copyright © 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ * */
+
+#include "screenshooter-spool.h"
+#include "screenshooter-global.h"
+#include "screenshooter-imgur.h"
+#include "screenshooter-ipfs.h"
+#include "screenshooter-s3.h"
+#include "screenshooter-upload.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+#include <libxfce4util/libxfce4util.h>
+
+/* Location of the queue, relative to the cache directory */
+#define SPOOL_DIR            "xfce4/xfce4-screenshooter/spool/"
+
+/* Where the links of the queued uploads are delivered, relative to the
+ * data directory */
+#define SPOOL_RESULTS_FILE   "xfce4/xfce4-screenshooter/uploaded-links"
+
+#define SPOOL_GROUP          "Upload"
+#define SPOOL_ENTRY_SUFFIX   ".job"
+
+/* Number of queued uploads running at the same time */
+#define SPOOL_MAX_JOBS       2
+
+/* Cancellation group of the queued uploads */
+#define SPOOL_JOB_GROUP      "spool"
+
+/* Delays in seconds: before retrying an upload which failed for a
+ * transient reason, doubled at every attempt, and between two scans of
+ * the queue for the entries which became due */
+#define SPOOL_RETRY_MIN      30
+#define SPOOL_RETRY_MAX      3600
+#define SPOOL_POLL_INTERVAL  60
+
+
+
+/* One upload of the queue, i.e. one service for one artifact */
+typedef struct
+{
+  gchar            *entry_path;
+  gchar            *artifact_path;
+  gchar            *service;
+  gchar            *title;
+  ScreenshooterJob *job;
+} SpoolEntry;
+
+
+
+/* Uploads running, by entry path; NULL while the queue is not drained */
+static GHashTable  *running = NULL;
+
+static GSourceFunc  drained_callback = NULL;
+static gpointer     drained_data = NULL;
+static gint         lock_fd = -1;
+static gulong       network_id = 0;
+static guint        poll_id = 0;
+static guint        drain_id = 0;
+
+/* Whether the application is held until the queue is empty, see
+ * hold_until_empty () */
+static gboolean     holding = FALSE;
+
+
+
+/* Internals */
+
+
+
+static gchar *
+get_spool_dir (void)
+{
+  return xfce_resource_save_location (XFCE_RESOURCE_CACHE, SPOOL_DIR, TRUE);
+}
+
+
+
+/* Returns the id shared by the artifact and the entries of a queued
+ * screenshot, i.e. its file name up to the first dot */
+static gchar *
+get_entry_id (const gchar *path)
+{
+  gchar *name = g_path_get_basename (path);
+  gchar *dot = strchr (name, '.');
+
+  if (dot != NULL)
+    *dot = '\0';
+
+  return name;
+}
+
+
+
+static void
+spool_entry_free (SpoolEntry *entry)
+{
+  if (entry->job != NULL)
+    {
+      g_signal_handlers_disconnect_by_data (entry->job, entry);
+      g_object_unref (entry->job);
+    }
+
+  g_free (entry->entry_path);
+  g_free (entry->artifact_path);
+  g_free (entry->service);
+  g_free (entry->title);
+  g_free (entry);
+}
+
+
+
+/* Appends the outcome of a queued upload to the results file */
+static void
+write_result (SpoolEntry *entry, const gchar *url, const gchar *error)
+{
+  gchar *path, *date;
+  FILE *file;
+
+  path = xfce_resource_save_location (XFCE_RESOURCE_DATA, SPOOL_RESULTS_FILE, TRUE);
+
+  if (G_UNLIKELY (path == NULL))
+    return;
+
+  file = g_fopen (path, "a");
+
+  if (G_LIKELY (file != NULL))
+    {
+      date = screenshooter_get_datetime ("%Y-%m-%d %H:%M:%S");
+
+      fprintf (file, "%s\t%s\t%s\t%s%s\n", date, entry->service,
+               entry->title != NULL ? entry->title : "",
+               url != NULL ? url : "error: ",
+               url != NULL ? "" : error);
+
+      fclose (file);
+      g_free (date);
+    }
+
+  g_free (path);
+}
+
+
+
+/* Whether no entry is left in the queue, due or not */
+static gboolean
+is_spool_empty (void)
+{
+  gchar *spool_dir = get_spool_dir ();
+  const gchar *name;
+  gboolean empty = TRUE;
+  GDir *dir;
+
+  dir = spool_dir != NULL ? g_dir_open (spool_dir, 0, NULL) : NULL;
+
+  while (empty && dir != NULL && (name = g_dir_read_name (dir)) != NULL)
+    if (g_str_has_suffix (name, SPOOL_ENTRY_SUFFIX))
+      empty = FALSE;
+
+  if (dir != NULL)
+    g_dir_close (dir);
+
+  g_free (spool_dir);
+
+  return empty;
+}
+
+
+
+/* Removes a done entry, and its artifact once no other service needs it */
+static void
+remove_entry (SpoolEntry *entry)
+{
+  gchar *spool_dir, *id, *pattern;
+  const gchar *name;
+  gboolean referenced = FALSE;
+  GDir *dir;
+
+  TRACE ("Remove %s from the queue", entry->entry_path);
+
+  g_unlink (entry->entry_path);
+
+  spool_dir = get_spool_dir ();
+  id = get_entry_id (entry->entry_path);
+  pattern = g_strconcat (id, ".", NULL);
+
+  dir = g_dir_open (spool_dir, 0, NULL);
+
+  while (dir != NULL && (name = g_dir_read_name (dir)) != NULL)
+    if (g_str_has_prefix (name, pattern) && g_str_has_suffix (name, SPOOL_ENTRY_SUFFIX))
+      referenced = TRUE;
+
+  if (dir != NULL)
+    g_dir_close (dir);
+
+  if (!referenced)
+    g_unlink (entry->artifact_path);
+
+  g_free (pattern);
+  g_free (id);
+  g_free (spool_dir);
+}
+
+
+
+/* Keeps an entry which failed for a transient reason, for a later try */
+static void
+defer_entry (SpoolEntry *entry)
+{
+  GKeyFile *keyfile = g_key_file_new ();
+  gint attempts;
+  gint64 delay;
+
+  if (g_key_file_load_from_file (keyfile, entry->entry_path, G_KEY_FILE_NONE, NULL))
+    {
+      attempts = g_key_file_get_integer (keyfile, SPOOL_GROUP, "Attempts", NULL) + 1;
+      delay = MIN ((gint64) SPOOL_RETRY_MIN << MIN (attempts - 1, 16), SPOOL_RETRY_MAX);
+
+      TRACE ("Retry %s in %" G_GINT64_FORMAT " s", entry->entry_path, delay);
+
+      g_key_file_set_integer (keyfile, SPOOL_GROUP, "Attempts", attempts);
+      g_key_file_set_int64 (keyfile, SPOOL_GROUP, "NextAttempt",
+                            g_get_real_time () / G_USEC_PER_SEC + delay);
+      g_key_file_save_to_file (keyfile, entry->entry_path, NULL);
+    }
+
+  g_key_file_free (keyfile);
+}
+
+
+
+static gboolean spool_drain (gpointer unused);
+
+
+
+static void
+schedule_drain (void)
+{
+  if (running != NULL && drain_id == 0)
+    drain_id = g_idle_add (spool_drain, NULL);
+}
+
+
+
+static void
+cb_entry_uploaded (ScreenshooterJob *job, gchar *upload_name, SpoolEntry *entry)
+{
+  gchar *url;
+
+  /* It would fail again the next time, it is not kept */
+  if (G_UNLIKELY (upload_name == NULL))
+    {
+      write_result (entry, NULL, _("The service did not return the name of the upload."));
+      remove_entry (entry);
+      return;
+    }
+
+  if (g_strcmp0 (entry->service, "imgur") == 0)
+    url = screenshooter_imgur_get_image_url (upload_name);
+  else if (g_strcmp0 (entry->service, "s3") == 0)
+    url = screenshooter_s3_get_image_url (upload_name);
+  else
+    url = screenshooter_ipfs_get_image_url (upload_name);
+
+  write_result (entry, url, NULL);
+  remove_entry (entry);
+
+  g_free (url);
+}
+
+
+
+static void
+cb_entry_error (ExoJob *job, GError *error, SpoolEntry *entry)
+{
+  g_return_if_fail (error != NULL);
+
+  if (error->domain == SOUP_HTTP_ERROR &&
+      screenshooter_upload_is_transient_failure (error->code))
+    {
+      defer_entry (entry);
+      return;
+    }
+
+  write_result (entry, NULL, error->message);
+  remove_entry (entry);
+}
+
+
+
+static void
+cb_entry_finished (ExoJob *job, SpoolEntry *entry)
+{
+  /* Frees the entry */
+  g_hash_table_remove (running, entry->entry_path);
+
+  schedule_drain ();
+}
+
+
+
+/* Whether the host @entry is uploaded to can be reached */
+static gboolean
+is_entry_reachable (SpoolEntry *entry, const gchar *add_url)
+{
+  gchar *url;
+  gboolean reachable;
+
+  if (g_strcmp0 (entry->service, "imgur") == 0)
+    url = g_strdup (screenshooter_imgur_get_upload_url ());
+  else if (g_strcmp0 (entry->service, "ipfs") == 0)
+    url = g_strdup (screenshooter_ipfs_get_upload_url (add_url));
+  else if (g_strcmp0 (entry->service, "s3") == 0)
+    url = screenshooter_s3_get_upload_url ();
+  else
+    return TRUE;
+
+  reachable = screenshooter_spool_is_online (url);
+  g_free (url);
+
+  return reachable;
+}
+
+
+
+/* Starts the upload of the entry at @path if it is due. Takes @path. */
+static gboolean
+spool_launch (gchar *path, gint64 now)
+{
+  GKeyFile *keyfile = g_key_file_new ();
+  SpoolEntry *entry;
+  gchar *spool_dir, *artifact, *add_url;
+
+  if (!g_key_file_load_from_file (keyfile, path, G_KEY_FILE_NONE, NULL))
+    {
+      g_warning ("Dropping the unreadable upload queue entry %s", path);
+      g_unlink (path);
+      g_key_file_free (keyfile);
+      g_free (path);
+
+      return FALSE;
+    }
+
+  if (g_key_file_get_int64 (keyfile, SPOOL_GROUP, "NextAttempt", NULL) > now)
+    {
+      g_key_file_free (keyfile);
+      g_free (path);
+
+      return FALSE;
+    }
+
+  spool_dir = get_spool_dir ();
+  artifact = g_key_file_get_string (keyfile, SPOOL_GROUP, "Artifact", NULL);
+  add_url = g_key_file_get_string (keyfile, SPOOL_GROUP, "IpfsAddUrl", NULL);
+
+  entry = g_new0 (SpoolEntry, 1);
+  entry->entry_path = path;
+  entry->artifact_path = g_build_filename (spool_dir, artifact != NULL ? artifact : "", NULL);
+  entry->service = g_key_file_get_string (keyfile, SPOOL_GROUP, "Service", NULL);
+  entry->title = g_key_file_get_string (keyfile, SPOOL_GROUP, "Title", NULL);
+
+  g_free (artifact);
+  g_free (spool_dir);
+  g_key_file_free (keyfile);
+
+  /* Kept as is until its host can be reached */
+  if (!is_entry_reachable (entry, add_url))
+    {
+      TRACE ("The host of %s cannot be reached", entry->entry_path);
+
+      g_free (add_url);
+      spool_entry_free (entry);
+
+      return FALSE;
+    }
+
+  TRACE ("Upload %s to %s", entry->artifact_path, entry->service);
+
+  if (g_strcmp0 (entry->service, "imgur") == 0)
+    entry->job = screenshooter_imgur_upload_launch (entry->artifact_path, entry->title);
+  else if (g_strcmp0 (entry->service, "ipfs") == 0)
+    entry->job = screenshooter_ipfs_upload_launch (entry->artifact_path, entry->title, add_url);
+  else if (g_strcmp0 (entry->service, "s3") == 0)
+    entry->job = screenshooter_s3_upload_launch (entry->artifact_path, entry->title);
+
+  g_free (add_url);
+
+  if (G_UNLIKELY (entry->job == NULL))
+    {
+      write_result (entry, NULL, _("Unknown upload service"));
+      remove_entry (entry);
+      spool_entry_free (entry);
+
+      return FALSE;
+    }
+
+  /* Queued uploads give way to the ones the user is waiting for */
+  screenshooter_job_set_priority (entry->job, SCREENSHOOTER_JOB_PRIORITY_BACKGROUND);
+  screenshooter_job_set_group (entry->job, SPOOL_JOB_GROUP);
+
+  g_signal_connect (entry->job, "image-uploaded", G_CALLBACK (cb_entry_uploaded), entry);
+  g_signal_connect (entry->job, "error", G_CALLBACK (cb_entry_error), entry);
+  g_signal_connect (entry->job, "finished", G_CALLBACK (cb_entry_finished), entry);
+
+  g_hash_table_insert (running, entry->entry_path, entry);
+
+  return TRUE;
+}
+
+
+
+/* Starts the due entries of the queue, as long as there is room for them */
+static gboolean
+spool_drain (gpointer unused)
+{
+  gchar *spool_dir;
+  const gchar *name;
+  gint64 now = g_get_real_time () / G_USEC_PER_SEC;
+  GDir *dir;
+
+  drain_id = 0;
+
+  if (running == NULL)
+    return FALSE;
+
+  spool_dir = get_spool_dir ();
+  dir = spool_dir != NULL ? g_dir_open (spool_dir, 0, NULL) : NULL;
+
+  if (dir != NULL)
+    {
+      while (g_hash_table_size (running) < SPOOL_MAX_JOBS &&
+             (name = g_dir_read_name (dir)) != NULL)
+        {
+          gchar *path;
+
+          if (!g_str_has_suffix (name, SPOOL_ENTRY_SUFFIX))
+            continue;
+
+          path = g_build_filename (spool_dir, name, NULL);
+
+          if (g_hash_table_contains (running, path))
+            g_free (path);
+          else
+            spool_launch (path, now);
+        }
+    }
+
+  if (dir != NULL)
+    g_dir_close (dir);
+
+  g_free (spool_dir);
+
+  /* Nothing more can be done until an entry is due or the network
+   * comes back */
+  if (g_hash_table_size (running) == 0 && drained_callback != NULL)
+    drained_callback (drained_data);
+
+  if (holding && g_hash_table_size (running) == 0 && is_spool_empty ())
+    {
+      TRACE ("The upload queue is empty");
+
+      holding = FALSE;
+      screenshooter_release ();
+    }
+
+  return FALSE;
+}
+
+
+
+static void
+cb_network_changed (GNetworkMonitor *monitor, gboolean available, gpointer unused)
+{
+  TRACE ("The network is %s", available ? "available" : "unavailable");
+
+  if (available)
+    schedule_drain ();
+}
+
+
+
+static gboolean
+cb_poll (gpointer unused)
+{
+  schedule_drain ();
+
+  return TRUE;
+}
+
+
+
+/* Keeps the application running until the queue is empty, draining it
+ * from this process unless another one already does, so that a queued
+ * upload is not left behind when the capture exits */
+static void
+hold_until_empty (void)
+{
+  if (holding)
+    return;
+
+  if (running == NULL && !screenshooter_spool_start (NULL, NULL))
+    return;
+
+  holding = TRUE;
+  screenshooter_hold ();
+}
+
+
+
+/* Public */
+
+
+
+/**
+ * screenshooter_spool_add:
+ * @image_path: the encoded screenshot to upload.
+ * @title: the title of the screenshot.
+ * @action: the actions of the screenshot, only the uploads are queued.
+ * @ipfs_add_url: (allow-none): the add URL of an IPFS node, see
+ *                screenshooter_ipfs_get_add_url().
+ * @error: return location for a #GError.
+ *
+ * Queues the uploads of @image_path on disk, in the cache directory, so
+ * that they are done in the background once the network is available,
+ * even after a restart. The screenshot is copied next to one key file per
+ * service; the links are appended to the uploaded-links file in the data
+ * directory.
+ *
+ * Unless another process drains the queue, this process starts draining
+ * it and holds the application with screenshooter_hold() until the queue
+ * is empty.
+ *
+ * Return value: whether the uploads were queued.
+ **/
+gboolean
+screenshooter_spool_add (const gchar  *image_path,
+                         const gchar  *title,
+                         gint          action,
+                         const gchar  *ipfs_add_url,
+                         GError      **error)
+{
+  const gchar *services[3];
+  const gchar *extension;
+  gchar *spool_dir, *id, *artifact, *artifact_path;
+  GFile *source, *destination;
+  gboolean success = TRUE;
+  guint i, n_services = 0;
+
+  g_return_val_if_fail (image_path != NULL, FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  if (action & UPLOAD_IMGUR)
+    services[n_services++] = "imgur";
+  if (action & UPLOAD_IPFS)
+    services[n_services++] = "ipfs";
+  if (action & UPLOAD_S3)
+    services[n_services++] = "s3";
+
+  g_return_val_if_fail (n_services > 0, FALSE);
+
+  spool_dir = get_spool_dir ();
+
+  if (G_UNLIKELY (spool_dir == NULL))
+    {
+      g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                   _("The upload queue directory could not be created."));
+      return FALSE;
+    }
+
+  extension = strrchr (image_path, '.');
+  id = g_strdup_printf ("%" G_GINT64_FORMAT "-%08x", g_get_real_time (), g_random_int ());
+  artifact = g_strconcat (id, extension != NULL ? extension : ".png", NULL);
+  artifact_path = g_build_filename (spool_dir, artifact, NULL);
+
+  TRACE ("Queue %s as %s", image_path, artifact_path);
+
+  /* The artifact is complete before any entry points to it */
+  source = g_file_new_for_path (image_path);
+  destination = g_file_new_for_path (artifact_path);
+  success = g_file_copy (source, destination, G_FILE_COPY_NONE,
+                         NULL, NULL, NULL, error);
+
+  g_object_unref (source);
+  g_object_unref (destination);
+
+  for (i = 0; success && i < n_services; i++)
+    {
+      GKeyFile *keyfile = g_key_file_new ();
+      gchar *name = g_strconcat (id, ".", services[i], SPOOL_ENTRY_SUFFIX, NULL);
+      gchar *entry_path = g_build_filename (spool_dir, name, NULL);
+
+      g_key_file_set_string (keyfile, SPOOL_GROUP, "Service", services[i]);
+      g_key_file_set_string (keyfile, SPOOL_GROUP, "Artifact", artifact);
+      g_key_file_set_string (keyfile, SPOOL_GROUP, "Title", title != NULL ? title : "");
+      g_key_file_set_int64 (keyfile, SPOOL_GROUP, "Queued",
+                            g_get_real_time () / G_USEC_PER_SEC);
+      g_key_file_set_integer (keyfile, SPOOL_GROUP, "Attempts", 0);
+
+      if (ipfs_add_url != NULL && g_strcmp0 (services[i], "ipfs") == 0)
+        g_key_file_set_string (keyfile, SPOOL_GROUP, "IpfsAddUrl", ipfs_add_url);
+
+      success = g_key_file_save_to_file (keyfile, entry_path, error);
+
+      g_key_file_free (keyfile);
+      g_free (entry_path);
+      g_free (name);
+    }
+
+  g_free (artifact_path);
+  g_free (artifact);
+  g_free (id);
+  g_free (spool_dir);
+
+  if (success)
+    hold_until_empty ();
+
+  schedule_drain ();
+
+  return success;
+}
+
+
+
+/**
+ * screenshooter_spool_start:
+ * @drained_func: (allow-none): called when the queue cannot make progress
+ *                anymore, because it is empty, its entries are not due yet
+ *                or the network is unavailable.
+ * @data: user data for @drained_func.
+ *
+ * Starts draining the upload queue from the main loop, at most
+ * SPOOL_MAX_JOBS uploads at a time. The queue is looked at again when the
+ * network becomes available and every SPOOL_POLL_INTERVAL seconds. Only
+ * one process drains the queue at a time.
+ *
+ * Return value: %FALSE if another process is already draining the queue.
+ **/
+gboolean
+screenshooter_spool_start (GSourceFunc drained_func, gpointer data)
+{
+  gchar *spool_dir, *lock_path;
+
+  if (running != NULL)
+    return TRUE;
+
+  spool_dir = get_spool_dir ();
+
+  if (G_UNLIKELY (spool_dir == NULL))
+    return FALSE;
+
+  lock_path = g_build_filename (spool_dir, "lock", NULL);
+  lock_fd = g_open (lock_path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+
+  g_free (lock_path);
+  g_free (spool_dir);
+
+  if (lock_fd < 0 || flock (lock_fd, LOCK_EX | LOCK_NB) != 0)
+    {
+      TRACE ("The upload queue is drained by another process");
+
+      if (lock_fd >= 0)
+        close (lock_fd);
+
+      lock_fd = -1;
+      return FALSE;
+    }
+
+  running = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                   NULL, (GDestroyNotify) spool_entry_free);
+  drained_callback = drained_func;
+  drained_data = data;
+
+  network_id = g_signal_connect (g_network_monitor_get_default (), "network-changed",
+                                 G_CALLBACK (cb_network_changed), NULL);
+  poll_id = g_timeout_add_seconds (SPOOL_POLL_INTERVAL, cb_poll, NULL);
+
+  schedule_drain ();
+
+  return TRUE;
+}
+
+
+
+/**
+ * screenshooter_spool_stop:
+ *
+ * Stops draining the upload queue. The running uploads are cancelled and
+ * stay in the queue.
+ **/
+void
+screenshooter_spool_stop (void)
+{
+  GHashTableIter iter;
+  SpoolEntry *entry;
+
+  if (running == NULL)
+    return;
+
+  g_hash_table_iter_init (&iter, running);
+
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &entry))
+    g_signal_handlers_disconnect_by_data (entry->job, entry);
+
+  screenshooter_job_cancel_group (SPOOL_JOB_GROUP);
+
+  g_hash_table_destroy (running);
+  running = NULL;
+
+  g_signal_handler_disconnect (g_network_monitor_get_default (), network_id);
+  network_id = 0;
+
+  g_source_remove (poll_id);
+  poll_id = 0;
+
+  if (drain_id != 0)
+    g_source_remove (drain_id);
+  drain_id = 0;
+
+  close (lock_fd);
+  lock_fd = -1;
+
+  if (holding)
+    {
+      holding = FALSE;
+      screenshooter_release ();
+    }
+}
+
+
+
+/**
+ * screenshooter_spool_is_online:
+ * @url: (allow-none): the address an upload is sent to, or %NULL.
+ *
+ * Return value: whether the host of @url can be reached, e.g. an IPFS node
+ * on this machine while the network is unavailable, or whether the
+ * network is available if @url is %NULL. When it cannot, the upload
+ * should be queued with screenshooter_spool_add().
+ **/
+gboolean
+screenshooter_spool_is_online (const gchar *url)
+{
+  GNetworkMonitor *monitor = g_network_monitor_get_default ();
+  GSocketConnectable *address;
+  gboolean reachable;
+
+  if (g_network_monitor_get_network_available (monitor))
+    return TRUE;
+
+  if (url == NULL || (address = g_network_address_parse_uri (url, 80, NULL)) == NULL)
+    return FALSE;
+
+  reachable = g_network_monitor_can_reach (monitor, address, NULL, NULL);
+  g_object_unref (address);
+
+  return reachable;
+}
@@ -0,0 +1,209 @@
+/*  $Id$
+ *
+ *  Copyright © 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ * */
+
+#include "screenshooter-trim.h"
+
+#include <string.h>
+#include <libxfce4util/libxfce4util.h>
+
+
+
+/* Internals */
+
+
+
+/* Returns the offset of the first byte in [@start, @end) where @row and
+ * @ref differ, or @end if they are equal on that range. The bulk of the
+ * comparison is done one machine word at a time, which the compiler turns
+ * into vector compares; only the last word is narrowed down bytewise. */
+static gsize
+first_mismatch (const guchar *row, const guchar *ref, gsize start, gsize end)
+{
+  gsize i = start;
+
+  for (; i + sizeof (guint64) <= end; i += sizeof (guint64))
+    {
+      guint64 a, b;
+
+      memcpy (&a, row + i, sizeof (guint64));
+      memcpy (&b, ref + i, sizeof (guint64));
+
+      if (a != b)
+        break;
+    }
+
+  for (; i < end; i++)
+    if (row[i] != ref[i])
+      return i;
+
+  return end;
+}
+
+
+
+/* Same as first_mismatch(), but walks backwards from @end and returns the
+ * offset just past the last differing byte, or @start if none differ. */
+static gsize
+last_mismatch (const guchar *row, const guchar *ref, gsize start, gsize end)
+{
+  gsize i = end;
+
+  for (; i >= start + sizeof (guint64); i -= sizeof (guint64))
+    {
+      guint64 a, b;
+
+      memcpy (&a, row + i - sizeof (guint64), sizeof (guint64));
+      memcpy (&b, ref + i - sizeof (guint64), sizeof (guint64));
+
+      if (a != b)
+        break;
+    }
+
+  for (; i > start; i--)
+    if (row[i - 1] != ref[i - 1])
+      return i;
+
+  return start;
+}
+
+
+
+/* Public */
+
+
+
+/**
+ * screenshooter_trim_uniform_border:
+ * @screenshot: a #GdkPixbuf.
+ * @area: (allow-none): return location for the kept area, in @screenshot
+ *        coordinates.
+ *
+ * Finds the bounding box of the content of @screenshot, i.e. everything
+ * which does not have the same color as its top left pixel, and returns
+ * it as a sub-pixbuf sharing the pixels of @screenshot. Nothing is copied.
+ *
+ * Rows are compared in one go against a reference row filled with the
+ * border color; columns are found by looking for the first and the last
+ * differing byte of each remaining row, only inside the margins which are
+ * still candidates for trimming.
+ *
+ * Return value: a new reference to a #GdkPixbuf. If there is nothing to
+ * trim, or if the whole image is uniform, it is @screenshot itself.
+ **/
+GdkPixbuf *screenshooter_trim_uniform_border (GdkPixbuf    *screenshot,
+                                              GdkRectangle *area)
+{
+  const guchar *pixels;
+  guchar *ref_row;
+  gint width, height, rowstride, n_channels;
+  gint top, bottom, y;
+  gsize row_len, left, right;
+  GdkPixbuf *trimmed;
+
+  g_return_val_if_fail (GDK_IS_PIXBUF (screenshot), NULL);
+  g_return_val_if_fail (gdk_pixbuf_get_bits_per_sample (screenshot) == 8, NULL);
+
+  width = gdk_pixbuf_get_width (screenshot);
+  height = gdk_pixbuf_get_height (screenshot);
+  rowstride = gdk_pixbuf_get_rowstride (screenshot);
+  n_channels = gdk_pixbuf_get_n_channels (screenshot);
+  pixels = gdk_pixbuf_read_pixels (screenshot);
+
+  if (area != NULL)
+    {
+      area->x = area->y = 0;
+      area->width = width;
+      area->height = height;
+    }
+
+  if (G_UNLIKELY (width < 2 || height < 2))
+    return g_object_ref (screenshot);
+
+  /* Build a row made of the border color only */
+  row_len = (gsize) width * n_channels;
+  ref_row = g_malloc (row_len);
+
+  memcpy (ref_row, pixels, n_channels);
+  for (left = n_channels; left < row_len; left *= 2)
+    memcpy (ref_row + left, ref_row, MIN (left, row_len - left));
+
+  TRACE ("Scan the uniform rows");
+
+  for (top = 0; top < height; top++)
+    if (memcmp (pixels + (gsize) top * rowstride, ref_row, row_len) != 0)
+      break;
+
+  if (top == height)
+    {
+      TRACE ("The screenshot is uniform, nothing to trim");
+
+      g_free (ref_row);
+      return g_object_ref (screenshot);
+    }
+
+  for (bottom = height; bottom > top + 1; bottom--)
+    if (memcmp (pixels + (gsize) (bottom - 1) * rowstride, ref_row, row_len) != 0)
+      break;
+
+  TRACE ("Scan the uniform columns");
+
+  /* left and right are byte offsets in the row; every row only needs to
+   * be looked at where it could still move the current bounds. */
+  left = row_len;
+  right = 0;
+
+  for (y = top; y < bottom; y++)
+    {
+      const guchar *row = pixels + (gsize) y * rowstride;
+
+      if (left > 0)
+        left = first_mismatch (row, ref_row, 0, left);
+
+      if (right < row_len)
+        right = last_mismatch (row, ref_row, right, row_len);
+
+      if (left == 0 && right == row_len)
+        break;
+    }
+
+  g_free (ref_row);
+
+  /* Round to whole pixels */
+  left /= n_channels;
+  right = (right + n_channels - 1) / n_channels;
+
+  if (top == 0 && bottom == height && left == 0 && right == (gsize) width)
+    return g_object_ref (screenshot);
+
+  TRACE ("Trim the screenshot to %" G_GSIZE_FORMAT "x%d+%" G_GSIZE_FORMAT "+%d",
+         right - left, bottom - top, left, top);
+
+  if (area != NULL)
+    {
+      area->x = left;
+      area->y = top;
+      area->width = right - left;
+      area->height = bottom - top;
+    }
+
+  trimmed = gdk_pixbuf_new_subpixbuf (screenshot, left, top,
+                                      right - left, bottom - top);
+
+  return trimmed;
+}
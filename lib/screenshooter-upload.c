@@ -0,0 +1,955 @@
+/*  $Id$
+ *
+ *  Copyright © 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ * */
+
+#include "screenshooter-upload.h"
+
+#include <sys/resource.h>
+
+#include <libxfce4util/libxfce4util.h>
+#include <exo/exo.h>
+
+/* Connection pool limits of the shared session */
+#define UPLOAD_MAX_CONNS          16
+#define UPLOAD_MAX_CONNS_PER_HOST 8
+
+/* Seconds an unused keep-alive connection stays in the pool */
+#define UPLOAD_IDLE_TIMEOUT       90
+
+/* Size of the pieces the request bodies are written in */
+#define UPLOAD_CHUNK_SIZE         (64 * 1024)
+
+/* Minimal interval between two progress reports, in microseconds */
+#define UPLOAD_REPORT_INTERVAL    (100 * 1000)
+
+/* Links of the files already uploaded, by service and content hash,
+ * relative to the cache directory */
+#define UPLOAD_CACHE_FILE         "xfce4/xfce4-screenshooter/upload-cache"
+
+/* Minimal interval between two warm-ups of the connection to a host, in
+ * microseconds, well below UPLOAD_IDLE_TIMEOUT */
+#define UPLOAD_PREWARM_INTERVAL   (30 * G_USEC_PER_SEC)
+
+/* Size of the token bucket of the upload rate limit, in bytes */
+#define UPLOAD_RATE_BURST         UPLOAD_CHUNK_SIZE
+
+/* Retry policy for the transient failures, delays in microseconds */
+#define UPLOAD_MAX_ATTEMPTS       4
+#define UPLOAD_BACKOFF_BASE       (500 * 1000)
+#define UPLOAD_BACKOFF_MAX        (8 * G_USEC_PER_SEC)
+
+
+
+/* State of one message being sent */
+typedef struct
+{
+  ScreenshooterJob *job;
+  SoupMessage      *msg;
+  goffset           total;
+  goffset           sent;
+  gint64            start_time;
+  gint64            last_report;
+  UploadGroup      *group;
+} UploadProgress;
+
+
+
+/* Upload statistics of the process, reported by --stats */
+static GMutex stats_lock;
+static guint  stats_uploads = 0;
+static guint  stats_failures = 0;
+static guint  stats_retries = 0;
+static guint64 stats_bytes = 0;
+
+/* Wall-clock time during which at least one upload was running, the
+ * concurrent uploads are only counted once */
+static gint64 stats_time = 0;
+static guint  stats_running = 0;
+static gint64 stats_busy_since = 0;
+
+/* Token bucket shared by the uploads, rate_limit_bytes per second, 0 if
+ * the rate is not limited */
+static GMutex  rate_lock;
+static guint64 rate_limit_bytes = 0;
+static gdouble rate_tokens = 0;
+static gint64  rate_last_refill = 0;
+
+/* Last warm-up of the connection to each host, only used from the main
+ * loop */
+static GHashTable *prewarmed = NULL;
+
+/* Content hash to link cache, loaded on first use */
+static GMutex    cache_lock;
+static GKeyFile *cache = NULL;
+
+
+
+/* Internals */
+
+
+
+/* Returns the throughput in MB/s of @bytes sent in @usec microseconds */
+static gdouble
+get_throughput (goffset bytes, gint64 usec)
+{
+  if (usec <= 0)
+    return 0;
+
+  return ((gdouble) bytes / (1000 * 1000)) / ((gdouble) usec / G_USEC_PER_SEC);
+}
+
+
+
+/* Sleeps @usec microseconds, returns FALSE early if @cancellable is
+ * cancelled meanwhile */
+static gboolean
+backoff_sleep (GCancellable *cancellable, gint64 usec)
+{
+  GPollFD pollfd;
+
+  if (!g_cancellable_make_pollfd (cancellable, &pollfd))
+    {
+      g_usleep (usec);
+      return !g_cancellable_is_cancelled (cancellable);
+    }
+
+  g_poll (&pollfd, 1, usec / 1000);
+  g_cancellable_release_fd (cancellable);
+
+  return !g_cancellable_is_cancelled (cancellable);
+}
+
+
+
+/* Takes @length bytes from the bucket shared by all the uploads, and
+ * sleeps until the bucket is refilled if it runs short. Returns FALSE if
+ * @cancellable is cancelled meanwhile. */
+static gboolean
+rate_limit (gsize length, GCancellable *cancellable)
+{
+  gint64 now, wait = 0;
+
+  g_mutex_lock (&rate_lock);
+
+  if (rate_limit_bytes > 0)
+    {
+      now = g_get_monotonic_time ();
+
+      /* Refill the bucket for the time elapsed, up to one chunk, then take
+       * the bytes; a negative level is the debt of the waiting uploads */
+      rate_tokens = MIN (rate_tokens + (gdouble) (now - rate_last_refill) *
+                         rate_limit_bytes / G_USEC_PER_SEC,
+                         UPLOAD_RATE_BURST);
+      rate_last_refill = now;
+      rate_tokens -= length;
+
+      if (rate_tokens < 0)
+        wait = -rate_tokens * G_USEC_PER_SEC / rate_limit_bytes;
+    }
+
+  g_mutex_unlock (&rate_lock);
+
+  if (wait > 0)
+    return backoff_sleep (cancellable, wait);
+
+  return TRUE;
+}
+
+
+
+static void
+cb_wrote_body_data (SoupMessage *msg, SoupBuffer *chunk, UploadProgress *progress)
+{
+  goffset bytes_sent = 0, bytes_total = 0;
+  gint64 now, start_time = progress->start_time;
+  gchar *sent, *total;
+
+  progress->sent += chunk->length;
+
+  /* The next chunk is written when this returns */
+  rate_limit (chunk->length, exo_job_get_cancellable (EXO_JOB (progress->job)));
+
+  now = g_get_monotonic_time ();
+
+  /* The messages of a group report their overall progress */
+  if (progress->group != NULL)
+    {
+      g_mutex_lock (&progress->group->lock);
+      progress->group->sent += chunk->length;
+      bytes_sent = progress->group->sent;
+      bytes_total = progress->group->total;
+      start_time = progress->group->start_time;
+      g_mutex_unlock (&progress->group->lock);
+    }
+  else
+    {
+      bytes_sent = progress->sent;
+      bytes_total = progress->total;
+    }
+
+  /* Reporting goes through the main loop, do not flood it */
+  if (now - progress->last_report < UPLOAD_REPORT_INTERVAL &&
+      bytes_sent < bytes_total)
+    return;
+
+  progress->last_report = now;
+
+  sent = g_format_size (bytes_sent);
+  total = g_format_size (bytes_total);
+
+  exo_job_percent (EXO_JOB (progress->job),
+                   100.0 * bytes_sent / MAX (bytes_total, 1));
+  exo_job_info_message (EXO_JOB (progress->job),
+                        _("Uploaded %s of %s (%.2f MB/s)"), sent, total,
+                        get_throughput (bytes_sent, now - start_time));
+
+  g_free (sent);
+  g_free (total);
+}
+
+
+
+/* Aborts the message when the job is cancelled, called from the thread
+ * which cancelled the job */
+static void
+cb_cancelled (GCancellable *cancellable, UploadProgress *progress)
+{
+  TRACE ("The upload was cancelled");
+
+  soup_session_cancel_message (screenshooter_upload_get_session (),
+                               progress->msg, SOUP_STATUS_CANCELLED);
+}
+
+
+
+/* Returns the delay before the attempt following @attempt: the server's
+ * Retry-After if it gave one in seconds, else a random delay up to an
+ * exponentially growing bound, so that clients failing together do not
+ * come back together. */
+static gint64
+get_backoff_delay (SoupMessage *msg, guint attempt)
+{
+  const gchar *retry_after;
+  gint64 bound;
+
+  retry_after = soup_message_headers_get_one (msg->response_headers, "Retry-After");
+
+  if (retry_after != NULL && g_ascii_isdigit (*retry_after))
+    return MIN (g_ascii_strtoll (retry_after, NULL, 10) * G_USEC_PER_SEC,
+                UPLOAD_BACKOFF_MAX);
+
+  bound = MIN ((gint64) UPLOAD_BACKOFF_BASE << (attempt - 1), UPLOAD_BACKOFF_MAX);
+
+  return bound / 2 + g_random_int_range (0, bound / 2 + 1);
+}
+
+
+
+/* Returns whether @msg may be sent again after failing with @status, at
+ * once, by send_message(). A POST is not idempotent: it is only replayed
+ * if it never reached the server, or if the server turned it down without
+ * handling it; after a timeout or a dropped connection, the upload may
+ * have been made and would be made twice. */
+static gboolean
+is_replayable_failure (SoupMessage *msg, guint status, goffset sent)
+{
+  if (msg->method != SOUP_METHOD_POST)
+    return screenshooter_upload_is_transient_failure (status);
+
+  switch (status)
+    {
+      case SOUP_STATUS_CANT_RESOLVE:
+      case SOUP_STATUS_CANT_RESOLVE_PROXY:
+      case SOUP_STATUS_CANT_CONNECT:
+      case SOUP_STATUS_CANT_CONNECT_PROXY:
+      case 429: /* Too Many Requests */
+      case SOUP_STATUS_SERVICE_UNAVAILABLE:
+        return TRUE;
+
+      case SOUP_STATUS_IO_ERROR:
+        /* The connection was lost before any of the body was written */
+        return sent == 0;
+
+      default:
+        return FALSE;
+    }
+}
+
+
+
+/* Returns the cache, loading it if needed. Must be called with the
+ * cache lock held. */
+static GKeyFile *
+get_cache (void)
+{
+  gchar *path;
+
+  if (cache != NULL)
+    return cache;
+
+  cache = g_key_file_new ();
+  path = xfce_resource_lookup (XFCE_RESOURCE_CACHE, UPLOAD_CACHE_FILE);
+
+  if (path != NULL)
+    g_key_file_load_from_file (cache, path, G_KEY_FILE_NONE, NULL);
+
+  g_free (path);
+
+  return cache;
+}
+
+
+
+/* The group of the links of the files uploaded to @endpoint of @service,
+ * so that a link is only reused for the same node, bucket or server */
+static gchar *
+get_cache_group (const gchar *service, const gchar *endpoint)
+{
+  if (endpoint == NULL)
+    return g_strdup (service);
+
+  return g_strconcat (service, " ", endpoint, NULL);
+}
+
+
+
+/* Appends @chunk to the request body of @msg in pieces of
+ * UPLOAD_CHUNK_SIZE bytes, so that the progress can be followed */
+static void
+append_pieces (SoupMessage *msg, SoupBuffer *chunk)
+{
+  gsize position;
+
+  for (position = 0; position < chunk->length; position += UPLOAD_CHUNK_SIZE)
+    {
+      SoupBuffer *piece =
+        soup_buffer_new_subbuffer (chunk, position,
+                                   MIN (UPLOAD_CHUNK_SIZE, chunk->length - position));
+
+      soup_message_body_append_buffer (msg->request_body, piece);
+      soup_buffer_free (piece);
+    }
+}
+
+
+
+/* Sends @msg for screenshooter_upload_send_message(), as part of @group if
+ * it is not %NULL */
+static guint
+send_message (ScreenshooterJob *job, SoupMessage *msg, UploadGroup *group)
+{
+  UploadProgress progress;
+  GCancellable *cancellable;
+  gulong wrote_id, cancelled_id;
+  gint64 now, elapsed, delay;
+  goffset sent = 0;
+  guint status, attempt = 1;
+
+  progress.job = job;
+  progress.msg = msg;
+  progress.total = msg->request_body->length;
+  progress.start_time = g_get_monotonic_time ();
+  progress.group = group;
+
+  g_mutex_lock (&stats_lock);
+  if (stats_running++ == 0)
+    stats_busy_since = progress.start_time;
+  g_mutex_unlock (&stats_lock);
+
+  wrote_id = g_signal_connect (msg, "wrote-body-data",
+                               G_CALLBACK (cb_wrote_body_data), &progress);
+
+  cancellable = exo_job_get_cancellable (EXO_JOB (job));
+  cancelled_id = g_cancellable_connect (cancellable, G_CALLBACK (cb_cancelled),
+                                        &progress, NULL);
+
+  while (TRUE)
+    {
+      progress.sent = 0;
+      progress.last_report = 0;
+
+      if (G_UNLIKELY (g_cancellable_is_cancelled (cancellable)))
+        status = SOUP_STATUS_CANCELLED;
+      else
+        status = soup_session_send_message (screenshooter_upload_get_session (), msg);
+
+      sent += progress.sent;
+
+      if (!is_replayable_failure (msg, status, progress.sent) ||
+          attempt == UPLOAD_MAX_ATTEMPTS)
+        break;
+
+      /* The body is sent again from the start */
+      if (group != NULL)
+        {
+          g_mutex_lock (&group->lock);
+          group->sent -= progress.sent;
+          g_mutex_unlock (&group->lock);
+        }
+
+      delay = get_backoff_delay (msg, attempt);
+
+      TRACE ("Attempt %u failed with status %u, retry in %" G_GINT64_FORMAT " us",
+             attempt, status, delay);
+
+      exo_job_info_message (EXO_JOB (job),
+                            _("The upload failed, retrying in %.1f s"
+                              " (attempt %u of %u)..."),
+                            (gdouble) delay / G_USEC_PER_SEC,
+                            attempt + 1, UPLOAD_MAX_ATTEMPTS);
+
+      if (group == NULL)
+        exo_job_percent (EXO_JOB (job), 0);
+
+      if (!backoff_sleep (cancellable, delay))
+        {
+          status = SOUP_STATUS_CANCELLED;
+          break;
+        }
+
+      attempt++;
+
+      g_mutex_lock (&stats_lock);
+      stats_retries++;
+      g_mutex_unlock (&stats_lock);
+    }
+
+  g_cancellable_disconnect (cancellable, cancelled_id);
+  g_signal_handler_disconnect (msg, wrote_id);
+
+  now = g_get_monotonic_time ();
+  elapsed = now - progress.start_time;
+
+  TRACE ("Sent %" G_GOFFSET_FORMAT " bytes in %" G_GINT64_FORMAT " us, status %u",
+         sent, elapsed, status);
+
+  g_mutex_lock (&stats_lock);
+  stats_uploads++;
+  if (!SOUP_STATUS_IS_SUCCESSFUL (status))
+    stats_failures++;
+  stats_bytes += sent;
+  if (--stats_running == 0)
+    stats_time += now - stats_busy_since;
+  g_mutex_unlock (&stats_lock);
+
+  return status;
+}
+
+
+
+/* Public */
+
+
+
+/**
+ * screenshooter_upload_get_session:
+ *
+ * Returns the #SoupSession shared by all the uploads of the process. It is
+ * created on first use, with the proxy configuration resolved once, and
+ * keeps its connections alive so that back-to-back uploads to the same host
+ * skip the DNS lookup and the TCP and TLS handshakes.
+ *
+ * The session is only ever used through its synchronous API from the job
+ * threads, and from the main loop, which is safe for a plain #SoupSession.
+ *
+ * Return value: the shared #SoupSession, owned by the library.
+ **/
+SoupSession *
+screenshooter_upload_get_session (void)
+{
+  static gsize session = 0;
+
+  if (g_once_init_enter (&session))
+    {
+      SoupSession *new_session;
+      const gchar *proxy_uri;
+#if DEBUG > 0
+      SoupLogger *log;
+#endif
+
+      TRACE ("Create the shared upload session");
+
+      new_session =
+        soup_session_new_with_options (SOUP_SESSION_MAX_CONNS, UPLOAD_MAX_CONNS,
+                                       SOUP_SESSION_MAX_CONNS_PER_HOST, UPLOAD_MAX_CONNS_PER_HOST,
+                                       SOUP_SESSION_IDLE_TIMEOUT, UPLOAD_IDLE_TIMEOUT,
+                                       SOUP_SESSION_USER_AGENT, PACKAGE_NAME "/" PACKAGE_VERSION " ",
+                                       NULL);
+
+#if DEBUG > 0
+      log = soup_logger_new (SOUP_LOGGER_LOG_HEADERS, -1);
+      soup_session_add_feature (new_session, (SoupSessionFeature *) log);
+      g_object_unref (log);
+#endif
+
+      /* Set the proxy URI if any, else the system proxy resolver is used */
+      proxy_uri = g_getenv ("http_proxy");
+
+      if (proxy_uri != NULL)
+        {
+          SoupURI *soup_proxy_uri = soup_uri_new (proxy_uri);
+
+          g_object_set (new_session, "proxy-uri", soup_proxy_uri, NULL);
+          soup_uri_free (soup_proxy_uri);
+        }
+
+      g_once_init_leave (&session, (gsize) new_session);
+    }
+
+  return (SoupSession *) session;
+}
+
+
+
+/**
+ * screenshooter_upload_message_new:
+ * @method: the HTTP method.
+ * @url: the destination of the upload.
+ * @multipart: the #SoupMultipart form to send.
+ *
+ * Creates a message sending @multipart to @url. Unlike
+ * soup_form_request_new_from_multipart(), the body is made of pieces of
+ * UPLOAD_CHUNK_SIZE bytes, so that the progress of the upload can be
+ * followed while it is being written. The pieces are sub-buffers of the
+ * parts of @multipart, nothing is copied.
+ *
+ * Return value: a new #SoupMessage, or %NULL if @url could not be parsed.
+ **/
+SoupMessage *
+screenshooter_upload_message_new (const gchar   *method,
+                                  const gchar   *url,
+                                  SoupMultipart *multipart)
+{
+  SoupMessageBody *body;
+  SoupMessage *msg;
+  goffset offset = 0;
+
+  g_return_val_if_fail (method != NULL, NULL);
+  g_return_val_if_fail (url != NULL, NULL);
+  g_return_val_if_fail (multipart != NULL, NULL);
+
+  msg = soup_message_new (method, url);
+
+  if (G_UNLIKELY (msg == NULL))
+    return NULL;
+
+  body = soup_message_body_new ();
+  soup_multipart_to_message (multipart, msg->request_headers, body);
+
+  while (offset < body->length)
+    {
+      SoupBuffer *chunk = soup_message_body_get_chunk (body, offset);
+
+      append_pieces (msg, chunk);
+
+      offset += chunk->length;
+      soup_buffer_free (chunk);
+    }
+
+  soup_message_body_free (body);
+
+  soup_message_headers_set_content_length (msg->request_headers,
+                                           msg->request_body->length);
+
+  return msg;
+}
+
+
+
+/**
+ * screenshooter_upload_message_set_body:
+ * @msg: a #SoupMessage without a request body.
+ * @buffer: the body to send.
+ *
+ * Sets @buffer as the request body of @msg, made of pieces of
+ * UPLOAD_CHUNK_SIZE bytes like in screenshooter_upload_message_new().
+ * The pieces are sub-buffers of @buffer, nothing is copied.
+ **/
+void
+screenshooter_upload_message_set_body (SoupMessage *msg, SoupBuffer *buffer)
+{
+  g_return_if_fail (SOUP_IS_MESSAGE (msg));
+  g_return_if_fail (buffer != NULL);
+
+  append_pieces (msg, buffer);
+
+  soup_message_headers_set_content_length (msg->request_headers,
+                                           msg->request_body->length);
+}
+
+
+
+/**
+ * screenshooter_upload_send_message:
+ * @job: the #ScreenshooterJob sending the message.
+ * @msg: a #SoupMessage, e.g. from screenshooter_upload_message_new().
+ *
+ * Sends @msg synchronously on the shared session, from the thread of @job.
+ * While the body is written, @job emits "percent" and "info-message" with
+ * the progress and the throughput. Cancelling @job aborts the transfer.
+ *
+ * Transient failures (connection problems, timeouts, 429 and 5xx) are
+ * retried up to UPLOAD_MAX_ATTEMPTS times with a jittered exponential
+ * backoff. A POST is only retried when it did not reach the server, or
+ * on 429 and 503, since it may otherwise have been handled already. The
+ * request body is kept by @msg, so it is replayed as is from the memory
+ * or the mapped file it was built from.
+ *
+ * Return value: the HTTP status code of the last attempt,
+ * %SOUP_STATUS_CANCELLED if @job was cancelled.
+ **/
+guint
+screenshooter_upload_send_message (ScreenshooterJob *job, SoupMessage *msg)
+{
+  g_return_val_if_fail (SCREENSHOOTER_IS_JOB (job), SOUP_STATUS_MALFORMED);
+  g_return_val_if_fail (SOUP_IS_MESSAGE (msg), SOUP_STATUS_MALFORMED);
+
+  return send_message (job, msg, NULL);
+}
+
+
+
+/**
+ * screenshooter_upload_send_part:
+ * @job: the #ScreenshooterJob sending the message.
+ * @msg: a #SoupMessage.
+ * @group: the #UploadGroup of the messages sent in parallel by @job.
+ *
+ * Like screenshooter_upload_send_message(), for one of several messages
+ * sent at the same time from different threads, e.g. the parts of a
+ * multipart upload. The progress emitted by @job is the one of the whole
+ * @group. Set the total of @group, initialize its lock and set its start
+ * time before sending the first part.
+ *
+ * Return value: the HTTP status code of the last attempt,
+ * %SOUP_STATUS_CANCELLED if @job was cancelled.
+ **/
+guint
+screenshooter_upload_send_part (ScreenshooterJob *job,
+                                SoupMessage      *msg,
+                                UploadGroup      *group)
+{
+  g_return_val_if_fail (SCREENSHOOTER_IS_JOB (job), SOUP_STATUS_MALFORMED);
+  g_return_val_if_fail (SOUP_IS_MESSAGE (msg), SOUP_STATUS_MALFORMED);
+  g_return_val_if_fail (group != NULL, SOUP_STATUS_MALFORMED);
+
+  return send_message (job, msg, group);
+}
+
+
+
+/**
+ * screenshooter_upload_set_rate_limit:
+ * @kbytes_per_second: the maximal upload rate in KB/s, or 0.
+ *
+ * Limits the rate the request bodies are written at, so that uploads do
+ * not saturate a shared link. The limit is a token bucket shared by all
+ * the uploads running at the same time. It throttles the writing of the
+ * body chunks, which are never copied. 0 removes the limit.
+ **/
+void
+screenshooter_upload_set_rate_limit (guint kbytes_per_second)
+{
+  g_mutex_lock (&rate_lock);
+
+  rate_limit_bytes = (guint64) kbytes_per_second * 1000;
+  rate_tokens = UPLOAD_RATE_BURST;
+  rate_last_refill = g_get_monotonic_time ();
+
+  g_mutex_unlock (&rate_lock);
+}
+
+
+
+/**
+ * screenshooter_upload_prewarm:
+ * @url: the address an upload will be sent to.
+ *
+ * Resolves the host of @url and opens a connection to it in the shared
+ * session with a HEAD request, while the user is still selecting the
+ * region or the action. The connection is then kept alive in the pool, so
+ * the upload starts without waiting for the DNS lookup and the TCP and TLS
+ * handshakes. Must be called from the main loop.
+ **/
+void
+screenshooter_upload_prewarm (const gchar *url)
+{
+  SoupSession *session;
+  SoupMessage *msg;
+  SoupURI *uri;
+  gint64 now, *last, *stamp;
+
+  g_return_if_fail (url != NULL);
+
+  uri = soup_uri_new (url);
+
+  if (uri == NULL || uri->host == NULL)
+    {
+      if (uri != NULL)
+        soup_uri_free (uri);
+      return;
+    }
+
+  if (prewarmed == NULL)
+    prewarmed = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+  now = g_get_monotonic_time ();
+  last = g_hash_table_lookup (prewarmed, uri->host);
+
+  if (last != NULL && now - *last < UPLOAD_PREWARM_INTERVAL)
+    {
+      soup_uri_free (uri);
+      return;
+    }
+
+  TRACE ("Warm up the connection to %s", uri->host);
+
+  stamp = g_new (gint64, 1);
+  *stamp = now;
+  g_hash_table_insert (prewarmed, g_strdup (uri->host), stamp);
+
+  session = screenshooter_upload_get_session ();
+  soup_session_prefetch_dns (session, uri->host, NULL, NULL, NULL);
+
+  /* The session owns the message, the answer does not matter */
+  msg = soup_message_new_from_uri (SOUP_METHOD_HEAD, uri);
+  soup_session_queue_message (session, msg, NULL, NULL);
+
+  soup_uri_free (uri);
+}
+
+
+
+/**
+ * screenshooter_upload_is_transient_failure:
+ * @status: the HTTP or transport status of an upload.
+ *
+ * Return value: whether the upload failed for a reason which may go away
+ * by itself, so that it is worth trying again later.
+ **/
+gboolean
+screenshooter_upload_is_transient_failure (guint status)
+{
+  switch (status)
+    {
+      case SOUP_STATUS_CANT_RESOLVE:
+      case SOUP_STATUS_CANT_RESOLVE_PROXY:
+      case SOUP_STATUS_CANT_CONNECT:
+      case SOUP_STATUS_CANT_CONNECT_PROXY:
+      case SOUP_STATUS_IO_ERROR:
+      case SOUP_STATUS_REQUEST_TIMEOUT:
+      case 429: /* Too Many Requests, not named by libsoup 2.4 */
+      case SOUP_STATUS_INTERNAL_SERVER_ERROR:
+      case SOUP_STATUS_BAD_GATEWAY:
+      case SOUP_STATUS_SERVICE_UNAVAILABLE:
+      case SOUP_STATUS_GATEWAY_TIMEOUT:
+        return TRUE;
+
+      default:
+        return FALSE;
+    }
+}
+
+
+
+/**
+ * screenshooter_upload_get_stats:
+ *
+ * Summarizes the uploads done by the process so far, and how long their
+ * jobs waited for the scheduler. The time and the throughput are those
+ * of the periods during which uploads were running, whatever the number
+ * of them running at the same time.
+ *
+ * Return value: a newly allocated string, free it with g_free().
+ **/
+gchar *
+screenshooter_upload_get_stats (void)
+{
+  struct rusage usage;
+  gchar *bytes, *memory, *jobs, *result;
+  gint64 busy_time;
+
+  /* ru_maxrss is in kilobytes */
+  if (getrusage (RUSAGE_SELF, &usage) == 0)
+    memory = g_format_size ((guint64) usage.ru_maxrss * 1024);
+  else
+    memory = g_strdup (_("unknown"));
+
+  jobs = screenshooter_job_get_stats ();
+
+  g_mutex_lock (&stats_lock);
+
+  /* Including the uploads still running */
+  busy_time = stats_time;
+  if (stats_running > 0)
+    busy_time += g_get_monotonic_time () - stats_busy_since;
+
+  bytes = g_format_size (stats_bytes);
+  result = g_strdup_printf (_("Uploads: %u (%u failed, %u retries)\n"
+                              "Uploaded: %s in %.2f s (%.2f MB/s)\n"
+                              "Peak memory: %s\n%s"),
+                            stats_uploads, stats_failures, stats_retries, bytes,
+                            (gdouble) busy_time / G_USEC_PER_SEC,
+                            get_throughput (stats_bytes, busy_time),
+                            memory, jobs);
+
+  g_mutex_unlock (&stats_lock);
+
+  g_free (bytes);
+  g_free (memory);
+  g_free (jobs);
+
+  return result;
+}
+
+
+
+/**
+ * screenshooter_upload_get_endpoint:
+ * @variable: the name of an environment variable.
+ * @default_url: the address of the service.
+ *
+ * Lets the address of an upload service be replaced by the environment,
+ * to point the upload jobs at a local server when working on them.
+ *
+ * Return value: the value of @variable if it is set and not empty,
+ * @default_url otherwise.
+ **/
+const gchar *
+screenshooter_upload_get_endpoint (const gchar *variable, const gchar *default_url)
+{
+  const gchar *url;
+
+  g_return_val_if_fail (variable != NULL, default_url);
+
+  url = g_getenv (variable);
+
+  if (url == NULL || *url == '\0')
+    return default_url;
+
+  TRACE ("%s overrides %s with %s", variable, default_url, url);
+
+  return url;
+}
+
+
+
+/**
+ * screenshooter_upload_compute_checksum:
+ * @path: the path of a local file.
+ * @error: return location for a #GError.
+ *
+ * Return value: the newly allocated SHA-256 of the contents of @path, as
+ * used by the upload cache, or %NULL if the file could not be read.
+ **/
+gchar *
+screenshooter_upload_compute_checksum (const gchar *path, GError **error)
+{
+  GMappedFile *mapping;
+  gchar *checksum;
+
+  g_return_val_if_fail (path != NULL, NULL);
+
+  mapping = g_mapped_file_new (path, FALSE, error);
+
+  if (mapping == NULL)
+    return NULL;
+
+  checksum = g_compute_checksum_for_data (G_CHECKSUM_SHA256,
+                                          (const guchar *) g_mapped_file_get_contents (mapping),
+                                          g_mapped_file_get_length (mapping));
+
+  g_mapped_file_unref (mapping);
+
+  return checksum;
+}
+
+
+
+/**
+ * screenshooter_upload_cache_lookup:
+ * @service: the service, e.g. "imgur" or "ipfs".
+ * @endpoint: (allow-none): the address the files are uploaded to, e.g.
+ *            the add URL of the IPFS node or the bucket.
+ * @checksum: the checksum of the file, see
+ *            screenshooter_upload_compute_checksum().
+ *
+ * Return value: the newly allocated link of a file with the same contents
+ * already uploaded to @endpoint of @service, or %NULL.
+ **/
+gchar *
+screenshooter_upload_cache_lookup (const gchar *service,
+                                   const gchar *endpoint,
+                                   const gchar *checksum)
+{
+  gchar *group, *link;
+
+  g_return_val_if_fail (service != NULL, NULL);
+  g_return_val_if_fail (checksum != NULL, NULL);
+
+  group = get_cache_group (service, endpoint);
+
+  g_mutex_lock (&cache_lock);
+  link = g_key_file_get_string (get_cache (), group, checksum, NULL);
+  g_mutex_unlock (&cache_lock);
+
+  g_free (group);
+
+  return link;
+}
+
+
+
+/**
+ * screenshooter_upload_cache_store:
+ * @service: the service, e.g. "imgur" or "ipfs".
+ * @endpoint: (allow-none): the address the file was uploaded to.
+ * @checksum: the checksum of the uploaded file.
+ * @link: the link of the uploaded file.
+ *
+ * Remembers that the file whose checksum is @checksum is available at
+ * @link once uploaded to @endpoint of @service. The cache is saved at once.
+ **/
+void
+screenshooter_upload_cache_store (const gchar *service,
+                                  const gchar *endpoint,
+                                  const gchar *checksum,
+                                  const gchar *link)
+{
+  gchar *group, *path;
+
+  g_return_if_fail (service != NULL);
+  g_return_if_fail (checksum != NULL);
+  g_return_if_fail (link != NULL);
+
+  group = get_cache_group (service, endpoint);
+
+  g_mutex_lock (&cache_lock);
+
+  g_key_file_set_string (get_cache (), group, checksum, link);
+
+  path = xfce_resource_save_location (XFCE_RESOURCE_CACHE, UPLOAD_CACHE_FILE, TRUE);
+
+  if (path != NULL)
+    g_key_file_save_to_file (cache, path, NULL);
+
+  g_mutex_unlock (&cache_lock);
+
+  g_free (group);
+  g_free (path);
+}
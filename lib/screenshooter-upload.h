@@ -0,0 +1,68 @@
+/*  $Id$
+ *
+ *  Copyright © 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ * */
+
+#ifndef __HAVE_UPLOAD_H__
+#define __HAVE_UPLOAD_H__
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <glib.h>
+#include <libsoup/soup.h>
+
+#include "screenshooter-job.h"
+
+/* Progress of messages sent in parallel for the same job */
+typedef struct
+{
+  GMutex  lock;
+  goffset total;
+  goffset sent;
+  gint64  start_time;
+} UploadGroup;
+
+SoupSession *screenshooter_upload_get_session           (void);
+SoupMessage *screenshooter_upload_message_new           (const gchar      *method,
+                                                         const gchar      *url,
+                                                         SoupMultipart    *multipart);
+void         screenshooter_upload_message_set_body      (SoupMessage      *msg,
+                                                         SoupBuffer       *buffer);
+guint        screenshooter_upload_send_message          (ScreenshooterJob *job,
+                                                         SoupMessage      *msg);
+guint        screenshooter_upload_send_part             (ScreenshooterJob *job,
+                                                         SoupMessage      *msg,
+                                                         UploadGroup      *group);
+void         screenshooter_upload_set_rate_limit        (guint             kbytes_per_second);
+void         screenshooter_upload_prewarm               (const gchar      *url);
+gboolean     screenshooter_upload_is_transient_failure  (guint             status);
+gchar       *screenshooter_upload_get_stats             (void);
+const gchar *screenshooter_upload_get_endpoint          (const gchar      *variable,
+                                                         const gchar      *default_url);
+gchar       *screenshooter_upload_compute_checksum      (const gchar      *path,
+                                                         GError          **error);
+gchar       *screenshooter_upload_cache_lookup          (const gchar      *service,
+                                                         const gchar      *endpoint,
+                                                         const gchar      *checksum);
+void         screenshooter_upload_cache_store           (const gchar      *service,
+                                                         const gchar      *endpoint,
+                                                         const gchar      *checksum,
+                                                         const gchar      *link);
+
+#endif
@@ -18,8 +18,18 @@
  */
 
 #include "screenshooter-utils.h"
+#include "screenshooter-ipfs.h"
+#include "screenshooter-job.h"
+#include "screenshooter-s3.h"
+#include "screenshooter-upload.h"
+#include <glib/gstdio.h>
 #include <libxfce4ui/libxfce4ui.h>
 
+/* Screenshots still on their way: captures, dialogs and uploads */
+static guint       hold_count = 0;
+static GSourceFunc released_func = NULL;
+static gpointer    released_data = NULL;
+
 
 /* Public */
 
@@ -60,10 +70,37 @@ screenshooter_read_rc_file (const gchar *file, ScreenshotData *sd)
   gint action = SAVE;
   gint show_mouse = 1;
   gboolean timestamp = TRUE;
+  gboolean trim = FALSE;
   gchar *screenshot_dir = g_strdup (default_uri);
   gchar *title = g_strdup (_("Screenshot"));
   gchar *app = g_strdup ("none");
   gchar *last_user = g_strdup ("");
+  gchar *ipfs_api_url = g_strdup ("");
+  gboolean ipfs_pin = TRUE;
+  gint ipfs_cid_version = 0;
+  gboolean ipfs_raw_leaves = FALSE;
+  gchar *ipfs_chunker = g_strdup ("");
+  gchar *ipfs_gateways = g_strdup ("");
+  gint max_upload_bytes = 0;
+  gint upload_rate = 0;
+  gchar *s3_endpoint = g_strdup ("");
+  gchar *s3_bucket = g_strdup ("");
+  gchar *s3_region = g_strdup ("");
+  gchar *s3_access_key = g_strdup ("");
+  /* Never read from the rc file, the secret key is only taken from
+   * AWS_SECRET_ACCESS_KEY */
+  gchar *s3_secret_key = g_strdup ("");
+  gchar *s3_prefix = g_strdup ("");
+  gchar *s3_public_url = g_strdup ("");
+  gint s3_part_size = 8;
+  gint s3_jobs = 4;
+  gint pipeline_depth = 4;
+  gint upload_jobs = 4;
+  gchar *overflow_policy = g_strdup ("drop-oldest");
+  gboolean hotkeys = FALSE;
+  gchar *hotkey_fullscreen = g_strdup ("Print");
+  gchar *hotkey_window = g_strdup ("<Alt>Print");
+  gchar *hotkey_region = g_strdup ("<Shift>Print");
 
   if (G_LIKELY (file != NULL))
     {
@@ -80,6 +117,7 @@ screenshooter_read_rc_file (const gchar *file, ScreenshotData *sd)
           action = xfce_rc_read_int_entry (rc, "action", SAVE);
           show_mouse = xfce_rc_read_int_entry (rc, "show_mouse", 1);
           timestamp = xfce_rc_read_bool_entry (rc, "timestamp", TRUE);
+          trim = xfce_rc_read_bool_entry (rc, "trim", FALSE);
 
           g_free (app);
           app = g_strdup (xfce_rc_read_entry (rc, "app", "none"));
@@ -87,6 +125,66 @@ screenshooter_read_rc_file (const gchar *file, ScreenshotData *sd)
           g_free (last_user);
           last_user = g_strdup (xfce_rc_read_entry (rc, "last_user", ""));
 
+          /* Local IPFS node, the relay is used if the API is not set */
+          g_free (ipfs_api_url);
+          ipfs_api_url = g_strdup (xfce_rc_read_entry (rc, "ipfs_api_url", ""));
+          ipfs_pin = xfce_rc_read_bool_entry (rc, "ipfs_pin", TRUE);
+          ipfs_cid_version = xfce_rc_read_int_entry (rc, "ipfs_cid_version", 0);
+          ipfs_raw_leaves = xfce_rc_read_bool_entry (rc, "ipfs_raw_leaves", FALSE);
+
+          g_free (ipfs_chunker);
+          ipfs_chunker = g_strdup (xfce_rc_read_entry (rc, "ipfs_chunker", ""));
+
+          /* Gateways of the links, separated by semicolons */
+          g_free (ipfs_gateways);
+          ipfs_gateways = g_strdup (xfce_rc_read_entry (rc, "ipfs_gateways", ""));
+
+          /* Uploads are re-encoded to fit, 0 disables it */
+          max_upload_bytes = xfce_rc_read_int_entry (rc, "max_upload_bytes", 0);
+
+          /* Upload rate limit in KB/s, 0 for none */
+          upload_rate = xfce_rc_read_int_entry (rc, "upload_rate", 0);
+
+          /* S3-compatible storage, the credentials may come from the
+           * environment */
+          g_free (s3_endpoint);
+          s3_endpoint = g_strdup (xfce_rc_read_entry (rc, "s3_endpoint", ""));
+          g_free (s3_bucket);
+          s3_bucket = g_strdup (xfce_rc_read_entry (rc, "s3_bucket", ""));
+          g_free (s3_region);
+          s3_region = g_strdup (xfce_rc_read_entry (rc, "s3_region", ""));
+          g_free (s3_access_key);
+          s3_access_key = g_strdup (xfce_rc_read_entry (rc, "s3_access_key", ""));
+          g_free (s3_prefix);
+          s3_prefix = g_strdup (xfce_rc_read_entry (rc, "s3_prefix", ""));
+          g_free (s3_public_url);
+          s3_public_url = g_strdup (xfce_rc_read_entry (rc, "s3_public_url", ""));
+          s3_part_size = xfce_rc_read_int_entry (rc, "s3_part_size", 8);
+          s3_jobs = xfce_rc_read_int_entry (rc, "s3_jobs", 4);
+
+          /* Uploads running at the same time, apart from the encodes */
+          upload_jobs = xfce_rc_read_int_entry (rc, "upload_jobs", 4);
+
+          /* Screenshots held by each stage of the pipeline, and what
+           * happens when one is full: drop-oldest, drop-newest or block */
+          pipeline_depth = xfce_rc_read_int_entry (rc, "pipeline_depth", 4);
+          g_free (overflow_policy);
+          overflow_policy =
+            g_strdup (xfce_rc_read_entry (rc, "overflow_policy", "drop-oldest"));
+
+          /* Hotkeys grabbed by the panel plugin itself, instead of the
+           * keyboard shortcuts running the application */
+          hotkeys = xfce_rc_read_bool_entry (rc, "hotkeys", FALSE);
+          g_free (hotkey_fullscreen);
+          hotkey_fullscreen =
+            g_strdup (xfce_rc_read_entry (rc, "hotkey_fullscreen", "Print"));
+          g_free (hotkey_window);
+          hotkey_window =
+            g_strdup (xfce_rc_read_entry (rc, "hotkey_window", "<Alt>Print"));
+          g_free (hotkey_region);
+          hotkey_region =
+            g_strdup (xfce_rc_read_entry (rc, "hotkey_region", "<Shift>Print"));
+
           g_free (screenshot_dir);
           screenshot_dir =
             g_strdup (xfce_rc_read_entry (rc, "screenshot_dir", default_uri));
@@ -109,11 +207,41 @@ screenshooter_read_rc_file (const gchar *file, ScreenshotData *sd)
   sd->action = action;
   sd->show_mouse = show_mouse;
   sd->timestamp = timestamp;
+  sd->trim = trim;
   sd->screenshot_dir = screenshot_dir;
   sd->title = title;
   sd->app = app;
   sd->app_info = NULL;
   sd->last_user = last_user;
+  sd->ipfs_api_url = ipfs_api_url;
+  sd->ipfs_pin = ipfs_pin;
+  sd->ipfs_cid_version = ipfs_cid_version;
+  sd->ipfs_raw_leaves = ipfs_raw_leaves;
+  sd->ipfs_chunker = ipfs_chunker;
+  sd->ipfs_gateways = ipfs_gateways;
+  sd->max_upload_bytes = max_upload_bytes;
+  sd->upload_rate = upload_rate;
+  sd->s3_endpoint = s3_endpoint;
+  sd->s3_bucket = s3_bucket;
+  sd->s3_region = s3_region;
+  sd->s3_access_key = s3_access_key;
+  sd->s3_secret_key = s3_secret_key;
+  sd->s3_prefix = s3_prefix;
+  sd->s3_public_url = s3_public_url;
+  sd->s3_part_size = s3_part_size;
+  sd->s3_jobs = s3_jobs;
+  sd->pipeline_depth = pipeline_depth;
+  sd->upload_jobs = upload_jobs;
+  sd->overflow_policy = overflow_policy;
+  sd->hotkeys = hotkeys;
+  sd->hotkey_fullscreen = hotkey_fullscreen;
+  sd->hotkey_window = hotkey_window;
+  sd->hotkey_region = hotkey_region;
+
+  screenshooter_ipfs_set_gateways (ipfs_gateways);
+  screenshooter_upload_set_rate_limit (MAX (upload_rate, 0));
+  screenshooter_s3_set_config (sd);
+  screenshooter_job_set_upload_slots (MAX (upload_jobs, 1));
 }
 
 
@@ -140,9 +268,35 @@ screenshooter_write_rc_file (const gchar *file, ScreenshotData *sd)
   xfce_rc_write_int_entry (rc, "delay", sd->delay);
   xfce_rc_write_int_entry (rc, "region", sd->region);
   xfce_rc_write_int_entry (rc, "show_mouse", sd->show_mouse);
+  xfce_rc_write_bool_entry (rc, "trim", sd->trim);
   xfce_rc_write_entry (rc, "screenshot_dir", sd->screenshot_dir);
   xfce_rc_write_entry (rc, "app", sd->app);
   xfce_rc_write_entry (rc, "last_user", sd->last_user);
+  xfce_rc_write_entry (rc, "ipfs_api_url", sd->ipfs_api_url);
+  xfce_rc_write_bool_entry (rc, "ipfs_pin", sd->ipfs_pin);
+  xfce_rc_write_int_entry (rc, "ipfs_cid_version", sd->ipfs_cid_version);
+  xfce_rc_write_bool_entry (rc, "ipfs_raw_leaves", sd->ipfs_raw_leaves);
+  xfce_rc_write_entry (rc, "ipfs_chunker", sd->ipfs_chunker);
+  xfce_rc_write_entry (rc, "ipfs_gateways", sd->ipfs_gateways);
+  xfce_rc_write_int_entry (rc, "max_upload_bytes", sd->max_upload_bytes);
+  xfce_rc_write_int_entry (rc, "upload_rate", sd->upload_rate);
+  xfce_rc_write_entry (rc, "s3_endpoint", sd->s3_endpoint);
+  xfce_rc_write_entry (rc, "s3_bucket", sd->s3_bucket);
+  xfce_rc_write_entry (rc, "s3_region", sd->s3_region);
+  xfce_rc_write_entry (rc, "s3_access_key", sd->s3_access_key);
+  /* The secret key is not stored, drop the one older versions wrote */
+  xfce_rc_delete_entry (rc, "s3_secret_key", FALSE);
+  xfce_rc_write_entry (rc, "s3_prefix", sd->s3_prefix);
+  xfce_rc_write_entry (rc, "s3_public_url", sd->s3_public_url);
+  xfce_rc_write_int_entry (rc, "s3_part_size", sd->s3_part_size);
+  xfce_rc_write_int_entry (rc, "s3_jobs", sd->s3_jobs);
+  xfce_rc_write_int_entry (rc, "pipeline_depth", sd->pipeline_depth);
+  xfce_rc_write_int_entry (rc, "upload_jobs", sd->upload_jobs);
+  xfce_rc_write_entry (rc, "overflow_policy", sd->overflow_policy);
+  xfce_rc_write_bool_entry (rc, "hotkeys", sd->hotkeys);
+  xfce_rc_write_entry (rc, "hotkey_fullscreen", sd->hotkey_fullscreen);
+  xfce_rc_write_entry (rc, "hotkey_window", sd->hotkey_window);
+  xfce_rc_write_entry (rc, "hotkey_region", sd->hotkey_region);
 
   /* do not save if the action was specified from cli */
   if (!sd->action_specified)
@@ -150,6 +304,10 @@ screenshooter_write_rc_file (const gchar *file, ScreenshotData *sd)
 
   TRACE ("Flush and close the rc file");
   xfce_rc_close (rc);
+
+  /* It holds the S3 access key and the upload addresses */
+  if (g_chmod (file, 0600) != 0)
+    TRACE ("Could not restrict the permissions of %s", file);
 }
 
 
@@ -339,3 +497,52 @@ screenshooter_f1_key (GtkWidget *widget, GdkEventKey *event, gpointer user_data)
 
   return FALSE;
 }
+
+
+
+/**
+ * screenshooter_hold:
+ *
+ * Tells that a screenshot is being taken or acted on: a capture is in
+ * progress, a dialog is open or an upload runs. Each call is balanced by
+ * a call to screenshooter_release() once it is done.
+ **/
+void
+screenshooter_hold (void)
+{
+  hold_count++;
+}
+
+
+
+/**
+ * screenshooter_release:
+ *
+ * Balances a call to screenshooter_hold(). The function set with
+ * screenshooter_set_released_func() is called when nothing is held
+ * anymore.
+ **/
+void
+screenshooter_release (void)
+{
+  g_return_if_fail (hold_count > 0);
+
+  if (--hold_count == 0 && released_func != NULL)
+    (*released_func) (released_data);
+}
+
+
+
+/**
+ * screenshooter_set_released_func:
+ * @func: the function called when the last hold is released, or %NULL.
+ * @user_data: the data passed to @func.
+ *
+ * The application quits there, the panel plugin keeps running.
+ **/
+void
+screenshooter_set_released_func (GSourceFunc func, gpointer user_data)
+{
+  released_func = func;
+  released_data = user_data;
+}
@@ -55,5 +55,9 @@ void      screenshooter_open_help             (GtkWindow      *parent);
 gboolean  screenshooter_f1_key                (GtkWidget      *widget,
                                                GdkEventKey    *event,
                                                gpointer        user_data);
+void      screenshooter_hold                  (void);
+void      screenshooter_release               (void);
+void      screenshooter_set_released_func     (GSourceFunc     func,
+                                               gpointer        user_data);
 
 #endif
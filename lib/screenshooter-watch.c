@@ -0,0 +1,457 @@
+/*  $Id$
+ *
+ *  Copyright © 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ * */
+
+#include "screenshooter-watch.h"
+#include "screenshooter-capture.h"
+#include "screenshooter-utils.h"
+
+#include <signal.h>
+#include <string.h>
+
+#include <glib-unix.h>
+#include <libxfce4util/libxfce4util.h>
+
+#ifdef HAVE_XDAMAGE
+#include <X11/extensions/Xdamage.h>
+
+/* The frame is grabbed and compared in squares of this size */
+#define WATCH_TILE_SIZE 64
+
+/* Time during which the damage is accumulated after the first event, so
+ * that a repaint in several steps gives a single screenshot */
+#define WATCH_SETTLE_MS 100
+
+
+
+typedef struct
+{
+  GMainLoop       *loop;
+  GdkWindow       *root;
+  Display         *display;
+  Damage           damage;
+  gint             damage_event;
+  GdkRectangle     area;
+  gchar           *directory;
+  const gchar     *title;
+  guint            count;
+
+  /* The last state of the area, only its damaged tiles are grabbed again */
+  cairo_surface_t *frame;
+  cairo_pattern_t *source;
+  gint             n_columns;
+  gint             n_rows;
+  guint8          *dirty;
+  guint64         *hashes;
+  guint            settle_id;
+
+  guint            n_screenshots;
+  guint            n_events;
+  guint            n_tiles;
+  guint            n_unchanged;
+  gboolean         success;
+} WatchData;
+
+
+
+/* Internals */
+
+
+
+static void
+get_tile (WatchData *data, gint column, gint row, GdkRectangle *tile)
+{
+  tile->x = column * WATCH_TILE_SIZE;
+  tile->y = row * WATCH_TILE_SIZE;
+  tile->width = MIN (WATCH_TILE_SIZE, data->area.width - tile->x);
+  tile->height = MIN (WATCH_TILE_SIZE, data->area.height - tile->y);
+}
+
+
+
+/* FNV-1a of the pixels of a tile of the frame */
+static guint64
+hash_tile (WatchData *data, const GdkRectangle *tile)
+{
+  const guchar *pixels = cairo_image_surface_get_data (data->frame);
+  gint stride = cairo_image_surface_get_stride (data->frame);
+  guint64 hash = G_GUINT64_CONSTANT (14695981039346656037);
+  gint x, y;
+
+  for (y = tile->y; y < tile->y + tile->height; y++)
+    {
+      const guchar *p = pixels + y * stride + tile->x * 4;
+
+      for (x = 0; x < tile->width * 4; x++)
+        {
+          hash ^= p[x];
+          hash *= G_GUINT64_CONSTANT (1099511628211);
+        }
+    }
+
+  return hash;
+}
+
+
+
+/* Marks the tiles covered by @rectangle, in root window coordinates */
+static void
+mark_damaged (WatchData *data, const GdkRectangle *rectangle)
+{
+  GdkRectangle damaged;
+  gint column, row;
+
+  if (!gdk_rectangle_intersect (rectangle, &data->area, &damaged))
+    return;
+
+  damaged.x -= data->area.x;
+  damaged.y -= data->area.y;
+
+  for (row = damaged.y / WATCH_TILE_SIZE;
+       row <= (damaged.y + damaged.height - 1) / WATCH_TILE_SIZE; row++)
+    for (column = damaged.x / WATCH_TILE_SIZE;
+         column <= (damaged.x + damaged.width - 1) / WATCH_TILE_SIZE; column++)
+      data->dirty[row * data->n_columns + column] = TRUE;
+}
+
+
+
+static void
+write_frame (WatchData *data)
+{
+  cairo_status_t status;
+  gchar *datetime, *name, *path;
+
+  datetime = screenshooter_get_datetime ("%Y-%m-%d_%H-%M-%S");
+  name = g_strdup_printf ("%s_%s_%05u.png", data->title, datetime, data->n_screenshots);
+  path = g_build_filename (data->directory, name, NULL);
+
+  status = cairo_surface_write_to_png (data->frame, path);
+
+  if (status == CAIRO_STATUS_SUCCESS)
+    g_print ("%s\n", path);
+  else
+    {
+      g_printerr ("%s\terror: %s\n", path, cairo_status_to_string (status));
+      data->success = FALSE;
+    }
+
+  data->n_screenshots++;
+
+  if (data->count > 0 && data->n_screenshots >= data->count)
+    g_main_loop_quit (data->loop);
+
+  g_free (datetime);
+  g_free (name);
+  g_free (path);
+}
+
+
+
+/* Grabs the damaged tiles again, and writes the frame if one of them
+ * really changed */
+static gboolean
+cb_settled (WatchData *data)
+{
+  GdkRectangle tile;
+  gboolean changed = FALSE;
+  cairo_t *cr;
+  gint i;
+
+  data->settle_id = 0;
+
+  cr = cairo_create (data->frame);
+  cairo_set_source (cr, data->source);
+  cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+
+  for (i = 0; i < data->n_columns * data->n_rows; i++)
+    if (data->dirty[i])
+      {
+        get_tile (data, i % data->n_columns, i / data->n_columns, &tile);
+        cairo_rectangle (cr, tile.x, tile.y, tile.width, tile.height);
+        data->n_tiles++;
+      }
+
+  cairo_fill (cr);
+  cairo_destroy (cr);
+  cairo_surface_flush (data->frame);
+
+  for (i = 0; i < data->n_columns * data->n_rows; i++)
+    if (data->dirty[i])
+      {
+        guint64 hash;
+
+        get_tile (data, i % data->n_columns, i / data->n_columns, &tile);
+        hash = hash_tile (data, &tile);
+
+        if (hash != data->hashes[i])
+          {
+            data->hashes[i] = hash;
+            changed = TRUE;
+          }
+
+        data->dirty[i] = FALSE;
+      }
+
+  /* Damaged, but repainted as it was */
+  if (!changed)
+    data->n_unchanged++;
+  else
+    write_frame (data);
+
+  return FALSE;
+}
+
+
+
+static GdkFilterReturn
+filter_damage (GdkXEvent *gdk_xevent, GdkEvent *event, WatchData *data)
+{
+  XDamageNotifyEvent *xevent = (XDamageNotifyEvent *) gdk_xevent;
+  GdkRectangle rectangle;
+
+  if (xevent->type != data->damage_event + XDamageNotify ||
+      xevent->damage != data->damage)
+    return GDK_FILTER_CONTINUE;
+
+  data->n_events++;
+
+  /* The damage is on the root window, in its coordinates */
+  rectangle.x = xevent->area.x;
+  rectangle.y = xevent->area.y;
+  rectangle.width = xevent->area.width;
+  rectangle.height = xevent->area.height;
+
+  mark_damaged (data, &rectangle);
+
+  if (data->settle_id == 0)
+    data->settle_id = g_timeout_add (WATCH_SETTLE_MS, (GSourceFunc) cb_settled, data);
+
+  return GDK_FILTER_REMOVE;
+}
+
+
+
+static gboolean
+cb_interrupted (WatchData *data)
+{
+  g_main_loop_quit (data->loop);
+
+  return TRUE;
+}
+
+
+
+static void
+start_watching (WatchData *data)
+{
+  GdkRectangle screen;
+  cairo_t *cr;
+  gint n_tiles;
+
+  screen.x = 0;
+  screen.y = 0;
+  screen.width = gdk_window_get_width (data->root);
+  screen.height = gdk_window_get_height (data->root);
+
+  if (!gdk_rectangle_intersect (&data->area, &screen, &data->area))
+    {
+      g_printerr (_("The captured area is off the screen.\n"));
+      g_main_loop_quit (data->loop);
+      return;
+    }
+
+  TRACE ("Watch %dx%d+%d+%d", data->area.width, data->area.height,
+         data->area.x, data->area.y);
+
+  data->frame = cairo_image_surface_create (CAIRO_FORMAT_RGB24,
+                                            data->area.width, data->area.height);
+
+  /* The pattern of the root window is set up once for all the grabs */
+  cr = cairo_create (data->frame);
+  gdk_cairo_set_source_window (cr, data->root, -data->area.x, -data->area.y);
+  data->source = cairo_pattern_reference (cairo_get_source (cr));
+  cairo_destroy (cr);
+
+  data->n_columns = (data->area.width + WATCH_TILE_SIZE - 1) / WATCH_TILE_SIZE;
+  data->n_rows = (data->area.height + WATCH_TILE_SIZE - 1) / WATCH_TILE_SIZE;
+  n_tiles = data->n_columns * data->n_rows;
+  data->dirty = g_new (guint8, n_tiles);
+  data->hashes = g_new0 (guint64, n_tiles);
+  data->success = TRUE;
+
+  /* Report every damaged rectangle, they are accumulated in the tiles */
+  data->damage = XDamageCreate (data->display, GDK_WINDOW_XID (data->root),
+                                XDamageReportRawRectangles);
+  gdk_window_add_filter (NULL, (GdkFilterFunc) filter_damage, data);
+
+  /* The whole area makes the first screenshot */
+  memset (data->dirty, TRUE, n_tiles);
+  cb_settled (data);
+}
+
+
+
+/* The window or the region was captured once, to learn its area */
+static void
+cb_area_captured (GObject *source, GAsyncResult *result, WatchData *data)
+{
+  ScreenshooterCapture *capture;
+  GError *error = NULL;
+
+  capture = screenshooter_capture_finish (result, &error);
+
+  if (capture == NULL)
+    {
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        g_printerr ("%s\n", error->message);
+
+      g_error_free (error);
+      g_main_loop_quit (data->loop);
+      return;
+    }
+
+  data->area = capture->area;
+  screenshooter_capture_free (capture);
+
+  start_watching (data);
+}
+#endif
+
+
+
+/* Public */
+
+
+
+/**
+ * screenshooter_watch_capture:
+ * @sd: the #ScreenshotData holding the save directory and the title.
+ * @region: FULLSCREEN, ACTIVE_WINDOW or SELECT.
+ * @count: the number of screenshots, 0 to go on until SIGINT or SIGTERM.
+ *
+ * Takes a screenshot of @region in the save directory of @sd each time
+ * it changes. The window is picked, or the region selected, once.
+ *
+ * The damage reported by the X server is accumulated in tiles of the
+ * area for a short while, then only the damaged tiles are grabbed again
+ * into the last frame. A screenshot is only written when the hash of one
+ * of them changed, not when a part of the screen is repainted as it was.
+ * The first screenshot is the whole area when the watch starts.
+ *
+ * Return value: %FALSE if the display does not support the XDamage
+ * extension, nothing could be watched or some screenshots could not be
+ * written.
+ **/
+gboolean
+screenshooter_watch_capture (const ScreenshotData *sd,
+                             gint                  region,
+                             guint                 count)
+{
+#ifdef HAVE_XDAMAGE
+  WatchData data = { 0 };
+  GdkDisplay *display;
+  gint error_base;
+  guint term_id, int_id;
+
+  g_return_val_if_fail (sd != NULL, FALSE);
+
+  display = gdk_display_get_default ();
+  data.display = GDK_DISPLAY_XDISPLAY (display);
+
+  if (!XDamageQueryExtension (data.display, &data.damage_event, &error_base))
+    {
+      g_printerr (_("The display does not support the XDamage extension.\n"));
+      return FALSE;
+    }
+
+  data.directory = g_filename_from_uri (sd->screenshot_dir, NULL, NULL);
+
+  if (data.directory == NULL || !g_file_test (data.directory, G_FILE_TEST_IS_DIR))
+    {
+      g_printerr (_("%s is not a valid local directory.\n"), sd->screenshot_dir);
+      g_free (data.directory);
+      return FALSE;
+    }
+
+  data.root = gdk_get_default_root_window ();
+  data.title = sd->title;
+  data.count = count;
+  data.loop = g_main_loop_new (NULL, FALSE);
+
+  if (region == SELECT)
+    {
+      ScreenshooterCaptureRequest *request =
+        screenshooter_capture_request_new (region, 0, FALSE);
+
+      screenshooter_capture_async (request, NULL,
+                                   (GAsyncReadyCallback) cb_area_captured, &data);
+      screenshooter_capture_request_unref (request);
+    }
+  else if (screenshooter_capture_get_area (region, &data.area))
+    start_watching (&data);
+  else
+    {
+      g_printerr (_("The captured area is off the screen.\n"));
+      g_main_loop_unref (data.loop);
+      g_free (data.directory);
+      return FALSE;
+    }
+
+  term_id = g_unix_signal_add (SIGTERM, (GSourceFunc) cb_interrupted, &data);
+  int_id = g_unix_signal_add (SIGINT, (GSourceFunc) cb_interrupted, &data);
+
+  /* The first screenshot may have been the last one */
+  if (count == 0 || data.n_screenshots < count)
+    g_main_loop_run (data.loop);
+
+  g_source_remove (term_id);
+  g_source_remove (int_id);
+
+  if (data.frame != NULL)
+    {
+      gdk_window_remove_filter (NULL, (GdkFilterFunc) filter_damage, &data);
+
+      gdk_x11_display_error_trap_push (display);
+      XDamageDestroy (data.display, data.damage);
+      gdk_x11_display_error_trap_pop_ignored (display);
+
+      if (data.settle_id != 0)
+        g_source_remove (data.settle_id);
+
+      g_print (_("%u screenshots, %u damage events, %u tiles grabbed,"
+                 " %u repaints without change\n"),
+               data.n_screenshots, data.n_events, data.n_tiles, data.n_unchanged);
+
+      cairo_pattern_destroy (data.source);
+      cairo_surface_destroy (data.frame);
+      g_free (data.dirty);
+      g_free (data.hashes);
+    }
+
+  g_main_loop_unref (data.loop);
+  g_free (data.directory);
+
+  return data.success;
+#else
+  g_printerr (_("%s was built without XDamage support, the watch mode is not"
+                " available.\n"), PACKAGE_NAME);
+
+  return FALSE;
+#endif
+}
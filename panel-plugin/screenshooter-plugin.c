@@ -49,6 +49,9 @@ typedef struct
 
   int style_id;
   ScreenshotData *sd;
+
+  /* Global hotkeys grabbed by the plugin */
+  ScreenshooterHotkeys *hotkeys;
 }
 PluginData;
 
@@ -102,6 +105,13 @@ cb_style_set                         (XfcePanelPlugin      *plugin,
 static void
 set_panel_button_tooltip             (PluginData           *pd);
 
+static void
+cb_hotkey_pressed                    (gint                  region,
+                                      PluginData           *pd);
+
+static void
+grab_hotkeys                         (PluginData           *pd);
+
 
 
 /* Internal functions */
@@ -165,11 +175,31 @@ cb_free_data (XfcePanelPlugin *plugin, PluginData *pd)
     g_signal_handler_disconnect (plugin, pd->style_id);
 
   pd->style_id = 0;
+
+  if (pd->hotkeys != NULL)
+    screenshooter_hotkeys_free (pd->hotkeys);
+
   g_free (pd->sd->screenshot_dir);
   g_free (pd->sd->title);
   g_free (pd->sd->app);
   g_free (pd->sd->last_user);
+  g_free (pd->sd->ipfs_api_url);
+  g_free (pd->sd->ipfs_chunker);
+  g_free (pd->sd->ipfs_gateways);
+  g_free (pd->sd->s3_endpoint);
+  g_free (pd->sd->s3_bucket);
+  g_free (pd->sd->s3_region);
+  g_free (pd->sd->s3_access_key);
+  g_free (pd->sd->s3_secret_key);
+  g_free (pd->sd->s3_prefix);
+  g_free (pd->sd->s3_public_url);
+  g_free (pd->sd->overflow_policy);
+  g_free (pd->sd->hotkey_fullscreen);
+  g_free (pd->sd->hotkey_window);
+  g_free (pd->sd->hotkey_region);
   g_free (pd->sd);
+
+  screenshooter_spool_stop ();
   g_free (pd);
 }
 
@@ -182,16 +212,61 @@ pd: the PluginData storing the options for taking the screenshot.
 static void
 cb_button_clicked (GtkWidget *button, PluginData *pd)
 {
-  /* Make the button unclickable so that the user does not press it while
-	another screenshot is in progress */
-  gtk_widget_set_sensitive (GTK_WIDGET (button), FALSE);
-
   TRACE ("Start taking the screenshot");
 
+  /* This returns right away, the capture and the actions go on from the
+  main loop. The button stays clickable, so that more screenshots can be
+  taken while the dialogs of the previous ones are open or their uploads
+  run. */
   screenshooter_take_screenshot_idle (pd->sd);
+}
+
+
+
+/* Take a screenshot of the region of the hotkey pressed, with the other
+options of the panel button. Called from the X event filter, the capture
+only reads the region before returning.
+*/
+static void
+cb_hotkey_pressed (gint region, PluginData *pd)
+{
+  gint button_region = pd->sd->region;
 
-  /* Make the panel button clickable */
-  gtk_widget_set_sensitive (GTK_WIDGET (button), TRUE);
+  pd->sd->region = region;
+  cb_button_clicked (pd->button, pd);
+  pd->sd->region = button_region;
+}
+
+
+
+/* Grab the hotkeys set in the preferences, those already used by another
+application are skipped.
+pd: the PluginData.
+*/
+static void
+grab_hotkeys (PluginData *pd)
+{
+  const gchar *accelerators[] = { pd->sd->hotkey_fullscreen,
+                                  pd->sd->hotkey_window,
+                                  pd->sd->hotkey_region };
+  const gint regions[] = { FULLSCREEN, ACTIVE_WINDOW, SELECT };
+  guint i;
+
+  pd->hotkeys = screenshooter_hotkeys_new ((ScreenshooterHotkeyFunc) cb_hotkey_pressed, pd);
+
+  for (i = 0; i < G_N_ELEMENTS (regions); i++)
+    {
+      GError *error = NULL;
+
+      if (accelerators[i] == NULL || *accelerators[i] == '\0')
+        continue;
+
+      if (!screenshooter_hotkeys_bind (pd->hotkeys, accelerators[i], regions[i], &error))
+        {
+          g_warning ("%s", error->message);
+          g_error_free (error);
+        }
+    }
 }
 
 
@@ -388,6 +463,16 @@ screenshooter_plugin_construct (XfcePanelPlugin *plugin)
   /* We want the actions dialog to be always displayed */
   pd->sd->action_specified = FALSE;
 
+  /* Upload the screenshots queued while the network was unavailable */
+  screenshooter_spool_start (NULL, NULL);
+
+  /* Capture on the hotkeys without spawning the application */
+  if (pd->sd->hotkeys)
+    {
+      TRACE ("Grab the hotkeys");
+      grab_hotkeys (pd);
+    }
+
   /* Create the panel button */
   TRACE ("Create the panel button");
   pd->button = xfce_create_panel_button ();
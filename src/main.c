@@ -36,20 +36,50 @@ gboolean mouse = FALSE;
 gboolean clipboard = FALSE;
 gboolean upload_imgur = FALSE;
 gboolean upload_ipfs = FALSE;
+gboolean upload_s3 = FALSE;
+gboolean trim = FALSE;
+gboolean stats = FALSE;
+gboolean upload_queue = FALSE;
+gboolean service = FALSE;
+gchar *upload_dir = NULL;
+gchar *target = NULL;
+gint jobs = 4;
+gint max_upload_bytes = -1;
+gint upload_rate = -1;
 gchar *screenshot_dir = NULL;
 gchar *application = NULL;
 gint delay = 0;
+gint interval = 0;
+gint count = 0;
+gint burst = 0;
+gint burst_interval = 0;
+gboolean watch = FALSE;
 
 
 
 /* Set cli options. */
 static GOptionEntry entries[] =
 {
+  {
+    "burst", 0, G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_INT, &burst,
+    N_("Take N screenshots in a row, then choose which ones to keep"),
+    N_("N")
+  },
+  {
+    "burst-interval", 0, G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_INT, &burst_interval,
+    N_("Time between the screenshots of --burst, 0 to take them as fast as possible"),
+    N_("MS")
+  },
   {
     "clipboard", 'c', G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_NONE, &clipboard,
     N_("Copy the screenshot to the clipboard"),
     NULL
   },
+  {
+    "count", 'n', G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_INT, &count,
+    N_("Number of screenshots taken with --interval or --watch, 0 to go on until interrupted"),
+    NULL
+  },
   {
     "delay", 'd', G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_INT, &delay,
     N_("Delay in seconds before taking the screenshot"),
@@ -60,6 +90,21 @@ static GOptionEntry entries[] =
     N_("Take a screenshot of the entire screen"),
     NULL
   },
+  {
+    "interval", 0, G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_INT, &interval,
+    N_("Take a screenshot every MS milliseconds in the save directory, then exit"),
+    N_("MS")
+  },
+  {
+    "jobs", 'j', G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_INT, &jobs,
+    N_("Number of files uploaded at the same time with --upload-dir"),
+    NULL
+  },
+  {
+    "max-upload-bytes", 0, G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_INT, &max_upload_bytes,
+    N_("Re-encode the uploaded screenshot to fit in this many bytes, 0 to upload it as is"),
+    N_("BYTES")
+  },
   {
     "mouse", 'm', G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_NONE, &mouse,
     N_("Display the mouse on the screenshot"),
@@ -88,15 +133,60 @@ static GOptionEntry entries[] =
     NULL
   },
   {
-    "ipfs", 'i', G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_NONE, &upload_ipfs,
-    N_("Host the screenshot on Imgur, a free online image hosting service"),
+    "ipfs", 0, G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_NONE, &upload_ipfs,
+    N_("Host the screenshot on IPFS, can be combined with --imgur"),
     NULL
   },
+  {
+    "s3", 0, G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_NONE, &upload_s3,
+    N_("Store the screenshot in the S3-compatible storage set in the preferences"),
+    NULL
+  },
+  {
+    "service", 0, G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_NONE, &service,
+    N_("Run the resident capture service used by the next captures"),
+    NULL
+  },
+  {
+    "stats", 0, G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_NONE, &stats,
+    N_("Print the upload and job scheduling statistics on the standard error before exiting"),
+    NULL
+  },
+  {
+    "target", 0, G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_STRING, &target,
+    N_("Service used by --upload-dir: imgur, s3 or ipfs, the default"),
+    NULL
+  },
+  {
+    "trim", 't', G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_NONE, &trim,
+    N_("Crop the uniform borders of the captured window or region"),
+    NULL
+  },
+  {
+    "upload-dir", 0, G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_FILENAME, &upload_dir,
+    N_("Upload the images of a directory and print their links, then exit"),
+    NULL
+  },
+  {
+    "upload-queue", 0, G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_NONE, &upload_queue,
+    N_("Upload the screenshots queued while the network was unavailable, then exit"),
+    NULL
+  },
+  {
+    "upload-rate", 0, G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_INT, &upload_rate,
+    N_("Limit the upload rate to this many KB/s, 0 for no limit"),
+    N_("KB/s")
+  },
   {
     "version", 'V', G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_NONE, &version,
     N_("Version information"),
     NULL
   },
+  {
+    "watch", 0, G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_NONE, &watch,
+    N_("Take a screenshot in the save directory each time the screen changes"),
+    NULL
+  },
   {
     "window", 'w', G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_NONE, &window,
     N_("Take a screenshot of the active window"),
@@ -139,6 +229,73 @@ take_screenshot (ScreenshotData *sd, gboolean from_cli)
 
 
 
+/* Hands the capture over to the resident service, if it runs. Returns
+ * FALSE if it does not, the capture is then taken by this process. Only
+ * the options given are passed, the service uses its preferences for the
+ * others, as this process would. */
+static gboolean
+forward_to_service (gint *status)
+{
+  const gchar *region_name = window ? "window" : fullscreen ? "fullscreen" : "region";
+  const gchar *directory = screenshot_dir;
+  GError *error = NULL;
+  gchar *path;
+
+  /* As in process, an invalid directory falls back to the default one */
+  if (directory != NULL)
+    {
+      GFile *file = g_file_new_for_commandline_arg (directory);
+
+      if (!g_file_query_exists (file, NULL))
+        directory = NULL;
+
+      g_object_unref (file);
+    }
+
+  path = screenshooter_service_capture (region_name, delay, mouse, trim, clipboard,
+                                        screenshot_dir != NULL, directory, &error);
+
+  /* No service or no session bus */
+  if (path == NULL &&
+      (!g_dbus_error_is_remote_error (error) ||
+       g_error_matches (error, G_DBUS_ERROR, G_DBUS_ERROR_SERVICE_UNKNOWN) ||
+       g_error_matches (error, G_DBUS_ERROR, G_DBUS_ERROR_NAME_HAS_NO_OWNER)))
+    {
+      TRACE ("Capture in process: %s", error->message);
+      g_error_free (error);
+
+      return FALSE;
+    }
+
+  if (directory == NULL && screenshot_dir != NULL)
+    g_printerr (_("%s is not a valid directory, the default"
+                  " directory will be used.\n"), screenshot_dir);
+
+  if (path != NULL)
+    {
+      g_free (path);
+      *status = EXIT_SUCCESS;
+
+      return TRUE;
+    }
+
+  /* A cancelled selection is not an error, as when taken in process */
+  if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    *status = EXIT_SUCCESS;
+  else
+    {
+      g_dbus_error_strip_remote_error (error);
+      g_printerr ("%s\n", error->message);
+      *status = EXIT_FAILURE;
+    }
+
+  g_error_free (error);
+
+  return TRUE;
+}
+
+
+
 static void
 cb_dialog_response (GtkWidget *dialog, gint response, ScreenshotData *sd)
 {
@@ -167,8 +324,10 @@ cb_dialog_response (GtkWidget *dialog, gint response, ScreenshotData *sd)
 
 int main (int argc, char **argv)
 {
+  GOptionContext *context;
   GError *cli_error = NULL;
   GFile *default_save_dir;
+  gint rc_max_upload_bytes, rc_upload_rate;
   const gchar *rc_file;
   const gchar *conflict_error =
     _("Conflicting options: --%s and --%s cannot be used at the same time.\n");
@@ -183,23 +342,29 @@ int main (int argc, char **argv)
 
   xfce_textdomain (GETTEXT_PACKAGE, PACKAGE_LOCALE_DIR, "UTF-8");
 
+  /* The display is only opened once we know that the capture is not
+   * forwarded to the service */
+  context = g_option_context_new ("");
+  g_option_context_add_main_entries (context, entries, PACKAGE);
+  g_option_context_add_group (context, gtk_get_option_group (FALSE));
+
   /* Print a message to advise to use help when a non existing cli option is
   passed to the executable. */
-  if (!gtk_init_with_args(&argc, &argv, "", entries, PACKAGE, &cli_error))
+  if (!g_option_context_parse (context, &argc, &argv, &cli_error))
     {
-      if (cli_error != NULL)
-        {
-          g_print (_("%s: %s\nTry %s --help to see a full list of"
-                     " available command line options.\n"),
-                   PACKAGE, cli_error->message, PACKAGE_NAME);
+      g_print (_("%s: %s\nTry %s --help to see a full list of"
+                 " available command line options.\n"),
+               PACKAGE, cli_error->message, PACKAGE_NAME);
 
-          g_error_free (cli_error);
-          g_free (sd);
+      g_error_free (cli_error);
+      g_option_context_free (context);
+      g_free (sd);
 
-          return EXIT_FAILURE;
-        }
+      return EXIT_FAILURE;
     }
 
+  g_option_context_free (context);
+
   /* Exit if two region options were given */
   if (window && fullscreen)
     {
@@ -223,35 +388,28 @@ int main (int argc, char **argv)
       return EXIT_FAILURE;
     }
 
-  /* Exit if two actions options were given */
-  if ((application != NULL) && (screenshot_dir != NULL))
+  if (interval > 0 && burst > 0)
     {
-      g_printerr (conflict_error, "open", "save");
+      g_printerr (conflict_error, "interval", "burst");
 
       g_free (sd);
       return EXIT_FAILURE;
     }
-  else if (upload_imgur && (screenshot_dir != NULL))
+  else if (watch && interval > 0)
     {
-      g_printerr (conflict_error, "imgur", "save");
-      return EXIT_FAILURE;
-    }
-  else if (upload_imgur && (application != NULL))
-    {
-      g_printerr (conflict_error, "imgur", "open");
-      return EXIT_FAILURE;
-    }
+      g_printerr (conflict_error, "watch", "interval");
 
-  else if (upload_ipfs && (screenshot_dir != NULL))
-    {
-      g_printerr (conflict_error, "ipfs", "save");
+      g_free (sd);
       return EXIT_FAILURE;
     }
-  else if (upload_ipfs && (application != NULL))
+  else if (watch && burst > 0)
     {
-      g_printerr (conflict_error, "ipfs", "open");
+      g_printerr (conflict_error, "watch", "burst");
+
+      g_free (sd);
       return EXIT_FAILURE;
     }
+
   /* Warn that action options, mouse and delay will be ignored in
    * non-cli mode */
   if ((application != NULL) && !(fullscreen || window || region))
@@ -262,12 +420,16 @@ int main (int argc, char **argv)
     g_printerr (ignore_error, "imgur");
   if (upload_ipfs && !(fullscreen || window || region))
     g_printerr (ignore_error, "ipfs");
+  if (upload_s3 && !(fullscreen || window || region))
+    g_printerr (ignore_error, "s3");
   if (clipboard && !(fullscreen || window || region))
     g_printerr (ignore_error, "clipboard");
   if (delay && !(fullscreen || window || region))
     g_printerr (ignore_error, "delay");
   if (mouse && !(fullscreen || window || region))
     g_printerr (ignore_error, "mouse");
+  if (trim && !(fullscreen || window || region))
+    g_printerr (ignore_error, "trim");
 
   /* Just print the version if we are in version mode */
   if (version)
@@ -279,9 +441,113 @@ int main (int argc, char **argv)
       return EXIT_SUCCESS;
     }
 
+  /* Save or copy the screenshot in the resident service, the other
+   * actions need this process */
+  if ((fullscreen || window || region) && !service && interval <= 0 && burst <= 0 && !watch &&
+      application == NULL &&
+      !(upload_imgur || upload_ipfs || upload_s3) &&
+      (screenshot_dir != NULL || clipboard))
+    {
+      gint status;
+
+      if (forward_to_service (&status))
+        {
+          g_free (screenshot_dir);
+          g_free (sd);
+
+          return status;
+        }
+    }
+
+  gtk_init (&argc, &argv);
+
   /* Read the preferences */
   rc_file = xfce_resource_save_location (XFCE_RESOURCE_CONFIG, "xfce4/xfce4-screenshooter", TRUE);
   screenshooter_read_rc_file (rc_file, sd);
+  rc_max_upload_bytes = sd->max_upload_bytes;
+  rc_upload_rate = sd->upload_rate;
+
+  /* The budget and the rate given on the command line are not saved */
+  if (max_upload_bytes >= 0)
+    sd->max_upload_bytes = max_upload_bytes;
+
+  if (upload_rate >= 0)
+    {
+      sd->upload_rate = upload_rate;
+      screenshooter_upload_set_rate_limit (upload_rate);
+    }
+
+  /* Serve the captures until the service is stopped */
+  if (service)
+    {
+      if (!screenshooter_service_run (sd))
+        {
+          g_printerr (_("The capture service could not own its name on the session bus.\n"));
+          g_free (sd);
+
+          return EXIT_FAILURE;
+        }
+
+      g_free (sd);
+
+      return EXIT_SUCCESS;
+    }
+
+  /* Drain the upload queue and exit */
+  if (upload_queue)
+    {
+      if (!screenshooter_spool_start ((GSourceFunc) gtk_main_quit, NULL))
+        {
+          g_printerr (_("The upload queue is already being processed.\n"));
+          g_free (sd);
+
+          return EXIT_FAILURE;
+        }
+
+      gtk_main ();
+      screenshooter_spool_stop ();
+
+      if (stats)
+        {
+          gchar *summary = screenshooter_upload_get_stats ();
+
+          g_printerr ("%s", summary);
+          g_free (summary);
+        }
+
+      g_free (sd);
+
+      return EXIT_SUCCESS;
+    }
+
+  /* Upload a directory and exit */
+  if (upload_dir != NULL)
+    {
+      gint upload_target = UPLOAD_IPFS;
+      guint n_failed;
+
+      if (g_strcmp0 (target, "imgur") == 0)
+        upload_target = UPLOAD_IMGUR;
+      else if (g_strcmp0 (target, "s3") == 0)
+        upload_target = UPLOAD_S3;
+      else if (target != NULL && g_strcmp0 (target, "ipfs") != 0)
+        {
+          g_printerr (_("Unknown upload target %s, use imgur, ipfs or s3.\n"), target);
+          return EXIT_FAILURE;
+        }
+
+      n_failed = screenshooter_batch_upload (upload_dir, upload_target, jobs, sd);
+
+      if (stats)
+        {
+          gchar *summary = screenshooter_upload_get_stats ();
+
+          g_printerr ("%s", summary);
+          g_free (summary);
+        }
+
+      return n_failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
 
   /* Default to no action specified */
   sd->action_specified = FALSE;
@@ -297,6 +563,77 @@ int main (int argc, char **argv)
 
   g_object_unref (default_save_dir);
 
+  /* Take a screenshot at each interval and exit */
+  if (interval > 0)
+    {
+      gint interval_region = window ? ACTIVE_WINDOW : region ? SELECT : FULLSCREEN;
+      gboolean success;
+
+      if (screenshot_dir != NULL)
+        {
+          default_save_dir = g_file_new_for_commandline_arg (screenshot_dir);
+          g_free (sd->screenshot_dir);
+          sd->screenshot_dir = g_file_get_uri (default_save_dir);
+          g_object_unref (default_save_dir);
+          g_free (screenshot_dir);
+        }
+
+      success = screenshooter_interval_capture (sd, interval_region,
+                                                interval, MAX (count, 0));
+
+      g_free (sd);
+
+      return success ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+  /* Take a burst of screenshots and exit */
+  if (burst > 0)
+    {
+      gint burst_region = window ? ACTIVE_WINDOW : region ? SELECT : FULLSCREEN;
+      gboolean success;
+
+      if (screenshot_dir != NULL)
+        {
+          default_save_dir = g_file_new_for_commandline_arg (screenshot_dir);
+          g_free (sd->screenshot_dir);
+          sd->screenshot_dir = g_file_get_uri (default_save_dir);
+          g_object_unref (default_save_dir);
+          g_free (screenshot_dir);
+        }
+
+      success = screenshooter_burst_capture (sd, burst_region, delay, burst,
+                                             MAX (burst_interval, 0));
+
+      g_free (sd);
+
+      return success ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+  /* Take a screenshot at each change and exit */
+  if (watch)
+    {
+      gint watch_region = window ? ACTIVE_WINDOW : region ? SELECT : FULLSCREEN;
+      gboolean success;
+
+      if (screenshot_dir != NULL)
+        {
+          default_save_dir = g_file_new_for_commandline_arg (screenshot_dir);
+          g_free (sd->screenshot_dir);
+          sd->screenshot_dir = g_file_get_uri (default_save_dir);
+          g_object_unref (default_save_dir);
+          g_free (screenshot_dir);
+        }
+
+      success = screenshooter_watch_capture (sd, watch_region, MAX (count, 0));
+
+      g_free (sd);
+
+      return success ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+  /* Quit once the screenshot was taken and acted on */
+  screenshooter_set_released_func ((GSourceFunc) gtk_main_quit, NULL);
+
   /* If a region cli option is given, take the screenshot accordingly.*/
   if (fullscreen || window || region)
     {
@@ -313,37 +650,39 @@ int main (int argc, char **argv)
 
       sd->delay = delay;
 
-      if (application != NULL)
-        {
-          sd->app = application;
-          sd->action = OPEN;
-          sd->action_specified = TRUE;
-        }
-      else if (upload_imgur)
+      /* Whether to crop the uniform borders of the screenshot */
+      if (trim)
+        sd->trim = TRUE;
+
+      /* The actions given on the command line replace those loaded from
+       * the preferences, and are all run, e.g. -s DIR -i saves and uploads */
+      if (application != NULL || upload_imgur || upload_ipfs || upload_s3 ||
+          screenshot_dir != NULL || clipboard)
         {
-          sd->action = UPLOAD_IMGUR;
+          sd->action = NONE;
           sd->action_specified = TRUE;
         }
-	  else if (upload_ipfs)
-	  {
-		  sd->action = UPLOAD_IPFS;
-		  sd->action_specified = TRUE;
-	  }
-      else if (screenshot_dir != NULL)
+
+      if (application != NULL)
         {
-          sd->action = SAVE;
-          sd->action_specified = TRUE;
+          g_free (sd->app);
+          sd->app = application;
+          sd->action |= OPEN;
         }
 
-      if (clipboard)
-        {
-          /* if no other action was specified, reset the value loaded from prefs */
-          if (!sd->action_specified)
-            sd->action = NONE;
+      /* Several services can be given, they are uploaded to concurrently */
+      if (upload_imgur)
+        sd->action |= UPLOAD_IMGUR;
+      if (upload_ipfs)
+        sd->action |= UPLOAD_IPFS;
+      if (upload_s3)
+        sd->action |= UPLOAD_S3;
 
-          sd->action |= CLIPBOARD;
-          sd->action_specified = TRUE;
-        }
+      if (screenshot_dir != NULL)
+        sd->action |= SAVE;
+
+      if (clipboard)
+        sd->action |= CLIPBOARD;
 
       if (!sd->app)
         sd->app = g_strdup ("none");
@@ -386,13 +725,37 @@ int main (int argc, char **argv)
 
   gtk_main ();
 
+  if (stats)
+    {
+      gchar *summary = screenshooter_upload_get_stats ();
+
+      g_printerr ("%s", summary);
+      g_free (summary);
+    }
+
   /* Save preferences */
+  sd->max_upload_bytes = rc_max_upload_bytes;
+  sd->upload_rate = rc_upload_rate;
   screenshooter_write_rc_file (rc_file, sd);
 
   g_free (sd->screenshot_dir);
   g_free (sd->title);
   g_free (sd->app);
   g_free (sd->last_user);
+  g_free (sd->ipfs_api_url);
+  g_free (sd->ipfs_chunker);
+  g_free (sd->ipfs_gateways);
+  g_free (sd->s3_endpoint);
+  g_free (sd->s3_bucket);
+  g_free (sd->s3_region);
+  g_free (sd->s3_access_key);
+  g_free (sd->s3_secret_key);
+  g_free (sd->s3_prefix);
+  g_free (sd->s3_public_url);
+  g_free (sd->overflow_policy);
+  g_free (sd->hotkey_fullscreen);
+  g_free (sd->hotkey_window);
+  g_free (sd->hotkey_region);
   g_free (sd);
 
   TRACE ("Ciao");
@@ -0,0 +1,372 @@
+/*  $Id$
+ *
+ *  Copyright © 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ * */
+
+/* A local stand-in for the Imgur upload API and the IPFS add command,
+ * to work on the upload jobs without the real services:
+ *
+ *   mock-upload-server --port 8080 --latency 200 --bandwidth 512 --failure-rate 0.1
+ *   SCREENSHOOTER_IMGUR_URL=http://127.0.0.1:8080/3/upload.xml \
+ *   SCREENSHOOTER_IPFS_URL=http://127.0.0.1:8080/api/v0/add \
+ *     xfce4-screenshooter --upload-dir ... --stats
+ *
+ * The IPFS node of the preferences can be pointed at it as well, the
+ * directory wrapping of the add command is answered too. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+#include <glib-unix.h>
+#include <libsoup/soup.h>
+
+#define MOCK_IMGUR_PATH "/3/upload.xml"
+#define MOCK_IPFS_PATH  "/api/v0/add"
+
+
+
+static gint port = 8080;
+static gint latency = 0;
+static gint bandwidth = 0;
+static gdouble failure_rate = 0.0;
+static gint failure_status = SOUP_STATUS_SERVICE_UNAVAILABLE;
+
+static guint n_requests = 0;
+static guint n_failures = 0;
+static guint64 n_bytes = 0;
+
+static GOptionEntry entries[] =
+{
+  {
+    "port", 'p', 0, G_OPTION_ARG_INT, &port,
+    "Port to listen on, on the loopback interface", "PORT"
+  },
+  {
+    "latency", 'l', 0, G_OPTION_ARG_INT, &latency,
+    "Time before each answer", "MS"
+  },
+  {
+    "bandwidth", 'b', 0, G_OPTION_ARG_INT, &bandwidth,
+    "Rate the uploads are received at, 0 for no limit", "KB/s"
+  },
+  {
+    "failure-rate", 'f', 0, G_OPTION_ARG_DOUBLE, &failure_rate,
+    "Fraction of the uploads answered with an error, from 0 to 1", "RATE"
+  },
+  {
+    "failure-status", 's', 0, G_OPTION_ARG_INT, &failure_status,
+    "HTTP status of the failed uploads, e.g. 429 or 500", "STATUS"
+  },
+  {
+    NULL, ' ', 0, 0, NULL,
+    NULL,
+    NULL
+  }
+};
+
+
+
+typedef struct
+{
+  SoupServer  *server;
+  SoupMessage *msg;
+} PausedMessage;
+
+
+
+/* Internals */
+
+
+
+static gboolean
+cb_unpause (PausedMessage *paused)
+{
+  soup_server_unpause_message (paused->server, paused->msg);
+  g_object_unref (paused->msg);
+  g_free (paused);
+
+  return FALSE;
+}
+
+
+
+/* An identifier derived from the contents, as the services do */
+static gchar *
+get_hash (const gchar *prefix, const gchar *data, gsize length)
+{
+  gchar *checksum = g_compute_checksum_for_data (G_CHECKSUM_SHA256,
+                                                 (const guchar *) data, length);
+  gchar *hash = g_strconcat (prefix, checksum, NULL);
+
+  g_free (checksum);
+
+  return hash;
+}
+
+
+
+/* <data type="array" success="1" status="200"><id>xxxxxx</id> */
+static gchar *
+answer_imgur (SoupBuffer *body)
+{
+  gchar *hash = get_hash ("", body->data, body->length);
+  gchar *response;
+
+  response = g_strdup_printf ("<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+                              "<data type=\"array\" success=\"1\" status=\"200\">"
+                              "<id>%.7s</id><link>https://i.imgur.com/%.7s.png</link>"
+                              "</data>",
+                              hash, hash);
+  g_free (hash);
+
+  return response;
+}
+
+
+
+/* One JSON object per added file, and one for the wrapping directory,
+ * without a name, when @wrap is set */
+static gchar *
+answer_ipfs (SoupMessage *msg, SoupBuffer *body, gboolean wrap)
+{
+  SoupMultipart *multipart;
+  GString *response;
+  gint i;
+
+  multipart = soup_multipart_new_from_message (msg->request_headers, msg->request_body);
+
+  if (multipart == NULL)
+    return NULL;
+
+  response = g_string_new (NULL);
+
+  for (i = 0; i < soup_multipart_get_length (multipart); i++)
+    {
+      SoupMessageHeaders *headers;
+      SoupBuffer *part;
+      GHashTable *params = NULL;
+      gchar *hash, *name;
+
+      if (!soup_multipart_get_part (multipart, i, &headers, &part) ||
+          !soup_message_headers_get_content_disposition (headers, NULL, &params))
+        continue;
+
+      if (g_hash_table_lookup (params, "filename") != NULL)
+        {
+          hash = get_hash ("mock", part->data, part->length);
+          name = g_strescape (g_hash_table_lookup (params, "filename"), NULL);
+
+          g_string_append_printf (response,
+                                  "{\"Name\":\"%s\",\"Hash\":\"%s\",\"Size\":\"%"
+                                  G_GSIZE_FORMAT "\"}\n",
+                                  name, hash, part->length);
+          g_free (hash);
+          g_free (name);
+
+          /* The relay only answers for the screenshot */
+          if (!wrap)
+            i = soup_multipart_get_length (multipart);
+        }
+
+      g_hash_table_destroy (params);
+    }
+
+  if (wrap)
+    {
+      gchar *hash = get_hash ("mock", body->data, body->length);
+
+      g_string_append_printf (response,
+                              "{\"Name\":\"\",\"Hash\":\"%s\",\"Size\":\"%"
+                              G_GSIZE_FORMAT "\"}\n",
+                              hash, body->length);
+      g_free (hash);
+    }
+
+  soup_multipart_free (multipart);
+
+  return g_string_free (response, FALSE);
+}
+
+
+
+static void
+handle_upload (SoupServer        *server,
+               SoupMessage       *msg,
+               const char        *path,
+               GHashTable        *query,
+               SoupClientContext *client,
+               gpointer           user_data)
+{
+  SoupBuffer *body;
+  gchar *response = NULL;
+  guint delay = latency;
+
+  if (msg->method != SOUP_METHOD_POST)
+    {
+      soup_message_set_status (msg, SOUP_STATUS_METHOD_NOT_ALLOWED);
+      return;
+    }
+
+  body = soup_message_body_flatten (msg->request_body);
+
+  n_requests++;
+  n_bytes += body->length;
+
+  /* The body was received at once, the time it would have taken at
+   * the given bandwidth, in bytes per millisecond, is added to the latency */
+  if (bandwidth > 0)
+    delay += body->length / bandwidth;
+
+  if (g_random_double () < failure_rate)
+    {
+      n_failures++;
+      soup_message_set_status (msg, failure_status);
+    }
+  else
+    {
+      if (g_strcmp0 (path, MOCK_IMGUR_PATH) == 0)
+        response = answer_imgur (body);
+      else
+        response = answer_ipfs (msg, body,
+                                query != NULL &&
+                                g_strcmp0 (g_hash_table_lookup (query, "wrap-with-directory"),
+                                           "true") == 0);
+
+      if (response == NULL)
+        soup_message_set_status (msg, SOUP_STATUS_BAD_REQUEST);
+      else
+        {
+          soup_message_set_status (msg, SOUP_STATUS_OK);
+          soup_message_set_response (msg,
+                                     g_strcmp0 (path, MOCK_IMGUR_PATH) == 0 ?
+                                     "text/xml" : "application/json",
+                                     SOUP_MEMORY_TAKE, response, strlen (response));
+        }
+    }
+
+  g_print ("%s %s: %" G_GSIZE_FORMAT " bytes, %u in %u ms\n",
+           msg->method, path, body->length, msg->status_code, delay);
+
+  soup_buffer_free (body);
+
+  if (delay > 0)
+    {
+      PausedMessage *paused = g_new (PausedMessage, 1);
+
+      paused->server = server;
+      paused->msg = g_object_ref (msg);
+
+      soup_server_pause_message (server, msg);
+      g_timeout_add (delay, (GSourceFunc) cb_unpause, paused);
+    }
+}
+
+
+
+static gboolean
+cb_interrupted (GMainLoop *loop)
+{
+  g_main_loop_quit (loop);
+
+  return TRUE;
+}
+
+
+
+/* Main */
+
+
+
+int main (int argc, char **argv)
+{
+  GOptionContext *context;
+  GError *error = NULL;
+  SoupServer *server;
+  GMainLoop *loop;
+  gchar *bytes;
+
+  context = g_option_context_new ("- answer the uploads as Imgur and IPFS do");
+  g_option_context_add_main_entries (context, entries, NULL);
+
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      g_error_free (error);
+      g_option_context_free (context);
+
+      return EXIT_FAILURE;
+    }
+
+  g_option_context_free (context);
+
+#if SOUP_CHECK_VERSION (2, 48, 0)
+  server = soup_server_new (SOUP_SERVER_SERVER_HEADER, "mock-upload-server", NULL);
+
+  if (!soup_server_listen_local (server, port, SOUP_SERVER_LISTEN_IPV4_ONLY, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      g_error_free (error);
+      g_object_unref (server);
+
+      return EXIT_FAILURE;
+    }
+#else
+  {
+    SoupAddress *address = soup_address_new ("127.0.0.1", port);
+
+    server = soup_server_new (SOUP_SERVER_SERVER_HEADER, "mock-upload-server",
+                              SOUP_SERVER_INTERFACE, address, NULL);
+    g_object_unref (address);
+  }
+
+  if (server == NULL)
+    {
+      g_printerr ("Could not listen on port %d\n", port);
+
+      return EXIT_FAILURE;
+    }
+
+  soup_server_run_async (server);
+#endif
+
+  soup_server_add_handler (server, MOCK_IMGUR_PATH, handle_upload, NULL, NULL);
+  soup_server_add_handler (server, MOCK_IPFS_PATH, handle_upload, NULL, NULL);
+
+  g_print ("Imgur: http://127.0.0.1:%d%s\n", port, MOCK_IMGUR_PATH);
+  g_print ("IPFS:  http://127.0.0.1:%d%s\n", port, MOCK_IPFS_PATH);
+
+  loop = g_main_loop_new (NULL, FALSE);
+  g_unix_signal_add (SIGINT, (GSourceFunc) cb_interrupted, loop);
+  g_unix_signal_add (SIGTERM, (GSourceFunc) cb_interrupted, loop);
+
+  g_main_loop_run (loop);
+
+  bytes = g_format_size (n_bytes);
+  g_print ("%u uploads, %u failed, %s received\n", n_requests, n_failures, bytes);
+  g_free (bytes);
+
+  g_main_loop_unref (loop);
+  g_object_unref (server);
+
+  return EXIT_SUCCESS;
+}
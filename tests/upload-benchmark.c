@@ -0,0 +1,239 @@
+/*  $Id$
+ *
+ *  Copyright © 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ * */
+
+/* Uploads generated screenshots with the real upload jobs, against
+ * mock-upload-server by default, and prints the throughput, the retries
+ * and the peak memory use:
+ *
+ *   mock-upload-server --latency 100 --failure-rate 0.2 --failure-status 503 &
+ *   upload-benchmark --target imgur --files 50 --size 1024 --jobs 8 */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "libscreenshooter.h"
+
+#include <stdlib.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+
+
+static gchar *server = NULL;
+static gchar *target = NULL;
+static gint n_files = 20;
+static gint size = 512;
+static gint jobs = 4;
+
+static GOptionEntry entries[] =
+{
+  {
+    "server", 0, 0, G_OPTION_ARG_STRING, &server,
+    "Address of the mock server, http://127.0.0.1:8080 by default", "URL"
+  },
+  {
+    "target", 't', 0, G_OPTION_ARG_STRING, &target,
+    "Service the screenshots are uploaded to: imgur or ipfs, the default", "SERVICE"
+  },
+  {
+    "files", 'n', 0, G_OPTION_ARG_INT, &n_files,
+    "Number of screenshots uploaded", "N"
+  },
+  {
+    "size", 's', 0, G_OPTION_ARG_INT, &size,
+    "Width and height of the screenshots, in pixels", "PIXELS"
+  },
+  {
+    "jobs", 'j', 0, G_OPTION_ARG_INT, &jobs,
+    "Number of uploads running at the same time", "N"
+  },
+  {
+    NULL, ' ', 0, 0, NULL,
+    NULL,
+    NULL
+  }
+};
+
+
+
+/* Internals */
+
+
+
+/* Writes @n screenshots of noise, which PNG cannot compress, so that
+ * their size is about 3 * size * size bytes */
+static gboolean
+create_screenshots (const gchar *directory, gint n, gint side)
+{
+  GdkPixbuf *pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, FALSE, 8, side, side);
+  gint rowstride = gdk_pixbuf_get_rowstride (pixbuf);
+  guchar *pixels = gdk_pixbuf_get_pixels (pixbuf);
+  gboolean success = TRUE;
+  gint i, j;
+
+  for (i = 0; i < n && success; i++)
+    {
+      GError *error = NULL;
+      gchar *name, *path;
+
+      /* Each one differs, so that none is found in the upload cache */
+      for (j = 0; j < rowstride * side; j++)
+        pixels[j] = g_random_int_range (0, 256);
+
+      name = g_strdup_printf ("benchmark-%04d.png", i);
+      path = g_build_filename (directory, name, NULL);
+
+      if (!gdk_pixbuf_save (pixbuf, path, "png", &error, "compression", "1", NULL))
+        {
+          g_printerr ("%s: %s\n", path, error->message);
+          g_error_free (error);
+          success = FALSE;
+        }
+
+      g_free (name);
+      g_free (path);
+    }
+
+  g_object_unref (pixbuf);
+
+  return success;
+}
+
+
+
+static void
+remove_directory (const gchar *directory)
+{
+  GDir *dir = g_dir_open (directory, 0, NULL);
+  const gchar *name;
+
+  if (dir != NULL)
+    {
+      while ((name = g_dir_read_name (dir)) != NULL)
+        {
+          gchar *path = g_build_filename (directory, name, NULL);
+
+          if (g_file_test (path, G_FILE_TEST_IS_DIR))
+            remove_directory (path);
+          else
+            g_unlink (path);
+
+          g_free (path);
+        }
+
+      g_dir_close (dir);
+    }
+
+  g_rmdir (directory);
+}
+
+
+
+/* Main */
+
+
+
+int main (int argc, char **argv)
+{
+  GOptionContext *context;
+  GError *error = NULL;
+  ScreenshotData *sd;
+  gchar *directory, *cache, *url, *summary;
+  gint upload_target = UPLOAD_IPFS;
+  gint64 start, elapsed;
+  guint n_failed;
+
+  context = g_option_context_new ("- measure the uploads against a mock server");
+  g_option_context_add_main_entries (context, entries, NULL);
+
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      g_error_free (error);
+      g_option_context_free (context);
+
+      return EXIT_FAILURE;
+    }
+
+  g_option_context_free (context);
+
+  if (g_strcmp0 (target, "imgur") == 0)
+    upload_target = UPLOAD_IMGUR;
+  else if (target != NULL && g_strcmp0 (target, "ipfs") != 0)
+    {
+      g_printerr ("Unknown target %s, use imgur or ipfs\n", target);
+      return EXIT_FAILURE;
+    }
+
+  directory = g_dir_make_tmp ("screenshooter-benchmark-XXXXXX", &error);
+
+  if (directory == NULL)
+    {
+      g_printerr ("%s\n", error->message);
+      g_error_free (error);
+
+      return EXIT_FAILURE;
+    }
+
+  /* Keep the upload cache of the user out of the measures */
+  cache = g_build_filename (directory, "cache", NULL);
+  g_setenv ("XDG_CACHE_HOME", cache, TRUE);
+
+  url = g_strconcat (server != NULL ? server : "http://127.0.0.1:8080",
+                     "/3/upload.xml", NULL);
+  g_setenv ("SCREENSHOOTER_IMGUR_URL", url, TRUE);
+  g_free (url);
+
+  url = g_strconcat (server != NULL ? server : "http://127.0.0.1:8080",
+                     "/api/v0/add", NULL);
+  g_setenv ("SCREENSHOOTER_IPFS_URL", url, TRUE);
+  g_free (url);
+
+  g_print ("Create %d screenshots of %dx%d\n", n_files, size, size);
+
+  if (!create_screenshots (directory, MAX (n_files, 0), MAX (size, 1)))
+    {
+      remove_directory (directory);
+      return EXIT_FAILURE;
+    }
+
+  /* The relay is used for IPFS, no node is set */
+  sd = g_new0 (ScreenshotData, 1);
+
+  start = g_get_monotonic_time ();
+  n_failed = screenshooter_batch_upload (directory, upload_target, jobs, sd);
+  elapsed = g_get_monotonic_time () - start;
+
+  summary = screenshooter_upload_get_stats ();
+  g_print ("%s", summary);
+  g_print ("Wall time: %.2f s, %.2f screenshots per second, %u failed\n",
+           (gdouble) elapsed / G_USEC_PER_SEC,
+           elapsed > 0 ? n_files * (gdouble) G_USEC_PER_SEC / elapsed : 0.0,
+           n_failed);
+
+  g_free (summary);
+  g_free (sd);
+  remove_directory (directory);
+  g_free (directory);
+  g_free (cache);
+
+  return n_failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}